@@ -0,0 +1,69 @@
+#include <atomic>
+#include <cstdint>
+#include <opencv2/core.hpp>
+#include "AllocationCounter.h"
+
+static thread_local bool counting = false;
+static thread_local uint64_t allocations = 0;
+static std::atomic<bool> countingAll{ false };
+static std::atomic<uint64_t> allAllocations{ 0 };
+
+void countAllocation()
+{
+    if (counting)
+        allocations++;
+    if (countingAll.load(std::memory_order_relaxed))
+        allAllocations.fetch_add(1, std::memory_order_relaxed);
+}
+
+// the allocator OpenCV uses by default, counting the buffers it allocates
+class CountingMatAllocator : public cv::MatAllocator
+{
+public:
+    CountingMatAllocator(cv::MatAllocator * allocator) : _allocator(allocator) {}
+
+    cv::UMatData * allocate(int dims, const int * sizes, int type, void * data, size_t * step, int flags, cv::UMatUsageFlags usageFlags) const override
+    {
+        if (data == nullptr)
+            countAllocation();
+        return _allocator->allocate(dims, sizes, type, data, step, flags, usageFlags);
+    }
+
+    bool allocate(cv::UMatData * data, int accessFlags, cv::UMatUsageFlags usageFlags) const override
+    {
+        return _allocator->allocate(data, accessFlags, usageFlags);
+    }
+
+    // buffers are handed back to the allocator that made them, this one never sees them
+    void deallocate(cv::UMatData * data) const override
+    {
+        _allocator->deallocate(data);
+    }
+
+private:
+    cv::MatAllocator *_allocator;
+};
+
+AllocationCounter::AllocationCounter(bool allThreads)
+    : _allocator{ cv::Mat::getDefaultAllocator() }
+    , _allThreads{ allThreads }
+{
+    static CountingMatAllocator *countingAllocator = new CountingMatAllocator(_allocator);
+    cv::Mat::setDefaultAllocator(countingAllocator);
+    allocations = 0;
+    allAllocations = 0;
+    counting = !allThreads;
+    countingAll = allThreads;
+}
+
+AllocationCounter::~AllocationCounter()
+{
+    counting = false;
+    countingAll = false;
+    cv::Mat::setDefaultAllocator(_allocator);
+}
+
+uint64_t AllocationCounter::count() const
+{
+    return _allThreads ? allAllocations.load() : allocations;
+}
@@ -0,0 +1,26 @@
+#pragma once
+#include <cstdint>
+#include <opencv2/core.hpp>
+
+// Counts the heap allocations of the calling thread, or of every thread of the process, while it lives, to check that
+// the steady state of the frame processing allocates nothing. Mat buffers are counted by a MatAllocator it installs as
+// the OpenCV default, other allocations only in programs replacing the global operator new with one calling
+// countAllocation, as rscvdnn_bench does. One counter at a time.
+class AllocationCounter
+{
+public:
+    explicit AllocationCounter(bool allThreads = false);
+    ~AllocationCounter();
+    AllocationCounter(const AllocationCounter &) = delete;
+    AllocationCounter & operator=(const AllocationCounter &) = delete;
+
+    // allocations of this thread, or of all of them, since the counter was created
+    uint64_t count() const;
+
+private:
+    cv::MatAllocator *_allocator;
+    const bool _allThreads;
+};
+
+// count one allocation if the calling thread or the process has a counter, cheap enough for operator new
+void countAllocation();
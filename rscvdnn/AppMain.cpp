@@ -1,11 +1,22 @@
 #include <string>
+#include <iostream>
 #include <Poco/Util/Option.h>
 #include <Poco/Util/HelpFormatter.h>
+#include <Poco/Exception.h>
 #include <Poco/Util/AbstractConfiguration.h>
 #include <nanogui/common.h>
 #include <nanogui/object.h>
 #include "AppMain.h"
 #include "MainWindow.h"
+#include "CustomLayers.h"
+#include "Metrics.h"
+#include "MetricsServer.h"
+#include "BatchRunner.h"
+#include "EventLog.h"
+#include "CameraRig.h"
+#include "StreamController.h"
+#include "StageTrace.h"
+#include "StartupTrace.h"
 
 using std::string;
 using Poco::Util::Application;
@@ -56,9 +67,15 @@ void AppMain::initialize(Application & self)
 {
     // hide the console window after command line options are handled
     //ShowWindow(GetConsoleWindow(), SW_HIDE);
+    startupBegin();
     poco_information(logger(), config().getString("application.baseName", name()) + " initialize");
-    // load default configuration file
-    loadConfiguration();
+    {
+        StartupScope phase("configuration");
+        // load default configuration file
+        loadConfiguration();
+        // custom DNN layers have to be in place before any network is loaded
+        registerCustomLayers(CustomLayerSettings(*config().createView("detector.customLayers")));
+    }
     // all registered subsystems are initialized in ancestor's initialize procedure
     Application::initialize(self);
 }
@@ -66,6 +83,7 @@ void AppMain::initialize(Application & self)
 void AppMain::uninitialize()
 {
     poco_information(logger(), config().getString("application.baseName", name()) + " uninitialize");
+    unregisterCustomLayers();
     // ancestor uninitialization
     Application::uninitialize();
 }
@@ -79,6 +97,27 @@ void AppMain::defineOptions(Poco::Util::OptionSet & options)
         .required(false)
         .repeatable(false)
         .callback(OptionCallback<AppMain>(this, &AppMain::handleOptionHelp)));
+
+    options.addOption(
+        Option("playback", "p", "(/p) comma separated .bag files, .rscvrec recordings, video files or image directories played back instead of the connected cameras")
+        .required(false)
+        .repeatable(false)
+        .argument("files")
+        .binding("cameras.playback"));
+
+    options.addOption(
+        Option("batch", "b", "(/b) process the playback files without GUI as fast as possible, and write the detections as JSON Lines to file")
+        .required(false)
+        .repeatable(false)
+        .argument("file")
+        .binding("batch.output"));
+
+    options.addOption(
+        Option("decode-events", "e", "(/e) print the events of a binary event log written with eventLog.path as text and exit")
+        .required(false)
+        .repeatable(false)
+        .argument("file")
+        .binding("eventLog.decode"));
 }
 
 int AppMain::main(const ArgVec & args)
@@ -86,12 +125,82 @@ int AppMain::main(const ArgVec & args)
     if (_helpRequested)
         return Application::EXIT_USAGE;
 
+    if (config().has("eventLog.decode"))
+    {
+        try
+        {
+            decodeEventLog(config().getString("eventLog.decode"), std::cout);
+            return Application::EXIT_OK;
+        }
+        catch (std::exception& e)
+        {
+            poco_error(logger(), string(e.what()));
+            return Application::EXIT_DATAERR;
+        }
+    }
+
+    // the metrics endpoint is optional, the application runs on without it if the port is taken
+    MetricsServer metricsServer(*config().createView("metrics"), metrics());
+    if (config().getBool("metrics.enabled", false))
+    {
+        try
+        {
+            metricsServer.start();
+        }
+        catch (Poco::Exception & e)
+        {
+            poco_warning(logger(), "metrics server not started: " + e.displayText());
+        }
+    }
+
+    // per-frame events are dropped unless the event log runs
+    EventLogWriter eventLog(*config().createView("eventLog"));
+    if (config().getBool("eventLog.enabled", false))
+    {
+        try
+        {
+            eventLog.start();
+        }
+        catch (std::exception& e)
+        {
+            poco_warning(logger(), "event log not started: " + string(e.what()));
+        }
+    }
+
+    if (config().has("batch.output"))
+    {
+        try
+        {
+            BatchRunner batch(config());
+            bool done = batch.run("MobileNetSSD_deploy.prototxt", "MobileNetSSD_deploy.caffemodel", config().getString("batch.output"), std::cout);
+            return done ? Application::EXIT_OK : Application::EXIT_USAGE;
+        }
+        catch (std::exception& e)
+        {
+            poco_error(logger(), string(e.what()));
+            return Application::EXIT_SOFTWARE;
+        }
+    }
+
     try
     {
+        // the model loads while the GUI comes up, and with startup.autoStart the cameras open meanwhile
+        setTraceEnabled(config().getBool("trace.enabled", false));
+        CameraRig rig(config());
+        rig.loadModel("MobileNetSSD_deploy.prototxt", "MobileNetSSD_deploy.caffemodel");
+        StreamController stream(rig);
+        if (config().getBool("startup.autoStart", false))
+        {
+            rig.setDetecting(config().getBool("startup.autoDetect", true));
+            stream.start();
+        }
+
         // initialize GUI
+        int64_t guiStart = traceNow();
         nanogui::init();
         {
-            nanogui::ref<MainWindow> guiMain = new MainWindow(Eigen::Vector2i(1280, 720), "RealSense OpenCV DNN object detection");
+            nanogui::ref<MainWindow> guiMain = new MainWindow(Eigen::Vector2i(1280, 720), "RealSense OpenCV DNN object detection", rig, stream);
+            startupPhase("gui_init", guiStart, traceNow());
             guiMain->drawAll();
             guiMain->setVisible(true);
             poco_information(logger(), "MainWindow started");
@@ -0,0 +1,108 @@
+#include <algorithm>
+#include <string>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <stdexcept>
+#include <Poco/Logger.h>
+#include <Poco/Util/AbstractConfiguration.h>
+#include <opencv2/core.hpp>
+#include "BatchRunner.h"
+#include "CameraRig.h"
+
+using std::string;
+using std::vector;
+using std::ostream;
+using Poco::Logger;
+using Poco::Util::AbstractConfiguration;
+
+string detectionsJson(const FramePipeline & pipeline, const PipelineFrame & frame)
+{
+    std::ostringstream json;
+    json << std::fixed << std::setprecision(3) << "{\"camera\":\"" << pipeline.camera().serial << "\",\"frame\":" << frame.frameNumber
+        << ",\"timestamp\":" << frame.sensorTimestamp << ",\"objects\":[";
+    bool first = true;
+    for (const PublishedObject & object : pipeline.objects(frame))
+    {
+        json << (first ? "" : ",") << "{\"class\":\"" << pipeline.className(object.classId) << "\",\"confidence\":" << object.confidence
+            << ",\"box\":[" << object.box.x << "," << object.box.y << "," << object.box.width << "," << object.box.height
+            << "],\"distance\":" << object.distance << "}";
+        first = false;
+    }
+    json << "]}";
+    return json.str();
+}
+
+BatchRunner::BatchRunner(AbstractConfiguration & config)
+    : _logger{ Logger::get("BatchRunner") }
+    , _config(config)
+{
+    _config.setBool("cameras.playbackRealTime", false);
+    _config.setBool("cameras.playbackRepeat", false);
+    _config.setBool("pipeline.annotate", false);
+    for (const char *queue : { "align", "preprocess", "inference", "postprocess", "display" })
+        _config.setString(string("pipeline.queue.") + queue + ".policy", "block");
+    _config.setString("recorder.queue.policy", "block");
+}
+
+bool BatchRunner::run(const string & prototxt, const string & caffemodel, const string & output, ostream & report)
+{
+    if (_config.getString("cameras.playback", "").empty())
+    {
+        poco_error(_logger, "batch mode needs recordings to play back");
+        return false;
+    }
+    std::ofstream out(output);
+    if (!out)
+        throw std::runtime_error("cannot write detections to " + output);
+
+    CameraRig rig(_config);
+    rig.loadModel(prototxt, caffemodel);
+    rig.setDetecting(true);
+    int64 tickStart = cv::getTickCount();
+    size_t cameras = rig.start();
+
+    // one writer per recording takes its frames as they come out of the pipeline
+    std::mutex outMutex;
+    vector<uint64_t> frames(cameras, 0);
+    // the time of the last frame of each recording, the wait that notices its end is not processing
+    vector<int64> tickEnd(cameras, tickStart);
+    vector<std::thread> writers;
+    for (size_t i = 0; i < cameras; i++)
+    {
+        writers.emplace_back([&rig, &out, &outMutex, &frames, &tickEnd, i]()
+        {
+            FramePipeline & pipeline = rig.pipeline(i);
+            PipelineFrame frame;
+            while (pipeline.nextFrame(frame))
+            {
+                string line = detectionsJson(pipeline, frame);
+                std::lock_guard<std::mutex> lock(outMutex);
+                out << line << "\n";
+                frames[i]++;
+                tickEnd[i] = cv::getTickCount();
+            }
+        });
+    }
+    for (std::thread & writer : writers)
+        writer.join();
+    double seconds = (*std::max_element(tickEnd.begin(), tickEnd.end()) - tickStart) / cv::getTickFrequency();
+
+    uint64_t total = 0;
+    report << std::fixed << std::setprecision(1);
+    for (size_t i = 0; i < cameras; i++)
+    {
+        const CameraSettings & camera = rig.pipeline(i).camera();
+        double cameraSeconds = (tickEnd[i] - tickStart) / cv::getTickFrequency();
+        report << camera.playback << " (" << camera.serial << "): " << frames[i] << " frames, "
+            << (cameraSeconds > 0 ? frames[i] / cameraSeconds : 0.0) << " frames/s\n";
+        total += frames[i];
+    }
+    rig.stop();
+    report << total << " frames of " << cameras << " recordings in " << std::setprecision(2) << seconds << " s, "
+        << std::setprecision(1) << (seconds > 0 ? total / seconds : 0.0) << " frames/s, detections written to " << output << std::endl;
+    return cameras > 0;
+}
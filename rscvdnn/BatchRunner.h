@@ -0,0 +1,27 @@
+#pragma once
+#include <ostream>
+#include <string>
+#include <Poco/Logger.h>
+#include <Poco/Util/AbstractConfiguration.h>
+#include "FramePipeline.h"
+
+// Headless processing of the .bag recordings in cameras.playback as fast as the CPU allows, for offline
+// reprocessing and for benchmarks on machines without display. Recordings are played once and not in real time,
+// the pipeline queues block instead of dropping, so every recorded frame goes through align, detection and
+// distance measurement. The detections of every frame are written as one JSON object per line.
+class BatchRunner
+{
+public:
+    // the settings the batch mode depends on are overridden in config
+    BatchRunner(Poco::Util::AbstractConfiguration & config);
+    // process all recordings, write the detections to output and the throughput to report,
+    // false if there is no recording to process
+    bool run(const std::string & prototxt, const std::string & caffemodel, const std::string & output, std::ostream & report);
+
+private:
+    Poco::Logger & _logger;
+    Poco::Util::AbstractConfiguration & _config;
+};
+
+// one JSON Lines record of the detections of frame, camera is the serial number of its camera
+std::string detectionsJson(const FramePipeline & pipeline, const PipelineFrame & frame);
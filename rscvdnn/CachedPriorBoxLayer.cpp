@@ -0,0 +1,53 @@
+#include <vector>
+#include <opencv2/core.hpp>
+#include <opencv2/dnn.hpp>
+#include <opencv2/dnn/all_layers.hpp>
+#include "CachedPriorBoxLayer.h"
+
+using std::vector;
+using cv::dnn::LayerParams;
+using cv::dnn::MatShape;
+
+CachedPriorBoxLayer::CachedPriorBoxLayer(const LayerParams & params)
+{
+    setParamsFrom(params);
+    _stock = cv::dnn::PriorBoxLayer::create(params);
+}
+
+cv::Ptr<cv::dnn::Layer> CachedPriorBoxLayer::create(LayerParams & params)
+{
+    return cv::Ptr<cv::dnn::Layer>(new CachedPriorBoxLayer(params));
+}
+
+bool CachedPriorBoxLayer::getMemoryShapes(const vector<MatShape> & inputs, const int requiredOutputs,
+    vector<MatShape> & outputs, vector<MatShape> & internals) const
+{
+    return _stock->getMemoryShapes(inputs, requiredOutputs, outputs, internals);
+}
+
+void CachedPriorBoxLayer::finalize(cv::InputArrayOfArrays inputs, cv::OutputArrayOfArrays outputs)
+{
+    _stock->finalize(inputs, outputs);
+    _cachedSizes.clear();
+    _priors.release();
+}
+
+void CachedPriorBoxLayer::forward(cv::InputArrayOfArrays inputs_arr, cv::OutputArrayOfArrays outputs_arr, cv::OutputArrayOfArrays internals_arr)
+{
+    vector<cv::Mat> inputs, outputs;
+    inputs_arr.getMatVector(inputs);
+
+    // input 0 is the feature map, input 1 the network input image
+    vector<int> sizes{ inputs[0].size[2], inputs[0].size[3], inputs[1].size[2], inputs[1].size[3] };
+    if (_priors.empty() || sizes != _cachedSizes)
+    {
+        _stock->forward(inputs_arr, outputs_arr, internals_arr);
+        outputs_arr.getMatVector(outputs);
+        outputs[0].copyTo(_priors);
+        _cachedSizes = sizes;
+        return;
+    }
+
+    outputs_arr.getMatVector(outputs);
+    _priors.copyTo(outputs[0]);
+}
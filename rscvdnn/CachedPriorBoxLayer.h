@@ -0,0 +1,24 @@
+#pragma once
+#include <vector>
+#include <opencv2/dnn.hpp>
+#include <opencv2/dnn/all_layers.hpp>
+
+// PriorBox whose output only depends on the feature map and image sizes, so it is computed once
+// by the stock layer per input size and copied out of the cache on every other forward
+class CachedPriorBoxLayer : public cv::dnn::Layer
+{
+public:
+    CachedPriorBoxLayer(const cv::dnn::LayerParams & params);
+    static cv::Ptr<cv::dnn::Layer> create(cv::dnn::LayerParams & params);
+
+    bool getMemoryShapes(const std::vector<cv::dnn::MatShape> & inputs, const int requiredOutputs,
+        std::vector<cv::dnn::MatShape> & outputs, std::vector<cv::dnn::MatShape> & internals) const override;
+    void finalize(cv::InputArrayOfArrays inputs, cv::OutputArrayOfArrays outputs) override;
+    void forward(cv::InputArrayOfArrays inputs, cv::OutputArrayOfArrays outputs, cv::OutputArrayOfArrays internals) override;
+
+private:
+    cv::Ptr<cv::dnn::Layer> _stock;
+    // feature map and image sizes the cached priors were computed for
+    std::vector<int> _cachedSizes;
+    cv::Mat _priors;
+};
@@ -0,0 +1,310 @@
+#include <string>
+#include <sstream>
+#include <iomanip>
+#include <vector>
+#include <algorithm>
+#include <functional>
+#include <chrono>
+#include <Poco/AutoPtr.h>
+#include <Poco/Exception.h>
+#include <Poco/Logger.h>
+#include <Poco/Path.h>
+#include <Poco/String.h>
+#include <Poco/StringTokenizer.h>
+#include <Poco/Util/AbstractConfiguration.h>
+#include <librealsense2/rs.hpp>
+#include "CameraRig.h"
+#include "Recording.h"
+#include "StageTrace.h"
+#include "StartupTrace.h"
+#include "ObjectDetector.h"
+
+using std::string;
+using std::vector;
+using std::ostringstream;
+using Poco::AutoPtr;
+using Poco::Logger;
+using Poco::StringTokenizer;
+using Poco::Util::AbstractConfiguration;
+
+// serial number of the device a .bag file or recording was made from, the name of any other recording
+static string playbackSerial(const string & file)
+{
+    Poco::Path path(file);
+    if (Poco::icompare(path.getExtension(), "rscvrec") == 0)
+        return RecordingReader(file).header().serial;
+    if (Poco::icompare(path.getExtension(), "bag") != 0)
+        return path.getBaseName();
+
+    rs2::context ctx;
+    rs2::playback device = ctx.load_device(file);
+    string serial = device.get_info(RS2_CAMERA_INFO_SERIAL_NUMBER);
+    ctx.unload_device(file);
+    return serial;
+}
+
+CameraRig::CameraRig(const AbstractConfiguration & config)
+    : _logger{ Logger::get("CameraRig") }
+    , _config(config)
+    , _poolWorkers{ std::max(1, config.getInt("detector.poolWorkers", 2)) }
+    , _metricsCollector{ -1 }
+    , _publisher(*config.createView("publisher"))
+    , _detecting{ false }
+    , _depthView{ false }
+{
+    // clients stay connected across stream restarts, the publisher lives as long as the rig
+    if (config.getBool("publisher.enabled", false))
+    {
+        try
+        {
+            _publisher.start();
+        }
+        catch (Poco::Exception & e)
+        {
+            poco_warning(_logger, "detection publisher not started: " + e.displayText());
+        }
+    }
+}
+
+CameraRig::~CameraRig()
+{
+    stop();
+    // the loading thread uses the rig
+    if (_modelLoaded.valid())
+        _modelLoaded.wait();
+    if (_metricsCollector >= 0)
+        metrics().removeCollector(_metricsCollector);
+}
+
+void CameraRig::loadModel(const string & prototxt, const string & caffemodel)
+{
+    _prototxt = prototxt;
+    _caffemodel = caffemodel;
+    _modelLoaded = std::async(std::launch::async, [this]()
+    {
+        {
+            StartupScope phase("model_load");
+            _pool.reset(new NetPool(_prototxt, _caffemodel, _poolWorkers));
+        }
+        {
+            StartupScope phase("model_warm_up");
+            _pool->warmUp(cv::Size(ObjectDetector::InputSide, ObjectDetector::InputSide));
+        }
+        poco_information(_logger, std::to_string(_poolWorkers) + " network instances shared by all cameras");
+
+        for (int i = 0; i < _pool->workers(); i++)
+        {
+            string labels = "worker=\"" + std::to_string(i) + "\"";
+            _poolExecuted.push_back(&metrics().counter("rscvdnn_pool_jobs_total", "Network runs of a shared network instance", labels));
+            _poolStolen.push_back(&metrics().counter("rscvdnn_pool_stolen_total", "Network runs taken from the queue of another instance", labels));
+        }
+        _metricsCollector = metrics().addCollector(std::bind(&CameraRig::collectPoolMetrics, this));
+    }).share();
+}
+
+NetPool * CameraRig::waitForModel()
+{
+    if (!_modelLoaded.valid())
+        return nullptr;
+    if (_modelLoaded.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+    {
+        StartupScope phase("model_wait");
+        _modelLoaded.wait();
+    }
+    _modelLoaded.get();
+    return _pool.get();
+}
+
+size_t CameraRig::start()
+{
+    if (!_cameras.empty())
+        return _cameras.size();
+
+    AutoPtr<AbstractConfiguration> cameras(_config.createView("cameras"));
+    const int options = StringTokenizer::TOK_TRIM | StringTokenizer::TOK_IGNORE_EMPTY;
+    StringTokenizer playback(cameras->getString("playback", ""), ",", options);
+    StringTokenizer devices(cameras->getString("devices", ""), ",", options);
+    try
+    {
+        if (playback.count() > 0)
+        {
+            vector<string> serials;
+            for (const string & file : playback)
+            {
+                // the same device may have recorded more than one of the files
+                string serial = playbackSerial(file);
+                int copies = (int)std::count(serials.begin(), serials.end(), serial);
+                serials.push_back(serial);
+                startCamera(CameraSettings(*cameras, copies > 0 ? serial + "-" + std::to_string(copies + 1) : serial, file), *cameras);
+            }
+        }
+        else
+        {
+            if (!_context)
+            {
+                _context.reset(new rs2::context);
+                _context->set_devices_changed_callback([this](rs2::event_information & info) { devicesChanged(info); });
+            }
+            for (rs2::device && device : _context->query_devices())
+            {
+                string serial = device.get_info(RS2_CAMERA_INFO_SERIAL_NUMBER);
+                if (devices.count() == 0 || devices.has(serial))
+                {
+                    CameraSettings settings(*cameras, serial, "");
+                    chooseProfile(settings, device);
+                    startCamera(settings, *cameras);
+                }
+            }
+        }
+    }
+    catch (...)
+    {
+        stop();
+        throw;
+    }
+    return _cameras.size();
+}
+
+void CameraRig::chooseProfile(CameraSettings & settings, const rs2::device & device)
+{
+    if (!settings.autoProfile)
+        return;
+
+    const StreamProfile configured = settings.color;
+    if (!settings.chooseColorProfile(offeredProfiles(device, RS2_STREAM_COLOR), ObjectDetector::InputSide))
+    {
+        poco_information(_logger, "camera " + settings.serial + " keeps color " + configured.toString()
+            + ", no cheaper profile serves the detector and the display");
+        return;
+    }
+
+    // aligning depth to color, drawing and showing the frames scale with the color pixels
+    const StreamProfile & chosen = settings.color;
+    double before = configured.bytesPerSecond() / 1e6;
+    double after = chosen.bytesPerSecond() / 1e6;
+    ostringstream msg;
+    msg << std::fixed << std::setprecision(1) << "camera " << settings.serial << " color " << chosen.toString()
+        << " instead of " << configured.toString() << ": " << after << " MB/s instead of " << before << " MB/s, "
+        << 100.0 * (1.0 - after / before) << "% less bandwidth";
+    if (settings.alignTo == RS2_STREAM_COLOR)
+        msg << ", " << 100.0 * (1.0 - (double)chosen.size.area() / configured.size.area()) << "% fewer pixels per frame to align and draw";
+    if (configured.format != RS2_FORMAT_BGR8 && chosen.format == RS2_FORMAT_BGR8)
+        msg << ", no RGB to BGR conversion of the frames detected on";
+    poco_information(_logger, msg.str());
+}
+
+void CameraRig::startCamera(const CameraSettings & settings, const AbstractConfiguration & cameras)
+{
+    std::unique_ptr<Camera> camera(new Camera);
+    camera->source = createFrameSource(settings, cameras);
+    {
+        StartupScope phase("device_open");
+        camera->source->start();
+    }
+    try
+    {
+        // the devices open while the networks load
+        NetPool *pool = waitForModel();
+        camera->pipeline.reset(new FramePipeline(_config, settings, (int)_cameras.size(), &_publisher));
+        camera->pipeline->loadModel(_prototxt, _caffemodel, pool);
+        camera->pipeline->setDetecting(_detecting);
+        camera->pipeline->setDepthView(_depthView);
+        camera->pipeline->start(*camera->source);
+    }
+    catch (...)
+    {
+        camera->source->stop();
+        throw;
+    }
+
+    // a live device, not a recording
+    RealSenseSource *device = dynamic_cast<RealSenseSource *>(camera->source.get());
+    if (device != nullptr && settings.playback.empty())
+    {
+        string labels = "camera=\"" + settings.serial + "\",stream=";
+        metrics().gauge("rscvdnn_camera_stream_bytes_per_second", "Bandwidth of a camera stream", labels + "\"color\"").set(settings.color.bytesPerSecond());
+        metrics().gauge("rscvdnn_camera_stream_bytes_per_second", "Bandwidth of a camera stream", labels + "\"depth\"").set(settings.depth.bytesPerSecond());
+
+        std::lock_guard<std::mutex> lock(_liveMutex);
+        _live[settings.serial] = device;
+    }
+    poco_information(_logger, "camera " + std::to_string(_cameras.size()) + " " + settings.serial
+        + (settings.playback.empty() ? "" : " playing " + settings.playback) + " started");
+    _cameras.push_back(std::move(camera));
+}
+
+void CameraRig::stop()
+{
+    {
+        std::lock_guard<std::mutex> lock(_liveMutex);
+        _live.clear();
+    }
+    for (std::unique_ptr<Camera> & camera : _cameras)
+    {
+        // the pipeline threads must be done with the source before it stops, the pipeline wakes its capture stage
+        camera->pipeline->stop();
+        camera->source->stop();
+    }
+    _cameras.clear();
+}
+
+void CameraRig::setDetecting(bool on)
+{
+    _detecting = on;
+    for (std::unique_ptr<Camera> & camera : _cameras)
+        camera->pipeline->setDetecting(on);
+}
+
+void CameraRig::setDepthView(bool on)
+{
+    _depthView = on;
+    for (std::unique_ptr<Camera> & camera : _cameras)
+        camera->pipeline->setDepthView(on);
+}
+
+void CameraRig::collectPoolMetrics()
+{
+    for (int i = 0; i < _pool->workers(); i++)
+    {
+        _poolExecuted[i]->set(_pool->executed(i));
+        _poolStolen[i]->set(_pool->stolen(i));
+    }
+}
+
+void CameraRig::devicesChanged(rs2::event_information & info)
+{
+    int64_t now = traceNow();
+    try
+    {
+        vector<string> connected;
+        for (rs2::device && device : _context->query_devices())
+            connected.push_back(device.get_info(RS2_CAMERA_INFO_SERIAL_NUMBER));
+        vector<string> added;
+        for (rs2::device && device : info.get_new_devices())
+            added.push_back(device.get_info(RS2_CAMERA_INFO_SERIAL_NUMBER));
+
+        std::lock_guard<std::mutex> lock(_liveMutex);
+        for (auto & live : _live)
+        {
+            if (std::find(added.begin(), added.end(), live.first) != added.end())
+            {
+                poco_information(_logger, "camera " + live.first + " plugged in again");
+                live.second->deviceAdded(now);
+            }
+            else if (std::find(connected.begin(), connected.end(), live.first) == connected.end())
+            {
+                poco_warning(_logger, "camera " + live.first + " unplugged");
+                live.second->deviceRemoved();
+            }
+        }
+        for (const string & serial : added)
+        {
+            if (_live.count(serial) == 0)
+                poco_information(_logger, "camera " + serial + " plugged in, it is used from the next start");
+        }
+    }
+    catch (const rs2::error & e)
+    {
+        poco_warning(_logger, string("devices changed: ") + e.what());
+    }
+}
@@ -0,0 +1,81 @@
+#pragma once
+#include <future>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <Poco/Logger.h>
+#include <Poco/Util/AbstractConfiguration.h>
+#include "CameraSettings.h"
+#include "DetectionPublisher.h"
+#include "FramePipeline.h"
+#include "FrameSource.h"
+#include "Metrics.h"
+#include "NetPool.h"
+#include "RealSenseSource.h"
+
+// The cameras of the host, each streaming through a FramePipeline of its own, with the network run for all of them
+// by one shared NetPool. The inference stage of a camera waits for its detections before it takes the next frame,
+// so every camera has at most one job in the pool, and a camera delivering faster cannot crowd out the others.
+// Recordings given in cameras.playback, .bag files, video files or directories of images, stand in for the devices.
+// Devices unplugged while streaming are told so by the devices changed callback, and so are devices plugged in
+// again, which their source then starts right away. Devices new to the rig are used from the next start.
+class CameraRig
+{
+public:
+    // config is the application configuration, it has to outlive the rig
+    CameraRig(const Poco::Util::AbstractConfiguration & config);
+    ~CameraRig();
+    // begin loading and warming up the shared networks on a thread of its own, start waits for them once the
+    // devices are open, the custom layers to use must be registered until then
+    void loadModel(const std::string & prototxt, const std::string & caffemodel);
+
+    // open the configured cameras, or every connected one, and start their pipelines, returns the number of
+    // cameras started, 0 if there is none
+    size_t start();
+    // stop the pipelines and the devices
+    void stop();
+    bool isRunning() const { return !_cameras.empty(); }
+    size_t cameraCount() const { return _cameras.size(); }
+    FramePipeline & pipeline(size_t index) { return *_cameras[index]->pipeline; }
+    void setDetecting(bool on);
+    bool isDetecting() const { return _detecting; }
+    void setDepthView(bool on);
+
+private:
+    struct Camera
+    {
+        std::unique_ptr<FrameSource> source;
+        std::unique_ptr<FramePipeline> pipeline;
+    };
+
+    void startCamera(const CameraSettings & settings, const Poco::Util::AbstractConfiguration & cameras);
+    // with an auto profile, the cheapest color profile of device that serves the detector and the display
+    void chooseProfile(CameraSettings & settings, const rs2::device & device);
+    void collectPoolMetrics();
+    // the shared networks once loaded, rethrows what failed loading them
+    NetPool * waitForModel();
+    // runs on a librealsense thread
+    void devicesChanged(rs2::event_information & info);
+
+    Poco::Logger & _logger;
+    const Poco::Util::AbstractConfiguration & _config;
+    std::string _prototxt;
+    std::string _caffemodel;
+    const int _poolWorkers;
+    std::unique_ptr<NetPool> _pool;
+    std::shared_future<void> _modelLoaded;
+    std::vector<MetricCounter *> _poolExecuted;
+    std::vector<MetricCounter *> _poolStolen;
+    int _metricsCollector;
+    DetectionPublisher _publisher;
+    std::vector<std::unique_ptr<Camera>> _cameras;
+    bool _detecting;
+    bool _depthView;
+    // sources of the live devices by serial, for the devices changed callback
+    std::mutex _liveMutex;
+    std::map<std::string, RealSenseSource *> _live;
+    // context of the live devices, created on the first start using them, gone before the sources it reports to
+    std::unique_ptr<rs2::context> _context;
+};
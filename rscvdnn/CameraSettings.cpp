@@ -0,0 +1,131 @@
+#include <algorithm>
+#include <cmath>
+#include <string>
+#include <sstream>
+#include <vector>
+#include <stdexcept>
+#include <Poco/Util/AbstractConfiguration.h>
+#include "CameraSettings.h"
+
+using std::string;
+using std::vector;
+using Poco::Util::AbstractConfiguration;
+
+static int cameraInt(const AbstractConfiguration & config, const string & serial, const string & key, int value)
+{
+    return config.getInt(serial + "." + key, config.getInt(key, value));
+}
+
+static string cameraString(const AbstractConfiguration & config, const string & serial, const string & key, const string & value)
+{
+    return config.getString(serial + "." + key, config.getString(key, value));
+}
+
+static rs2_format parseColorFormat(const string & name)
+{
+    rs2_format format = parseStreamFormat(name);
+    if (bytesPerPixel(format) != 3)
+        throw std::invalid_argument("color format " + name + " is not rgb8 or bgr8");
+    return format;
+}
+
+// whether the color profile is chosen automatically
+static bool parseAutoProfile(const string & name)
+{
+    if (name == "auto")
+        return true;
+    if (name == "manual")
+        return false;
+    throw std::invalid_argument("stream profile " + name + " is not manual or auto");
+}
+
+static rs2_stream parseAlignTo(const string & name)
+{
+    if (name == "color")
+        return RS2_STREAM_COLOR;
+    if (name == "depth")
+        return RS2_STREAM_DEPTH;
+    throw std::invalid_argument("cannot align to stream " + name + ", use color or depth");
+}
+
+// x,y,width,height in pixels
+static cv::Rect parseRoi(const string & text)
+{
+    cv::Rect roi;
+    if (text.empty())
+        return roi;
+
+    std::istringstream in(text);
+    char comma[3];
+    if (!(in >> roi.x >> comma[0] >> roi.y >> comma[1] >> roi.width >> comma[2] >> roi.height)
+        || comma[0] != ',' || comma[1] != ',' || comma[2] != ',' || roi.width <= 0 || roi.height <= 0)
+        throw std::invalid_argument("roi " + text + " is not x,y,width,height");
+    return roi;
+}
+
+CameraSettings::CameraSettings(const AbstractConfiguration & config, const string & serial, const string & playback)
+    : serial{ serial }
+    , playback{ playback }
+    , color{ cv::Size(cameraInt(config, serial, "colorWidth", 1920), cameraInt(config, serial, "colorHeight", 1080)),
+        parseColorFormat(cameraString(config, serial, "colorFormat", "rgb8")),
+        cameraInt(config, serial, "colorFps", cameraInt(config, serial, "fps", 30)) }
+    , depth{ cv::Size(cameraInt(config, serial, "depthWidth", 640), cameraInt(config, serial, "depthHeight", 480)),
+        RS2_FORMAT_Z16, cameraInt(config, serial, "depthFps", cameraInt(config, serial, "fps", 30)) }
+    , autoProfile{ parseAutoProfile(cameraString(config, serial, "profile", "manual")) }
+    , displaySize{ cameraInt(config, serial, "displayWidth", 1280), cameraInt(config, serial, "displayHeight", 720) }
+    , alignTo{ parseAlignTo(cameraString(config, serial, "alignTo", "color")) }
+    , roi{ parseRoi(cameraString(config, serial, "roi", "")) }
+{
+}
+
+// the region of a color frame of size the detector is fed, roi given in a frame of size from
+static cv::Rect detectorCrop(const cv::Size & size, const cv::Size & from, const cv::Rect & roi)
+{
+    if (roi.empty())
+    {
+        // the largest centered square, the network input is square
+        int side = std::min(size.width, size.height);
+        return cv::Rect((size.width - side) / 2, (size.height - side) / 2, side, side);
+    }
+    double sx = (double)size.width / from.width, sy = (double)size.height / from.height;
+    return cv::Rect((int)std::lround(roi.x * sx), (int)std::lround(roi.y * sy),
+        (int)std::lround(roi.width * sx), (int)std::lround(roi.height * sy));
+}
+
+// less bandwidth, or as much in bgr8 against rgb8, which spares preprocess converting every frame detected on
+static bool cheaperProfile(const StreamProfile & profile, const StreamProfile & than)
+{
+    if (profile.bytesPerSecond() != than.bytesPerSecond())
+        return profile.bytesPerSecond() < than.bytesPerSecond();
+    return profile.format == RS2_FORMAT_BGR8 && than.format != RS2_FORMAT_BGR8;
+}
+
+bool CameraSettings::chooseColorProfile(const vector<StreamProfile> & offered, int inputSide)
+{
+    if (!autoProfile)
+        return false;
+
+    const StreamProfile * best = nullptr;
+    for (const StreamProfile & candidate : offered)
+    {
+        // 424x240 and 848x480 are within a percent of 16:9
+        double aspect = (double)candidate.size.width * color.size.height / ((double)candidate.size.height * color.size.width);
+        if (candidate.fps != color.fps || bytesPerPixel(candidate.format) != 3 || std::abs(aspect - 1.0) > 0.01)
+            continue;
+        if (candidate.size.width < displaySize.width || candidate.size.height < displaySize.height)
+            continue;
+        // aligned to depth, the detector sees depth resolution whatever the color resolution
+        cv::Rect crop = detectorCrop(candidate.size, color.size, roi);
+        if (alignTo == RS2_STREAM_COLOR && (crop.width < inputSide || crop.height < inputSide))
+            continue;
+        if (cheaperProfile(candidate, best != nullptr ? *best : color))
+            best = &candidate;
+    }
+    if (best == nullptr)
+        return false;
+
+    if (alignTo == RS2_STREAM_COLOR && !roi.empty())
+        roi = detectorCrop(best->size, color.size, roi);
+    color = *best;
+    return true;
+}
@@ -0,0 +1,34 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <Poco/Util/AbstractConfiguration.h>
+#include <librealsense2/rs.hpp>
+#include <opencv2/core.hpp>
+#include "StreamProfile.h"
+
+// Streams and detection area of one camera. Every key is looked up in the section of the camera, cameras.<serial>,
+// and falls back to the same key in the cameras section shared by all of them.
+struct CameraSettings
+{
+    // config is the cameras section, playback the .bag file standing in for the device or empty for a live device
+    CameraSettings(const Poco::Util::AbstractConfiguration & config, const std::string & serial, const std::string & playback);
+
+    // With autoProfile, replace the color profile by the cheapest one of offered at its frame rate and aspect ratio
+    // that still feeds the detector a crop of at least inputSide pixels square and is no smaller than displaySize,
+    // and scale the roi to it. False, keeping the configured profile, if none is cheaper.
+    bool chooseColorProfile(const std::vector<StreamProfile> & offered, int inputSide);
+
+    std::string serial;
+    std::string playback;
+    // color is rgb8 or bgr8, depth z16
+    StreamProfile color;
+    StreamProfile depth;
+    // choose the color profile, the configured one is the most expensive choice and the frame the roi is given in
+    bool autoProfile;
+    // smallest color frame the GUI shows without upscaling, empty if nobody looks
+    cv::Size displaySize;
+    // stream the other one is aligned to, the frames fed to the detector have its resolution
+    rs2_stream alignTo;
+    // region of the aligned frames fed to the detector, empty for the largest centered crop of the network aspect ratio
+    cv::Rect roi;
+};
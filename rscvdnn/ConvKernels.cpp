@@ -0,0 +1,300 @@
+#include <cstdint>
+#include <algorithm>
+#include <immintrin.h>
+#include <opencv2/core.hpp>
+#include "ConvKernels.h"
+
+bool cpuHasAvx2()
+{
+    static const bool hasAvx2 = cv::checkHardwareSupport(CV_CPU_AVX2) && cv::checkHardwareSupport(CV_CPU_FMA3);
+    return hasAvx2;
+}
+
+bool cpuHasF16c()
+{
+    static const bool hasF16c = cv::checkHardwareSupport(CV_CPU_FP16);
+    return hasF16c;
+}
+
+// one output pixel with the taps outside of the plane skipped, for the borders
+static inline float depthwisePixel(const float *src, int height, int width, const float *weights, int oy, int ox, int stride, int pad)
+{
+    float sum = 0.0f;
+    for (int ky = 0; ky < 3; ky++)
+    {
+        int iy = oy * stride - pad + ky;
+        if (iy < 0 || iy >= height)
+            continue;
+        for (int kx = 0; kx < 3; kx++)
+        {
+            int ix = ox * stride - pad + kx;
+            if (ix >= 0 && ix < width)
+                sum += weights[ky * 3 + kx] * src[iy * width + ix];
+        }
+    }
+    return sum;
+}
+
+// gather the even elements of 16 consecutive floats
+TARGET_AVX2 static inline __m256 loadEven(const float *p)
+{
+    __m256 v = _mm256_shuffle_ps(_mm256_loadu_ps(p), _mm256_loadu_ps(p + 8), _MM_SHUFFLE(2, 0, 2, 0));
+    return _mm256_castpd_ps(_mm256_permute4x64_pd(_mm256_castps_pd(v), _MM_SHUFFLE(3, 1, 2, 0)));
+}
+
+// 8 output pixels per iteration of an output row whose 3 input rows are all inside the plane,
+// returns the first column left for the scalar path
+TARGET_AVX2 static int depthwiseRowAvx2(const float *r0, const float *r1, const float *r2, int width, float *dst, int x, int xEnd,
+    const float *weights, float bias, int stride, int pad)
+{
+    const __m256 vw0 = _mm256_set1_ps(weights[0]), vw1 = _mm256_set1_ps(weights[1]), vw2 = _mm256_set1_ps(weights[2]);
+    const __m256 vw3 = _mm256_set1_ps(weights[3]), vw4 = _mm256_set1_ps(weights[4]), vw5 = _mm256_set1_ps(weights[5]);
+    const __m256 vw6 = _mm256_set1_ps(weights[6]), vw7 = _mm256_set1_ps(weights[7]), vw8 = _mm256_set1_ps(weights[8]);
+    const __m256 vbias = _mm256_set1_ps(bias);
+
+    if (stride == 1)
+    {
+        for (; x + 8 <= xEnd; x += 8)
+        {
+            int ix = x - pad;
+            __m256 sum = vbias;
+            sum = _mm256_fmadd_ps(vw0, _mm256_loadu_ps(r0 + ix), sum);
+            sum = _mm256_fmadd_ps(vw1, _mm256_loadu_ps(r0 + ix + 1), sum);
+            sum = _mm256_fmadd_ps(vw2, _mm256_loadu_ps(r0 + ix + 2), sum);
+            sum = _mm256_fmadd_ps(vw3, _mm256_loadu_ps(r1 + ix), sum);
+            sum = _mm256_fmadd_ps(vw4, _mm256_loadu_ps(r1 + ix + 1), sum);
+            sum = _mm256_fmadd_ps(vw5, _mm256_loadu_ps(r1 + ix + 2), sum);
+            sum = _mm256_fmadd_ps(vw6, _mm256_loadu_ps(r2 + ix), sum);
+            sum = _mm256_fmadd_ps(vw7, _mm256_loadu_ps(r2 + ix + 1), sum);
+            sum = _mm256_fmadd_ps(vw8, _mm256_loadu_ps(r2 + ix + 2), sum);
+            _mm256_storeu_ps(dst + x, sum);
+        }
+    }
+    else if (stride == 2)
+    {
+        // each tap reads 16 floats and keeps every other one, the last read must stay inside the row
+        for (; x + 8 <= xEnd && 2 * x - pad + 17 < width; x += 8)
+        {
+            int ix = 2 * x - pad;
+            __m256 sum = vbias;
+            sum = _mm256_fmadd_ps(vw0, loadEven(r0 + ix), sum);
+            sum = _mm256_fmadd_ps(vw1, loadEven(r0 + ix + 1), sum);
+            sum = _mm256_fmadd_ps(vw2, loadEven(r0 + ix + 2), sum);
+            sum = _mm256_fmadd_ps(vw3, loadEven(r1 + ix), sum);
+            sum = _mm256_fmadd_ps(vw4, loadEven(r1 + ix + 1), sum);
+            sum = _mm256_fmadd_ps(vw5, loadEven(r1 + ix + 2), sum);
+            sum = _mm256_fmadd_ps(vw6, loadEven(r2 + ix), sum);
+            sum = _mm256_fmadd_ps(vw7, loadEven(r2 + ix + 1), sum);
+            sum = _mm256_fmadd_ps(vw8, loadEven(r2 + ix + 2), sum);
+            _mm256_storeu_ps(dst + x, sum);
+        }
+    }
+    return x;
+}
+
+void depthwiseConv3x3(const float *src, int height, int width, float *dst, int outHeight, int outWidth,
+    const float *weights, float bias, int stride, int pad, bool relu, bool useAvx2)
+{
+    // range of output columns whose 3 taps all fall inside an input row
+    const int xBegin = std::min(outWidth, (pad + stride - 1) / stride);
+    const int xEnd = std::max(xBegin, std::min(outWidth, (width - 3 + pad) / stride + 1));
+
+    for (int oy = 0; oy < outHeight; oy++)
+    {
+        float *out = dst + oy * outWidth;
+        const int iy = oy * stride - pad;
+        int ox = 0;
+        if (iy >= 0 && iy + 2 < height)
+        {
+            for (; ox < xBegin; ox++)
+                out[ox] = bias + depthwisePixel(src, height, width, weights, oy, ox, stride, pad);
+
+            const float *r0 = src + iy * width;
+            const float *r1 = r0 + width;
+            const float *r2 = r1 + width;
+            if (useAvx2)
+                ox = depthwiseRowAvx2(r0, r1, r2, width, out, ox, xEnd, weights, bias, stride, pad);
+            for (; ox < xEnd; ox++)
+            {
+                const float *p0 = r0 + ox * stride - pad;
+                const float *p1 = r1 + ox * stride - pad;
+                const float *p2 = r2 + ox * stride - pad;
+                float sum = weights[0] * p0[0] + weights[1] * p0[1] + weights[2] * p0[2]
+                          + weights[3] * p1[0] + weights[4] * p1[1] + weights[5] * p1[2]
+                          + weights[6] * p2[0] + weights[7] * p2[1] + weights[8] * p2[2];
+                out[ox] = bias + sum;
+            }
+        }
+
+        for (; ox < outWidth; ox++)
+            out[ox] = bias + depthwisePixel(src, height, width, weights, oy, ox, stride, pad);
+
+        // rectify while the row is still in L1 instead of a separate pass over the blob
+        if (relu)
+        {
+            for (int x = 0; x < outWidth; x++)
+                out[x] = std::max(out[x], 0.0f);
+        }
+    }
+}
+
+// input channels accumulated per pass, keeps the input panel of a pixel tile within L2
+static const int PointwiseChannelTile = 256;
+
+size_t packedPointwiseSize(int outChannels, int inChannels)
+{
+    return (size_t)((outChannels + PointwiseBlock - 1) / PointwiseBlock) * inChannels * PointwiseBlock;
+}
+
+void packPointwiseWeights(const float *weights, int outChannels, int inChannels, float *packed)
+{
+    for (int oc = 0; oc < outChannels; oc += PointwiseBlock)
+    {
+        float *block = packed + (size_t)(oc / PointwiseBlock) * inChannels * PointwiseBlock;
+        for (int ic = 0; ic < inChannels; ic++)
+        {
+            for (int o = 0; o < PointwiseBlock; o++)
+                block[ic * PointwiseBlock + o] = (oc + o < outChannels) ? weights[(size_t)(oc + o) * inChannels + ic] : 0.0f;
+        }
+    }
+}
+
+// broadcast each of the PointwiseBlock weights of one input channel to a vector
+TARGET_AVX2 static inline void broadcastWeights(const float *weights, __m256 w[PointwiseBlock])
+{
+    for (int o = 0; o < PointwiseBlock; o++)
+        w[o] = _mm256_broadcast_ss(weights + o);
+}
+
+TARGET_AVX2 static inline void broadcastWeights(const uint16_t *weights, __m256 w[PointwiseBlock])
+{
+    // the half weights of the block are widened with F16C and then spread lane by lane
+    __m256 block = _mm256_castps128_ps256(_mm_cvtph_ps(_mm_loadl_epi64((const __m128i *)weights)));
+    for (int o = 0; o < PointwiseBlock; o++)
+        w[o] = _mm256_permutevar8x32_ps(block, _mm256_set1_epi32(o));
+}
+
+static inline float weightValue(float weight)
+{
+    return weight;
+}
+
+TARGET_F16C static inline float weightValue(uint16_t weight)
+{
+    return _cvtsh_ss(weight);
+}
+
+// register blocked micro-kernel, PointwiseBlock output channels by V vectors of 8 pixels read from a packed panel of
+// [icCount][V * 8] input values, accumulators start from the bias on the first channel tile and from the partial sums
+// in dst otherwise
+template <int V, typename W>
+TARGET_AVX2 static void pointwiseTileAvx2(const float *panel, int icCount, const W *weights, const float *bias,
+    float *dst, int pixels, bool first, bool relu)
+{
+    __m256 acc[PointwiseBlock][V];
+    for (int o = 0; o < PointwiseBlock; o++)
+    {
+        for (int v = 0; v < V; v++)
+            acc[o][v] = first ? _mm256_set1_ps(bias[o]) : _mm256_loadu_ps(dst + o * pixels + v * 8);
+    }
+
+    for (int ic = 0; ic < icCount; ic++, panel += V * 8, weights += PointwiseBlock)
+    {
+        __m256 x[V];
+        for (int v = 0; v < V; v++)
+            x[v] = _mm256_load_ps(panel + v * 8);
+        __m256 w[PointwiseBlock];
+        broadcastWeights(weights, w);
+        for (int o = 0; o < PointwiseBlock; o++)
+        {
+            for (int v = 0; v < V; v++)
+                acc[o][v] = _mm256_fmadd_ps(w[o], x[v], acc[o][v]);
+        }
+    }
+
+    const __m256 zero = _mm256_setzero_ps();
+    for (int o = 0; o < PointwiseBlock; o++)
+    {
+        for (int v = 0; v < V; v++)
+            _mm256_storeu_ps(dst + o * pixels + v * 8, relu ? _mm256_max_ps(acc[o][v], zero) : acc[o][v]);
+    }
+}
+
+// copy the strided input columns of a pixel tile into a contiguous panel, the blocked layout the micro-kernel streams
+TARGET_AVX2 static void packPanel(const float *src, int pixels, int icCount, int width, float *panel)
+{
+    for (int ic = 0; ic < icCount; ic++, src += pixels, panel += width)
+    {
+        for (int x = 0; x < width; x += 8)
+            _mm256_store_ps(panel + x, _mm256_loadu_ps(src + x));
+    }
+}
+
+template <int V, typename W>
+TARGET_AVX2 static void pointwiseColumnsAvx2(const float *src, int pixels, int icCount, const W *packed, int inChannels, int icBegin,
+    const float *bias, float *dst, int ocBegin, int ocEnd, int p, bool first, bool relu, float *panel)
+{
+    packPanel(src + p, pixels, icCount, V * 8, panel);
+    for (int oc = ocBegin; oc < ocEnd; oc += PointwiseBlock)
+    {
+        const W *weights = packed + ((size_t)(oc / PointwiseBlock) * inChannels + icBegin) * PointwiseBlock;
+        pointwiseTileAvx2<V>(panel, icCount, weights, bias + oc, dst + (size_t)oc * pixels + p, pixels, first, relu);
+    }
+}
+
+template <typename W>
+static void pointwiseConvPacked(const float *src, int inChannels, int pixels, const W *packed, const float *bias, float *dst, int outChannels,
+    int ocBegin, int ocEnd, int pBegin, int pEnd, bool relu, bool useAvx2)
+{
+    // the vectorized path covers the full blocks of output channels, the rest goes through the scalar loop
+    const int ocVectorEnd = useAvx2 ? ocBegin + (ocEnd - ocBegin) / PointwiseBlock * PointwiseBlock : ocBegin;
+    alignas(32) float panel[PointwiseChannelTile * 24];
+
+    for (int icBegin = 0; icBegin < inChannels; icBegin += PointwiseChannelTile)
+    {
+        const int icEnd = std::min(inChannels, icBegin + PointwiseChannelTile);
+        const int icCount = icEnd - icBegin;
+        const bool first = (icBegin == 0);
+        const bool rectify = relu && icEnd == inChannels;
+        const float *srcTile = src + (size_t)icBegin * pixels;
+
+        int p = pBegin;
+        if (ocVectorEnd > ocBegin)
+        {
+            for (; p + 24 <= pEnd; p += 24)
+                pointwiseColumnsAvx2<3>(srcTile, pixels, icCount, packed, inChannels, icBegin, bias, dst, ocBegin, ocVectorEnd, p, first, rectify, panel);
+            for (; p + 8 <= pEnd; p += 8)
+                pointwiseColumnsAvx2<1>(srcTile, pixels, icCount, packed, inChannels, icBegin, bias, dst, ocBegin, ocVectorEnd, p, first, rectify, panel);
+        }
+
+        // pixels left over by the vectorized path for its channels, and all pixels of the remaining channels
+        for (int oc = ocBegin; oc < ocEnd; oc += PointwiseBlock)
+        {
+            const int ocCount = std::min(PointwiseBlock, outChannels - oc);
+            const W *weights = packed + ((size_t)(oc / PointwiseBlock) * inChannels + icBegin) * PointwiseBlock;
+            float *dstBlock = dst + (size_t)oc * pixels;
+            for (int x = (oc < ocVectorEnd) ? p : pBegin; x < pEnd; x++)
+            {
+                for (int o = 0; o < ocCount; o++)
+                {
+                    float sum = first ? bias[oc + o] : dstBlock[o * pixels + x];
+                    for (int ic = icBegin; ic < icEnd; ic++)
+                        sum += weightValue(weights[(ic - icBegin) * PointwiseBlock + o]) * src[(size_t)ic * pixels + x];
+                    dstBlock[o * pixels + x] = rectify ? std::max(sum, 0.0f) : sum;
+                }
+            }
+        }
+    }
+}
+
+void pointwiseConv(const float *src, int inChannels, int pixels, const float *packed, const float *bias, float *dst, int outChannels,
+    int ocBegin, int ocEnd, int pBegin, int pEnd, bool relu, bool useAvx2)
+{
+    pointwiseConvPacked(src, inChannels, pixels, packed, bias, dst, outChannels, ocBegin, ocEnd, pBegin, pEnd, relu, useAvx2);
+}
+
+void pointwiseConv(const float *src, int inChannels, int pixels, const uint16_t *packed, const float *bias, float *dst, int outChannels,
+    int ocBegin, int ocEnd, int pBegin, int pEnd, bool relu, bool useAvx2)
+{
+    pointwiseConvPacked(src, inChannels, pixels, packed, bias, dst, outChannels, ocBegin, ocEnd, pBegin, pEnd, relu, useAvx2);
+}
@@ -0,0 +1,44 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+// Hand-vectorized convolution kernels behind the custom DNN layers, working on single NCHW float planes.
+// The AVX2 paths must only be selected when the CPU supports both AVX2 and FMA3.
+
+// true if the CPU running the process supports the AVX2 kernels
+bool cpuHasAvx2();
+// true if the CPU converts half floats in hardware (F16C), required by the kernels on half weights
+bool cpuHasF16c();
+
+// the vectorized functions are compiled for their instruction set whatever the rest of the build targets, so the
+// paths chosen at run time by cpuHasAvx2 and cpuHasF16c are the only ones using it, MSVC takes the intrinsics as they are
+#ifdef _MSC_VER
+#define TARGET_AVX2
+#define TARGET_F16C
+#else
+#define TARGET_AVX2 __attribute__((target("avx2,fma,f16c")))
+#define TARGET_F16C __attribute__((target("f16c")))
+#endif
+
+// 3x3 depthwise convolution of one channel plane, weights are the 9 taps in row-major order,
+// the optional ReLU is applied to each output row while it is still in cache
+void depthwiseConv3x3(const float *src, int height, int width, float *dst, int outHeight, int outWidth,
+    const float *weights, float bias, int stride, int pad, bool relu, bool useAvx2);
+
+// output channels per block of packed 1x1 convolution weights
+const int PointwiseBlock = 4;
+
+// number of floats of the packed weights of a 1x1 convolution
+size_t packedPointwiseSize(int outChannels, int inChannels);
+// pack [outChannels][inChannels] weights into blocks of PointwiseBlock output channels, [block][inChannels][PointwiseBlock],
+// the last block is zero padded
+void packPointwiseWeights(const float *weights, int outChannels, int inChannels, float *packed);
+// 1x1 convolution of one image from src [inChannels][pixels] to dst [outChannels][pixels], restricted to the output
+// channels [ocBegin, ocEnd) and the pixels [pBegin, pEnd), ocBegin must be a multiple of PointwiseBlock,
+// bias and the optional ReLU are applied while accumulating
+void pointwiseConv(const float *src, int inChannels, int pixels, const float *packed, const float *bias, float *dst, int outChannels,
+    int ocBegin, int ocEnd, int pBegin, int pEnd, bool relu, bool useAvx2);
+// the same on packed weights stored as IEEE half floats, converted to float on the fly while they are loaded,
+// requires F16C even when useAvx2 is false
+void pointwiseConv(const float *src, int inChannels, int pixels, const uint16_t *packed, const float *bias, float *dst, int outChannels,
+    int ocBegin, int ocEnd, int pBegin, int pEnd, bool relu, bool useAvx2);
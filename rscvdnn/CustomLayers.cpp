@@ -0,0 +1,140 @@
+#include <string>
+#include <vector>
+#include <map>
+#include <mutex>
+#include <cstdint>
+#include <Poco/Util/AbstractConfiguration.h>
+#include <opencv2/dnn.hpp>
+#include <opencv2/dnn/all_layers.hpp>
+#include "CustomLayers.h"
+#include "DepthwiseConvLayer.h"
+#include "PointwiseConvLayer.h"
+#include "CachedPriorBoxLayer.h"
+#include "FastDetectionOutputLayer.h"
+
+using std::string;
+using std::vector;
+using Poco::Util::AbstractConfiguration;
+using cv::dnn::LayerParams;
+using cv::dnn::LayerFactory;
+
+static CustomLayerSettings activeSettings;
+static vector<string> registeredTypes;
+static std::mutex sharedWeightsMutex;
+static std::map<string, cv::Mat> sharedWeightsCache;
+
+CustomLayerSettings::CustomLayerSettings()
+    : depthwiseConv{ false }
+    , pointwiseConv{ false }
+    , cachedPriorBox{ false }
+    , fastDetectionOutput{ false }
+    , fp16Weights{ false }
+{
+}
+
+CustomLayerSettings::CustomLayerSettings(const AbstractConfiguration & config)
+    : depthwiseConv{ config.getBool("depthwiseConv", false) }
+    , pointwiseConv{ config.getBool("pointwiseConv", false) }
+    , cachedPriorBox{ config.getBool("cachedPriorBox", false) }
+    , fastDetectionOutput{ config.getBool("fastDetectionOutput", false) }
+    , fp16Weights{ config.getBool("fp16Weights", false) }
+{
+}
+
+// all Convolution layers are created here, the custom implementations take the shapes they are specialized for
+static cv::Ptr<cv::dnn::Layer> createConvolution(LayerParams & params)
+{
+    if (activeSettings.depthwiseConv && DepthwiseConvLayer::accepts(params))
+        return DepthwiseConvLayer::create(params);
+    if (activeSettings.pointwiseConv && PointwiseConvLayer::accepts(params))
+        return PointwiseConvLayer::create(params);
+    return cv::dnn::ConvolutionLayer::create(params);
+}
+
+static cv::Ptr<cv::dnn::Layer> createDetectionOutput(LayerParams & params)
+{
+    if (FastDetectionOutputLayer::accepts(params))
+        return FastDetectionOutputLayer::create(params);
+    return cv::dnn::DetectionOutputLayer::create(params);
+}
+
+static void registerLayer(const string & type, LayerFactory::Constructor constructor)
+{
+    LayerFactory::registerLayer(type, constructor);
+    registeredTypes.push_back(type);
+}
+
+void registerCustomLayers(const CustomLayerSettings & settings)
+{
+    unregisterCustomLayers();
+    activeSettings = settings;
+
+    if (settings.depthwiseConv || settings.pointwiseConv)
+        registerLayer("Convolution", createConvolution);
+    if (settings.cachedPriorBox)
+        registerLayer("PriorBox", CachedPriorBoxLayer::create);
+    if (settings.fastDetectionOutput)
+        registerLayer("DetectionOutput", createDetectionOutput);
+}
+
+void unregisterCustomLayers()
+{
+    // the factory keeps a stack of constructors per layer type, unregistering pops back to the stock one
+    for (const string & type : registeredTypes)
+        LayerFactory::unregisterLayer(type);
+    registeredTypes.clear();
+    activeSettings = CustomLayerSettings();
+
+    // networks already loaded hold their own references to the shared weights
+    std::lock_guard<std::mutex> lock(sharedWeightsMutex);
+    sharedWeightsCache.clear();
+}
+
+const CustomLayerSettings & customLayerSettings()
+{
+    return activeSettings;
+}
+
+bool isCustomLayer(const cv::Ptr<cv::dnn::Layer> & layer)
+{
+    return !layer.dynamicCast<DepthwiseConvLayer>().empty() || !layer.dynamicCast<PointwiseConvLayer>().empty()
+        || !layer.dynamicCast<CachedPriorBoxLayer>().empty()
+        || !layer.dynamicCast<FastDetectionOutputLayer>().empty();
+}
+
+cv::Mat sharedWeights(const LayerParams & params, const std::function<cv::Mat()> & prepare)
+{
+    // FNV-1a over the original weights, networks of the same model produce the same key for the same layer
+    const cv::Mat & weights = params.blobs[0];
+    CV_Assert(weights.isContinuous());
+    uint64_t hash = 14695981039346656037ull;
+    for (size_t i = 0, bytes = weights.total() * weights.elemSize(); i < bytes; i++)
+        hash = (hash ^ weights.data[i]) * 1099511628211ull;
+    string key = params.name + "/" + std::to_string(hash) + (activeSettings.fp16Weights ? "/fp16" : "/fp32");
+
+    std::lock_guard<std::mutex> lock(sharedWeightsMutex);
+    auto found = sharedWeightsCache.find(key);
+    if (found == sharedWeightsCache.end())
+        found = sharedWeightsCache.emplace(key, prepare()).first;
+    return found->second;
+}
+
+int squareConvParam(const LayerParams & params, const string & name, const string & alias, int defaultValue)
+{
+    if (params.has(alias))
+    {
+        const cv::dnn::DictValue & value = params.get(alias);
+        if (value.size() > 1 && value.get<int>(1) != value.get<int>(0))
+            return -1;
+        return value.get<int>(0);
+    }
+
+    if (params.has(name + "_h") || params.has(name + "_w"))
+    {
+        int h = params.get<int>(name + "_h", defaultValue);
+        int w = params.get<int>(name + "_w", defaultValue);
+        return (h == w) ? h : -1;
+    }
+
+    return defaultValue;
+}
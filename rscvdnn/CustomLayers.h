@@ -0,0 +1,35 @@
+#pragma once
+#include <string>
+#include <functional>
+#include <Poco/Util/AbstractConfiguration.h>
+#include <opencv2/dnn.hpp>
+
+// which of the custom DNN layer implementations replace the stock OpenCV ones
+struct CustomLayerSettings
+{
+    CustomLayerSettings();
+    CustomLayerSettings(const Poco::Util::AbstractConfiguration & config);
+    bool depthwiseConv;
+    bool pointwiseConv;
+    bool cachedPriorBox;
+    bool fastDetectionOutput;
+    // store the weights of the custom convolutions as half floats
+    bool fp16Weights;
+};
+
+// register the enabled custom layers to the cv::dnn layer factory, networks loaded afterwards pick them up,
+// layers not handled by a custom implementation still get the stock one
+void registerCustomLayers(const CustomLayerSettings & settings);
+// restore the stock layer implementations for networks loaded afterwards
+void unregisterCustomLayers();
+const CustomLayerSettings & customLayerSettings();
+// true if layer is one of the custom implementations
+bool isCustomLayer(const cv::Ptr<cv::dnn::Layer> & layer);
+
+// weights derived by prepare from the original weights of a layer, shared by every network loaded from the same model
+// while the custom layers are registered, so a pool of networks keeps a single copy
+cv::Mat sharedWeights(const cv::dnn::LayerParams & params, const std::function<cv::Mat()> & prepare);
+
+// square convolution parameter given either as alias (e.g. kernel_size) or as name_h and name_w,
+// -1 if height and width differ
+int squareConvParam(const cv::dnn::LayerParams & params, const std::string & name, const std::string & alias, int defaultValue);
@@ -0,0 +1,278 @@
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+#include <stdexcept>
+#include <vector>
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#include <opencv2/core.hpp>
+#include "DepthCodec.h"
+#include "ConvKernels.h"
+
+// index of the lowest set bit, mask must not be 0
+static inline int lowestBit(uint32_t mask)
+{
+#ifdef _MSC_VER
+    unsigned long index;
+    _BitScanForward(&index, mask);
+    return (int)index;
+#else
+    return __builtin_ctz(mask);
+#endif
+}
+
+// writes variable length codes into 32 bit words, the nibbles not filling a word yet wait in an accumulator
+class NibbleWriter
+{
+public:
+    NibbleWriter(uint8_t *out) : _begin{ out }, _out{ out }, _acc{ 0 }, _pending{ 0 } {}
+
+    void put(uint32_t value)
+    {
+        // most differences of a smooth surface fit a single nibble
+        if (value < 8)
+        {
+            _acc = (_acc << 4) | value;
+            if (++_pending == 8)
+            {
+                _pending = 0;
+                flushWord((uint32_t)_acc);
+            }
+            return;
+        }
+        uint64_t code = 0;
+        int count = 0;
+        do
+        {
+            uint32_t nibble = value & 0x7;
+            value >>= 3;
+            if (value != 0)
+                nibble |= 0x8;
+            code = (code << 4) | nibble;
+            count++;
+        } while (value != 0);
+        if (count > 8)
+        {
+            putNibbles(code >> 4 * (count - 8), 8);
+            count -= 8;
+        }
+        putNibbles(code, count);
+    }
+
+    // append count nibbles, at most 8, from the low bits of code, the first one highest
+    void putNibbles(uint64_t code, int count)
+    {
+        _acc = (_acc << 4 * count) | (code & ((1ull << 4 * count) - 1));
+        _pending += count;
+        if (_pending >= 8)
+        {
+            _pending -= 8;
+            flushWord((uint32_t)(_acc >> 4 * _pending));
+        }
+    }
+
+    size_t finish()
+    {
+        if (_pending > 0)
+            flushWord((uint32_t)(_acc << 4 * (8 - _pending)));
+        _pending = 0;
+        return _out - _begin;
+    }
+
+private:
+    void flushWord(uint32_t word)
+    {
+        uint8_t bytes[4] = { (uint8_t)word, (uint8_t)(word >> 8), (uint8_t)(word >> 16), (uint8_t)(word >> 24) };
+        std::memcpy(_out, bytes, 4);
+        _out += 4;
+    }
+
+    uint8_t *const _begin;
+    uint8_t *_out;
+    uint64_t _acc;
+    int _pending;
+};
+
+static inline uint32_t zigzag(int delta)
+{
+    return ((uint32_t)delta << 1) ^ (uint32_t)(delta >> 31);
+}
+
+// pixels from p on, 16 at a time, up to the first that ends a run of zero or nonzero pixels or the last full 16,
+// returns where the scalar path goes on
+TARGET_AVX2 static const uint16_t * runLengthAvx2(const uint16_t *p, const uint16_t *end, bool zero)
+{
+    const __m256i vzero = _mm256_setzero_si256();
+    for (; end - p >= 16; p += 16)
+    {
+        // two mask bits per pixel, set where the pixel continues the run
+        uint32_t mask = (uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi16(_mm256_loadu_si256((const __m256i *)p), vzero));
+        if (!zero)
+            mask = ~mask;
+        if (mask != 0xffffffff)
+            return p + lowestBit(~mask) / 2;
+    }
+    return p;
+}
+
+// number of pixels from p on up to end that are zero, or nonzero if zero is false
+static inline size_t runLength(const uint16_t *p, const uint16_t *end, bool zero, bool useAvx2)
+{
+    const uint16_t *start = p;
+    if (useAvx2)
+        p = runLengthAvx2(p, end, zero);
+    while (p != end && ((*p == 0) == zero))
+        p++;
+    return p - start;
+}
+
+// the codes of the pixels of a run from i on, 8 at a time, returns the first pixel left for the scalar path
+TARGET_AVX2 static size_t writeRunAvx2(const uint16_t *p, size_t i, size_t count, NibbleWriter & writer)
+{
+    const __m256i shifts = _mm256_setr_epi32(28, 24, 20, 16, 12, 8, 4, 0);
+    const __m256i seven = _mm256_set1_epi32(7);
+    alignas(32) uint32_t coded[8];
+    for (; i + 8 <= count; i += 8)
+    {
+        __m256i current = _mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i *)(p + i)));
+        __m256i before = _mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i *)(p + i - 1)));
+        __m256i delta = _mm256_sub_epi32(current, before);
+        __m256i zz = _mm256_xor_si256(_mm256_slli_epi32(delta, 1), _mm256_srai_epi32(delta, 31));
+        if (_mm256_movemask_epi8(_mm256_cmpgt_epi32(zz, seven)) == 0)
+        {
+            // eight single nibble codes make up one word, shifted into place and or-ed together
+            __m256i nibbles = _mm256_sllv_epi32(zz, shifts);
+            __m128i half = _mm_or_si128(_mm256_castsi256_si128(nibbles), _mm256_extracti128_si256(nibbles, 1));
+            half = _mm_or_si128(half, _mm_unpackhi_epi64(half, half));
+            half = _mm_or_si128(half, _mm_srli_epi64(half, 32));
+            writer.putNibbles((uint32_t)_mm_cvtsi128_si32(half), 8);
+            continue;
+        }
+        _mm256_store_si256((__m256i *)coded, zz);
+        for (uint32_t value : coded)
+            writer.put(value);
+    }
+    return i;
+}
+
+// write the zigzag coded differences of a run of nonzero pixels to the pixel before each, previous before the first
+static inline void writeRun(const uint16_t *p, size_t count, uint16_t previous, NibbleWriter & writer, bool useAvx2)
+{
+    writer.put(zigzag((int)p[0] - (int)previous));
+    size_t i = 1;
+    if (useAvx2)
+        i = writeRunAvx2(p, i, count, writer);
+    for (; i < count; i++)
+        writer.put(zigzag((int)p[i] - (int)p[i - 1]));
+}
+
+size_t rvlMaxEncodedSize(size_t pixels)
+{
+    // a lone nonzero pixel between zeros takes a zero run, a nonzero run and a difference of up to 6 nibbles,
+    // and any run length fits 11 nibbles
+    return ((pixels * 8 + 2 * 11) / 8 + 1) * 4;
+}
+
+size_t rvlEncode(const uint16_t *depth, size_t pixels, uint8_t *out, bool useAvx2)
+{
+    NibbleWriter writer(out);
+    const uint16_t *p = depth;
+    const uint16_t *end = depth + pixels;
+    uint16_t previous = 0;
+    while (p != end)
+    {
+        size_t zeros = runLength(p, end, true, useAvx2);
+        p += zeros;
+        size_t nonzeros = runLength(p, end, false, useAvx2);
+        writer.put((uint32_t)zeros);
+        writer.put((uint32_t)nonzeros);
+        if (nonzeros > 0)
+        {
+            writeRun(p, nonzeros, previous, writer, useAvx2);
+            p += nonzeros;
+            previous = p[-1];
+        }
+    }
+    return writer.finish();
+}
+
+bool rvlDecode(const uint8_t *in, size_t size, uint16_t *depth, size_t pixels)
+{
+    const uint8_t *inEnd = in + size;
+    uint32_t word = 0;
+    int nibbles = 0;
+    bool corrupt = false;
+    auto get = [&]() -> uint32_t
+    {
+        uint32_t value = 0;
+        for (int shift = 0; ; shift += 3)
+        {
+            // a code longer than any value is corrupt
+            if (shift > 30)
+            {
+                corrupt = true;
+                return 0;
+            }
+            if (nibbles == 0)
+            {
+                // as is one running past the stream
+                if (inEnd - in < 4)
+                {
+                    corrupt = true;
+                    return 0;
+                }
+                word = (uint32_t)in[0] | ((uint32_t)in[1] << 8) | ((uint32_t)in[2] << 16) | ((uint32_t)in[3] << 24);
+                in += 4;
+                nibbles = 8;
+            }
+            uint32_t nibble = word >> 28;
+            word <<= 4;
+            nibbles--;
+            value |= (nibble & 0x7) << shift;
+            if ((nibble & 0x8) == 0)
+                return value;
+        }
+    };
+
+    uint16_t *p = depth;
+    uint16_t *end = depth + pixels;
+    int previous = 0;
+    while (p != end)
+    {
+        uint32_t zeros = get();
+        if (corrupt || zeros > (size_t)(end - p))
+            return false;
+        std::fill(p, p + zeros, (uint16_t)0);
+        p += zeros;
+        uint32_t nonzeros = get();
+        if (corrupt || nonzeros > (size_t)(end - p))
+            return false;
+        for (uint32_t i = 0; i < nonzeros; i++)
+        {
+            uint32_t coded = get();
+            int current = previous + (int)((coded >> 1) ^ (0 - (coded & 1)));
+            if (corrupt || current <= 0 || current > 0xffff)
+                return false;
+            *p++ = (uint16_t)current;
+            previous = current;
+        }
+    }
+    return true;
+}
+
+void encodeDepthRvl(const cv::Mat & depth, std::vector<uint8_t> & out)
+{
+    if (depth.type() != CV_16UC1)
+        throw std::invalid_argument("RVL encodes 16 bit depth only");
+    cv::Mat continuous = depth.isContinuous() ? depth : depth.clone();
+    out.resize(rvlMaxEncodedSize(continuous.total()));
+    out.resize(rvlEncode(continuous.ptr<uint16_t>(), continuous.total(), out.data(), cpuHasAvx2()));
+}
+
+bool decodeDepthRvl(const uint8_t *in, size_t size, const cv::Size & frameSize, cv::Mat & depth)
+{
+    depth.create(frameSize, CV_16UC1);
+    return rvlDecode(in, size, depth.ptr<uint16_t>(), depth.total());
+}
@@ -0,0 +1,25 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include <opencv2/core.hpp>
+
+// Lossless compression of Z16 depth frames after RVL (A. D. Wilson, Fast Lossless Depth Image Compression, 2017).
+// The pixels are coded as alternating runs of zeros and of nonzero pixels, every nonzero pixel as the zigzag coded
+// difference to the nonzero pixel before it. Run lengths and differences are variable length codes of 4 bit
+// nibbles, 3 bits of value and a continuation bit, packed from the high nibble down into 32 bit little endian
+// words. The stream does not hold the frame size, the decoder has to know it.
+// The AVX2 path finds the runs 16 pixels at a time and codes 8 differences at a time, packing them into a word at
+// once if they all fit a nibble, and produces the same stream.
+
+// bytes an encoded frame of pixels takes at most
+size_t rvlMaxEncodedSize(size_t pixels);
+// encode pixels depth values into out, which must hold rvlMaxEncodedSize, returns the bytes written
+size_t rvlEncode(const uint16_t *depth, size_t pixels, uint8_t *out, bool useAvx2);
+// decode exactly pixels depth values, false if the stream is corrupt or does not hold as many
+bool rvlDecode(const uint8_t *in, size_t size, uint16_t *depth, size_t pixels);
+
+// the same on mats, depth must be CV_16UC1, the fastest path the CPU supports is taken
+void encodeDepthRvl(const cv::Mat & depth, std::vector<uint8_t> & out);
+// depth is allocated with the given size if it has not that size yet
+bool decodeDepthRvl(const uint8_t *in, size_t size, const cv::Size & frameSize, cv::Mat & depth);
@@ -0,0 +1,82 @@
+#include <vector>
+#include <algorithm>
+#include <Poco/Util/AbstractConfiguration.h>
+#include <opencv2/opencv.hpp>
+#include "DepthRegionProposal.h"
+
+using std::vector;
+using Poco::Util::AbstractConfiguration;
+
+DepthRegionProposal::DepthRegionProposal(const AbstractConfiguration & config)
+    : _enabled{ config.getBool("enabled", false) }
+    , _nearMeters{ config.getDouble("nearMeters", 0.3) }
+    , _farMeters{ config.getDouble("farMeters", 4.0) }
+    , _cellSize{ std::max(1, config.getInt("cellSize", 32)) }
+    , _minFill{ config.getDouble("minFill", 0.25) }
+    , _padCells{ config.getInt("padCells", 1) }
+    , _maxRegions{ config.getInt("maxRegions", 4) }
+    , _maxCoverage{ config.getDouble("maxCoverage", 0.6) }
+    , _minRegionSize{ config.getInt("minRegionSize", 160) }
+    , _pixelsProposed{ 0 }
+    , _pixelsFull{ 0 }
+{
+}
+
+bool DepthRegionProposal::propose(const cv::Mat & depthRoi, float depthScale, vector<cv::Rect> & regions)
+{
+    regions.clear();
+    if (!_enabled || depthScale <= 0.0f)
+        return false;
+
+    const uint64_t roiPixels = (uint64_t)depthRoi.total();
+    _pixelsFull += roiPixels;
+
+    // pixels within range, zero depth is no data and always out of range
+    double lower = std::max(1.0, _nearMeters / depthScale);
+    double upper = _farMeters / depthScale;
+    cv::inRange(depthRoi, cv::Scalar(lower), cv::Scalar(upper), _mask);
+
+    // area interpolation averages the mask, each grid cell then holds the filled fraction * 255
+    cv::Size gridSize(std::max(1, depthRoi.cols / _cellSize), std::max(1, depthRoi.rows / _cellSize));
+    cv::resize(_mask, _grid, gridSize, 0, 0, cv::INTER_AREA);
+    cv::threshold(_grid, _grid, _minFill * 255.0, 255, cv::THRESH_BINARY);
+    if (_padCells > 0)
+        cv::dilate(_grid, _grid, cv::Mat(), cv::Point(-1, -1), _padCells);
+
+    int count = cv::connectedComponentsWithStats(_grid, _labels, _stats, _centroids, 8, CV_32S);
+    // label 0 is the background
+    if (count - 1 > _maxRegions)
+    {
+        _pixelsProposed += roiPixels;
+        return false;
+    }
+
+    // crops are batched, so all of them take the size of the largest occupied area
+    double cellWidth = (double)depthRoi.cols / gridSize.width;
+    double cellHeight = (double)depthRoi.rows / gridSize.height;
+    int side = _minRegionSize;
+    for (int i = 1; i < count; i++)
+    {
+        side = std::max(side, cvCeil(_stats.at<int>(i, cv::CC_STAT_WIDTH) * cellWidth));
+        side = std::max(side, cvCeil(_stats.at<int>(i, cv::CC_STAT_HEIGHT) * cellHeight));
+    }
+    side = std::min(side, std::min(depthRoi.cols, depthRoi.rows));
+
+    if ((uint64_t)(count - 1) * side * side > _maxCoverage * roiPixels)
+    {
+        _pixelsProposed += roiPixels;
+        return false;
+    }
+
+    for (int i = 1; i < count; i++)
+    {
+        // center the square crop on the occupied area, shifted back inside the ROI when it sticks out
+        double cx = (_stats.at<int>(i, cv::CC_STAT_LEFT) + _stats.at<int>(i, cv::CC_STAT_WIDTH) * 0.5) * cellWidth;
+        double cy = (_stats.at<int>(i, cv::CC_STAT_TOP) + _stats.at<int>(i, cv::CC_STAT_HEIGHT) * 0.5) * cellHeight;
+        int x = std::min(std::max(0, cvRound(cx - side * 0.5)), depthRoi.cols - side);
+        int y = std::min(std::max(0, cvRound(cy - side * 0.5)), depthRoi.rows - side);
+        regions.push_back(cv::Rect(x, y, side, side));
+        _pixelsProposed += (uint64_t)side * side;
+    }
+    return true;
+}
@@ -0,0 +1,40 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+#include <Poco/Util/AbstractConfiguration.h>
+#include <opencv2/opencv.hpp>
+
+// Proposes the regions worth running the detector on from the aligned depth frame.
+// Depth within the configured distance range is accumulated into a coarse occupancy grid,
+// each connected occupied area becomes one square crop of a common size for batching.
+class DepthRegionProposal
+{
+public:
+    DepthRegionProposal(const Poco::Util::AbstractConfiguration & config);
+    bool enabled() const { return _enabled; }
+    // depthRoi is the raw Z16 depth of the detection ROI, returns false if the whole ROI should be
+    // used instead, otherwise regions holds the crops (may be empty if nothing is in range)
+    bool propose(const cv::Mat & depthRoi, float depthScale, std::vector<cv::Rect> & regions);
+
+    // pixels of the proposed crops versus the pixels of the full ROI since start
+    uint64_t pixelsProposed() const { return _pixelsProposed; }
+    uint64_t pixelsFull() const { return _pixelsFull; }
+
+private:
+    const bool _enabled;
+    const double _nearMeters;
+    const double _farMeters;
+    const int _cellSize;
+    const double _minFill;
+    const int _padCells;
+    const int _maxRegions;
+    const double _maxCoverage;
+    const int _minRegionSize;
+    cv::Mat _mask;
+    cv::Mat _grid;
+    cv::Mat _labels;
+    cv::Mat _stats;
+    cv::Mat _centroids;
+    uint64_t _pixelsProposed;
+    uint64_t _pixelsFull;
+};
@@ -0,0 +1,93 @@
+#include <vector>
+#include <opencv2/core.hpp>
+#include <opencv2/dnn.hpp>
+#include <opencv2/dnn/all_layers.hpp>
+#include "DepthwiseConvLayer.h"
+#include "CustomLayers.h"
+#include "ConvKernels.h"
+
+using std::vector;
+using cv::dnn::LayerParams;
+using cv::dnn::MatShape;
+
+DepthwiseConvLayer::DepthwiseConvLayer(const LayerParams & params)
+    : _stride{ squareConvParam(params, "stride", "stride", 1) }
+    , _pad{ squareConvParam(params, "pad", "pad", 0) }
+    , _relu{ false }
+{
+    setParamsFrom(params);
+
+    const cv::Mat & weights = params.blobs[0];
+    const int channels = weights.size[0];
+    _weights = sharedWeights(params, [&]() { return cv::Mat(channels, 9, CV_32F, (void*)weights.ptr<float>()).clone(); });
+    if (params.get<bool>("bias_term", true) && params.blobs.size() > 1)
+        _bias = cv::Mat(1, channels, CV_32F, (void*)params.blobs[1].ptr<float>()).clone();
+    else
+        _bias = cv::Mat::zeros(1, channels, CV_32F);
+}
+
+bool DepthwiseConvLayer::accepts(const LayerParams & params)
+{
+    if (params.blobs.empty() || params.blobs[0].dims != 4 || params.blobs[0].type() != CV_32F)
+        return false;
+
+    const cv::Mat & weights = params.blobs[0];
+    int group = params.get<int>("group", 1);
+    int stride = squareConvParam(params, "stride", "stride", 1);
+    int pad = squareConvParam(params, "pad", "pad", 0);
+    return group > 1 && group == params.get<int>("num_output", 0) && weights.size[0] == group && weights.size[1] == 1
+        && squareConvParam(params, "kernel", "kernel_size", 0) == 3 && squareConvParam(params, "dilation", "dilation", 1) == 1
+        && (stride == 1 || stride == 2) && (pad == 0 || pad == 1);
+}
+
+cv::Ptr<cv::dnn::Layer> DepthwiseConvLayer::create(LayerParams & params)
+{
+    return cv::Ptr<cv::dnn::Layer>(new DepthwiseConvLayer(params));
+}
+
+bool DepthwiseConvLayer::getMemoryShapes(const vector<MatShape> & inputs, const int requiredOutputs,
+    vector<MatShape> & outputs, vector<MatShape> & internals) const
+{
+    CV_Assert(inputs.size() == 1 && inputs[0].size() == 4 && inputs[0][1] == _weights.rows);
+    const MatShape & input = inputs[0];
+    int outHeight = (input[2] + 2 * _pad - 3) / _stride + 1;
+    int outWidth = (input[3] + 2 * _pad - 3) / _stride + 1;
+    outputs.assign(1, cv::dnn::shape(input[0], input[1], outHeight, outWidth));
+    return false;
+}
+
+bool DepthwiseConvLayer::setActivation(const cv::Ptr<cv::dnn::ActivationLayer> & layer)
+{
+    // only a plain ReLU is fused, anything else stays a layer of its own
+    cv::Ptr<cv::dnn::ReLULayer> relu = layer.dynamicCast<cv::dnn::ReLULayer>();
+    _relu = !relu.empty() && relu->negativeSlope == 0.0f;
+    return _relu;
+}
+
+void DepthwiseConvLayer::forward(cv::InputArrayOfArrays inputs_arr, cv::OutputArrayOfArrays outputs_arr, cv::OutputArrayOfArrays internals_arr)
+{
+    vector<cv::Mat> inputs, outputs;
+    inputs_arr.getMatVector(inputs);
+    outputs_arr.getMatVector(outputs);
+
+    const cv::Mat & src = inputs[0];
+    cv::Mat & dst = outputs[0];
+    const int channels = src.size[1];
+    const int height = src.size[2];
+    const int width = src.size[3];
+    const int outHeight = dst.size[2];
+    const int outWidth = dst.size[3];
+    const bool useAvx2 = cpuHasAvx2();
+
+    // every channel plane of every image in the batch is independent
+    cv::parallel_for_(cv::Range(0, src.size[0] * channels), [&](const cv::Range & range)
+    {
+        for (int plane = range.start; plane < range.end; plane++)
+        {
+            int c = plane % channels;
+            depthwiseConv3x3(src.ptr<float>() + (size_t)plane * height * width, height, width,
+                dst.ptr<float>() + (size_t)plane * outHeight * outWidth, outHeight, outWidth,
+                _weights.ptr<float>(c), _bias.at<float>(c), _stride, _pad, _relu, useAvx2);
+        }
+    });
+}
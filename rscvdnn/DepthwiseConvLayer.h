@@ -0,0 +1,28 @@
+#pragma once
+#include <vector>
+#include <opencv2/dnn.hpp>
+#include <opencv2/dnn/all_layers.hpp>
+
+// 3x3 depthwise (one group per channel) convolution with stride 1 or 2 and an optional fused ReLU,
+// replaces the generic im2col/GEMM path of the stock convolution for these layers
+class DepthwiseConvLayer : public cv::dnn::Layer
+{
+public:
+    DepthwiseConvLayer(const cv::dnn::LayerParams & params);
+    // true if params describe a convolution this layer handles
+    static bool accepts(const cv::dnn::LayerParams & params);
+    static cv::Ptr<cv::dnn::Layer> create(cv::dnn::LayerParams & params);
+
+    bool getMemoryShapes(const std::vector<cv::dnn::MatShape> & inputs, const int requiredOutputs,
+        std::vector<cv::dnn::MatShape> & outputs, std::vector<cv::dnn::MatShape> & internals) const override;
+    bool setActivation(const cv::Ptr<cv::dnn::ActivationLayer> & layer) override;
+    void forward(cv::InputArrayOfArrays inputs, cv::OutputArrayOfArrays outputs, cv::OutputArrayOfArrays internals) override;
+
+private:
+    const int _stride;
+    const int _pad;
+    bool _relu;
+    // one row of 9 taps per channel
+    cv::Mat _weights;
+    cv::Mat _bias;
+};
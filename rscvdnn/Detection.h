@@ -0,0 +1,13 @@
+#pragma once
+#include <vector>
+#include <opencv2/core.hpp>
+
+// one detected object, the box is in pixel coordinates of the image given to the detector
+struct Detection
+{
+    int classId;
+    float confidence;
+    cv::Rect box;
+};
+
+using Detections = std::vector<Detection>;
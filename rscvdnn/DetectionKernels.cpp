@@ -0,0 +1,161 @@
+#include <vector>
+#include <cmath>
+#include <algorithm>
+#include <immintrin.h>
+#include "ConvKernels.h"
+#include "DetectionKernels.h"
+
+using std::vector;
+using Candidate = DetectionOutputScratch::Candidate;
+using Box = DetectionOutputScratch::Box;
+using Kept = DetectionOutputScratch::Kept;
+
+static inline void addCandidate(const float *conf, int index, int numClasses, int backgroundLabelId, vector<vector<Candidate>> & candidates)
+{
+    int prior = index / numClasses;
+    int classId = index - prior * numClasses;
+    if (classId != backgroundLabelId)
+        candidates[classId].push_back({ conf[index], prior });
+}
+
+// scan the flat score array 8 at a time, only the set bits of the comparison mask are looked at,
+// returns the first score left for the scalar path
+TARGET_AVX2 static int collectCandidatesAvx2(const float *conf, int count, int numClasses, int backgroundLabelId, float threshold,
+    vector<vector<Candidate>> & candidates)
+{
+    int i = 0;
+    const __m256 vthreshold = _mm256_set1_ps(threshold);
+    for (; i + 8 <= count; i += 8)
+    {
+        int mask = _mm256_movemask_ps(_mm256_cmp_ps(_mm256_loadu_ps(conf + i), vthreshold, _CMP_GT_OQ));
+        for (int bit = 0; mask != 0; bit++, mask >>= 1)
+        {
+            if (mask & 1)
+                addCandidate(conf, i + bit, numClasses, backgroundLabelId, candidates);
+        }
+    }
+    return i;
+}
+
+// candidates of each class end up in ascending prior order
+static void collectCandidates(const float *conf, int count, int numClasses, int backgroundLabelId, float threshold,
+    vector<vector<Candidate>> & candidates, bool useAvx2)
+{
+    int i = useAvx2 ? collectCandidatesAvx2(conf, count, numClasses, backgroundLabelId, threshold, candidates) : 0;
+    for (; i < count; i++)
+    {
+        if (conf[i] > threshold)
+            addCandidate(conf, i, numClasses, backgroundLabelId, candidates);
+    }
+}
+
+static Box decodeBox(const float *loc, const float *priors, int numPriors, int prior, bool clip)
+{
+    const float *p = priors + prior * 4;
+    const float *v = priors + (numPriors + prior) * 4;
+    const float *l = loc + prior * 4;
+
+    float priorWidth = p[2] - p[0];
+    float priorHeight = p[3] - p[1];
+    float centerX = v[0] * l[0] * priorWidth + (p[0] + p[2]) * 0.5f;
+    float centerY = v[1] * l[1] * priorHeight + (p[1] + p[3]) * 0.5f;
+    float width = std::exp(v[2] * l[2]) * priorWidth;
+    float height = std::exp(v[3] * l[3]) * priorHeight;
+
+    Box box{ centerX - width * 0.5f, centerY - height * 0.5f, centerX + width * 0.5f, centerY + height * 0.5f };
+    if (clip)
+    {
+        box.xmin = std::min(std::max(box.xmin, 0.0f), 1.0f);
+        box.ymin = std::min(std::max(box.ymin, 0.0f), 1.0f);
+        box.xmax = std::min(std::max(box.xmax, 0.0f), 1.0f);
+        box.ymax = std::min(std::max(box.ymax, 0.0f), 1.0f);
+    }
+    return box;
+}
+
+static inline float boxArea(const Box & box)
+{
+    return (box.xmax < box.xmin || box.ymax < box.ymin) ? 0.0f : (box.xmax - box.xmin) * (box.ymax - box.ymin);
+}
+
+static float jaccardOverlap(const Box & a, const Box & b)
+{
+    if (b.xmin > a.xmax || b.xmax < a.xmin || b.ymin > a.ymax || b.ymax < a.ymin)
+        return 0.0f;
+
+    Box intersection{ std::max(a.xmin, b.xmin), std::max(a.ymin, b.ymin), std::min(a.xmax, b.xmax), std::min(a.ymax, b.ymax) };
+    float intersectionArea = boxArea(intersection);
+    // degenerate boxes touching each other have no area at all, which would divide zero by zero
+    float unionArea = boxArea(a) + boxArea(b) - intersectionArea;
+    if (unionArea <= 0.0f)
+        return 0.0f;
+    return intersectionArea / unionArea;
+}
+
+int detectionOutput(const float *loc, const float *conf, const float *priors, int numPriors, const DetectionOutputParams & params,
+    DetectionOutputScratch & scratch, int imageId, float *dst, int maxRows, bool useAvx2)
+{
+    scratch.candidates.resize(params.numClasses);
+    for (vector<Candidate> & candidates : scratch.candidates)
+        candidates.clear();
+    scratch.boxes.resize(numPriors);
+    scratch.decoded.assign(numPriors, 0);
+    scratch.kept.clear();
+
+    collectCandidates(conf, numPriors * params.numClasses, params.numClasses, params.backgroundLabelId,
+        params.confidenceThreshold, scratch.candidates, useAvx2);
+
+    auto byScore = [](const Candidate & a, const Candidate & b) { return a.score > b.score; };
+    for (int classId = 0; classId < params.numClasses; classId++)
+    {
+        vector<Candidate> & candidates = scratch.candidates[classId];
+        if (candidates.empty())
+            continue;
+
+        // greedy NMS over the top-k of the class, stable so equal scores keep the prior order
+        std::stable_sort(candidates.begin(), candidates.end(), byScore);
+        if (params.topK > -1 && (int)candidates.size() > params.topK)
+            candidates.resize(params.topK);
+
+        size_t firstKept = scratch.kept.size();
+        for (const Candidate & candidate : candidates)
+        {
+            if (!scratch.decoded[candidate.prior])
+            {
+                scratch.boxes[candidate.prior] = decodeBox(loc, priors, numPriors, candidate.prior, params.clip);
+                scratch.decoded[candidate.prior] = 1;
+            }
+
+            const Box & box = scratch.boxes[candidate.prior];
+            bool keep = true;
+            for (size_t k = firstKept; k < scratch.kept.size() && keep; k++)
+                keep = jaccardOverlap(box, scratch.boxes[scratch.kept[k].prior]) <= params.nmsThreshold;
+            if (keep)
+                scratch.kept.push_back({ candidate.score, classId, candidate.prior });
+        }
+    }
+
+    // over the limit the best scores of all classes are kept, still grouped by class
+    if (params.keepTopK > -1 && (int)scratch.kept.size() > params.keepTopK)
+    {
+        std::stable_sort(scratch.kept.begin(), scratch.kept.end(), [](const Kept & a, const Kept & b) { return a.score > b.score; });
+        scratch.kept.resize(params.keepTopK);
+        std::stable_sort(scratch.kept.begin(), scratch.kept.end(), [](const Kept & a, const Kept & b) { return a.classId < b.classId; });
+    }
+
+    int rows = std::min((int)scratch.kept.size(), maxRows);
+    for (int i = 0; i < rows; i++)
+    {
+        const Kept & kept = scratch.kept[i];
+        const Box & box = scratch.boxes[kept.prior];
+        float *row = dst + i * 7;
+        row[0] = (float)imageId;
+        row[1] = (float)kept.classId;
+        row[2] = kept.score;
+        row[3] = box.xmin;
+        row[4] = box.ymin;
+        row[5] = box.xmax;
+        row[6] = box.ymax;
+    }
+    return rows;
+}
@@ -0,0 +1,50 @@
+#pragma once
+#include <vector>
+
+// SSD post-processing on raw float arrays behind the custom DetectionOutput layer
+
+struct DetectionOutputParams
+{
+    int numClasses;
+    int backgroundLabelId;
+    float confidenceThreshold;
+    float nmsThreshold;
+    // candidates per class before NMS and detections per image after it, -1 for no limit
+    int topK;
+    int keepTopK;
+    bool clip;
+};
+
+// buffers reused from frame to frame
+struct DetectionOutputScratch
+{
+    struct Candidate
+    {
+        float score;
+        int prior;
+    };
+    struct Box
+    {
+        float xmin;
+        float ymin;
+        float xmax;
+        float ymax;
+    };
+    struct Kept
+    {
+        float score;
+        int classId;
+        int prior;
+    };
+    std::vector<std::vector<Candidate>> candidates;
+    std::vector<Box> boxes;
+    std::vector<unsigned char> decoded;
+    std::vector<Kept> kept;
+};
+
+// Decode and suppress the detections of one image. loc holds 4 CENTER_SIZE offsets per prior, conf the
+// [priors x classes] scores, priors the corner boxes followed by their variances. Only priors with a score
+// above the threshold are decoded. Rows of [imageId, label, confidence, xmin, ymin, xmax, ymax] are written
+// to dst, up to maxRows, the number of rows written is returned.
+int detectionOutput(const float *loc, const float *conf, const float *priors, int numPriors, const DetectionOutputParams & params,
+    DetectionOutputScratch & scratch, int imageId, float *dst, int maxRows, bool useAvx2);
@@ -0,0 +1,296 @@
+#include <string>
+#include <vector>
+#include <chrono>
+#include <sstream>
+#include <algorithm>
+#include <Poco/BinaryReader.h>
+#include <Poco/BinaryWriter.h>
+#include <Poco/Exception.h>
+#include <Poco/MemoryStream.h>
+#include <Poco/Net/NetException.h>
+#include <Poco/Net/ServerSocket.h>
+#include <Poco/Net/SocketAddress.h>
+#include <Poco/Net/TCPServerConnection.h>
+#include <Poco/Net/TCPServerConnectionFactory.h>
+#include <Poco/Net/TCPServerParams.h>
+#include "DetectionPublisher.h"
+
+using std::string;
+using std::vector;
+using std::shared_ptr;
+using Poco::BinaryReader;
+using Poco::BinaryWriter;
+using Poco::Logger;
+using Poco::Net::ServerSocket;
+using Poco::Net::SocketAddress;
+using Poco::Net::StreamSocket;
+using Poco::Net::TCPServer;
+using Poco::Net::TCPServerConnection;
+using Poco::Net::TCPServerConnectionFactory;
+using Poco::Net::TCPServerParams;
+using Poco::Util::AbstractConfiguration;
+
+string DetectionMessage::encode() const
+{
+    size_t count = std::min<size_t>(objects.size(), 0xffff);
+    std::ostringstream buffer;
+    BinaryWriter writer(buffer, BinaryWriter::LITTLE_ENDIAN_BYTE_ORDER);
+    writer << (Poco::UInt32)(HeaderSize - 4 + count * ObjectSize + DepthHeaderSize + depth.size()) << (Poco::UInt16)Version << (Poco::UInt16)camera << (Poco::UInt16)count
+        << (Poco::UInt64)frameNumber << sensorTimestamp << (Poco::Int64)sentUs;
+    for (size_t i = 0; i < count; i++)
+    {
+        const PublishedObject & object = objects[i];
+        writer << (Poco::UInt16)object.classId << object.confidence
+            << (Poco::Int16)object.box.x << (Poco::Int16)object.box.y << (Poco::Int16)object.box.width << (Poco::Int16)object.box.height
+            << object.distance;
+    }
+    bool hasDepth = !depth.empty();
+    writer << (Poco::UInt16)(hasDepth ? depthSize.width : 0) << (Poco::UInt16)(hasDepth ? depthSize.height : 0);
+    writer.writeRaw((const char *)depth.data(), depth.size());
+    writer.flush();
+    return buffer.str();
+}
+
+bool DetectionMessage::decode(const char *data, size_t size)
+{
+    if (size < HeaderSize - 4)
+        return false;
+
+    Poco::MemoryInputStream buffer(data, size);
+    BinaryReader reader(buffer, BinaryReader::LITTLE_ENDIAN_BYTE_ORDER);
+    Poco::UInt16 version, cameraIndex, count;
+    Poco::UInt64 number;
+    Poco::Int64 sent;
+    reader >> version >> cameraIndex >> count >> number >> sensorTimestamp >> sent;
+    // version 2, as in the recordings made before depth was sent, ends after the objects
+    size_t objectsEnd = HeaderSize - 4 + count * ObjectSize;
+    if (version == 2 ? size != objectsEnd : (version != Version || size < objectsEnd + DepthHeaderSize))
+        return false;
+
+    camera = cameraIndex;
+    frameNumber = number;
+    sentUs = sent;
+    objects.resize(count);
+    for (PublishedObject & object : objects)
+    {
+        Poco::UInt16 classId;
+        Poco::Int16 x, y, width, height;
+        reader >> classId >> object.confidence >> x >> y >> width >> height >> object.distance;
+        object.classId = classId;
+        object.box = cv::Rect(x, y, width, height);
+    }
+    depthSize = cv::Size();
+    depth.clear();
+    if (version == 2)
+        return reader.good();
+    Poco::UInt16 depthWidth, depthHeight;
+    reader >> depthWidth >> depthHeight;
+    depthSize = cv::Size(depthWidth, depthHeight);
+    depth.assign((const uint8_t *)data + objectsEnd + DepthHeaderSize, (const uint8_t *)data + size);
+    if (depthSize.area() == 0 && !depth.empty())
+        return false;
+    return reader.good();
+}
+
+int64_t publisherClockUs()
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+// sends the queued messages of one client until it disconnects or is dropped
+class PublisherConnection : public TCPServerConnection
+{
+public:
+    PublisherConnection(const StreamSocket & socket, DetectionPublisher & publisher)
+        : TCPServerConnection(socket)
+        , _publisher(publisher)
+    {
+    }
+
+    void run() override
+    {
+        shared_ptr<DetectionPublisher::Client> client;
+        shared_ptr<const string> message;
+        try
+        {
+            socket().setNoDelay(true);
+            client = _publisher.addClient(socket());
+            while (client->queue.pop(message) && !client->disconnected)
+            {
+                const char *data = message->data();
+                int remaining = (int)message->size();
+                while (remaining > 0)
+                {
+                    int sent = socket().sendBytes(data, remaining);
+                    if (sent <= 0)
+                        throw Poco::Net::ConnectionResetException();
+                    data += sent;
+                    remaining -= sent;
+                }
+            }
+        }
+        catch (Poco::Exception &)
+        {
+            // the client went away, or was shut down as too slow
+        }
+        if (client)
+            _publisher.removeClient(client);
+    }
+
+private:
+    DetectionPublisher & _publisher;
+};
+
+class PublisherConnectionFactory : public TCPServerConnectionFactory
+{
+public:
+    PublisherConnectionFactory(DetectionPublisher & publisher) : _publisher(publisher) {}
+
+    TCPServerConnection * createConnection(const StreamSocket & socket) override
+    {
+        return new PublisherConnection(socket, _publisher);
+    }
+
+private:
+    DetectionPublisher & _publisher;
+};
+
+DetectionPublisher::Client::Client(const StreamSocket & socket, const AbstractConfiguration & config)
+    : socket(socket)
+    , queue(socket.peerAddress().toString(), config)
+    , droppedInRow{ 0 }
+    , disconnected{ false }
+{
+}
+
+DetectionPublisher::DetectionPublisher(const AbstractConfiguration & config)
+    : _logger{ Logger::get("DetectionPublisher") }
+    , _address{ config.getString("address", "127.0.0.1") }
+    , _port{ (unsigned short)config.getUInt("port", 9465) }
+    , _maxClients{ std::max(1, config.getInt("maxClients", 16)) }
+    , _maxDropped{ std::max(1, config.getInt("maxDropped", 30)) }
+    , _sendDepth{ config.getBool("depth", false) }
+    , _queueConfig{ config.createView("queue") }
+    , _stopping{ false }
+    , _clientsGauge(metrics().gauge("rscvdnn_publisher_clients", "Clients connected to the detection publisher"))
+    , _messagesPublished(metrics().counter("rscvdnn_publisher_messages_total", "Detection messages published"))
+    , _messagesDropped(metrics().counter("rscvdnn_publisher_messages_dropped_total", "Detection messages dropped from full client queues"))
+    , _clientsDropped(metrics().counter("rscvdnn_publisher_clients_dropped_total", "Clients disconnected for being too slow"))
+{
+    if (parseQueuePolicy(_queueConfig->getString("policy", "dropOldest")) == QueuePolicy::Block)
+        throw std::invalid_argument("publisher client queues must drop messages, a blocking queue would stall the pipeline");
+}
+
+DetectionPublisher::~DetectionPublisher()
+{
+    stop();
+}
+
+void DetectionPublisher::start()
+{
+    if (_server)
+        return;
+
+    // one thread per client, connections beyond maxClients wait for a free thread
+    _threadPool.reset(new Poco::ThreadPool(2, _maxClients));
+    TCPServerParams *params = new TCPServerParams;
+    params->setMaxThreads(_maxClients);
+    params->setMaxQueued(_maxClients);
+    _server.reset(new TCPServer(new PublisherConnectionFactory(*this), *_threadPool, ServerSocket(SocketAddress(_address, _port)), params));
+    {
+        std::lock_guard<std::mutex> lock(_clientsMutex);
+        _stopping = false;
+    }
+    _server->start();
+    poco_information(_logger, "publishing detections on " + _address + ":" + std::to_string(port()));
+}
+
+void DetectionPublisher::stop()
+{
+    if (!_server)
+        return;
+
+    _server->stop();
+    {
+        std::lock_guard<std::mutex> lock(_clientsMutex);
+        _stopping = true;
+        for (shared_ptr<Client> & client : _clients)
+            disconnect(*client);
+    }
+    // the connection threads return as soon as their socket is shut down
+    _threadPool->joinAll();
+    _server.reset();
+    _threadPool.reset();
+}
+
+unsigned short DetectionPublisher::port() const
+{
+    return _server ? _server->port() : 0;
+}
+
+size_t DetectionPublisher::clientCount()
+{
+    std::lock_guard<std::mutex> lock(_clientsMutex);
+    return _clients.size();
+}
+
+void DetectionPublisher::publish(DetectionMessage & message)
+{
+    message.sentUs = publisherClockUs();
+    shared_ptr<const string> encoded = std::make_shared<const string>(message.encode());
+    _messagesPublished.add();
+
+    std::lock_guard<std::mutex> lock(_clientsMutex);
+    for (shared_ptr<Client> & client : _clients)
+    {
+        if (client->disconnected)
+            continue;
+        if (client->queue.push(encoded))
+        {
+            client->droppedInRow = 0;
+            continue;
+        }
+        _messagesDropped.add();
+        if (++client->droppedInRow >= _maxDropped)
+        {
+            poco_warning(_logger, "disconnecting slow client " + client->queue.name());
+            _clientsDropped.add();
+            disconnect(*client);
+        }
+    }
+}
+
+shared_ptr<DetectionPublisher::Client> DetectionPublisher::addClient(const StreamSocket & socket)
+{
+    shared_ptr<Client> client = std::make_shared<Client>(socket, *_queueConfig);
+    std::lock_guard<std::mutex> lock(_clientsMutex);
+    // a connection accepted just before stop is turned away, stop already disconnected the others
+    if (_stopping)
+        disconnect(*client);
+    _clients.push_back(client);
+    _clientsGauge.set((double)_clients.size());
+    poco_information(_logger, "client " + client->queue.name() + " connected");
+    return client;
+}
+
+void DetectionPublisher::removeClient(const shared_ptr<Client> & client)
+{
+    std::lock_guard<std::mutex> lock(_clientsMutex);
+    _clients.erase(std::remove(_clients.begin(), _clients.end(), client), _clients.end());
+    _clientsGauge.set((double)_clients.size());
+    poco_information(_logger, "client " + client->queue.name() + " disconnected");
+}
+
+void DetectionPublisher::disconnect(Client & client)
+{
+    // wakes the sender whether it waits for a message or blocks in a send to a stalled client
+    client.disconnected = true;
+    client.queue.close();
+    try
+    {
+        client.socket.shutdown();
+    }
+    catch (Poco::Exception &)
+    {
+    }
+}
@@ -0,0 +1,114 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <Poco/AutoPtr.h>
+#include <Poco/Logger.h>
+#include <Poco/ThreadPool.h>
+#include <Poco/Net/StreamSocket.h>
+#include <Poco/Net/TCPServer.h>
+#include <Poco/Util/AbstractConfiguration.h>
+#include <opencv2/core.hpp>
+#include "StageQueue.h"
+#include "Metrics.h"
+
+// one object of a published frame, the box is in pixels of the color frame, distance in meters, 0 if out of range
+struct PublishedObject
+{
+    int classId;
+    float confidence;
+    cv::Rect box;
+    float distance;
+};
+
+// The detections of one frame as sent to the clients. On the wire every message is little endian,
+//   uint32 length of the rest of the message
+//   uint16 version (3), uint16 camera index, uint16 object count, uint64 frame number, float64 sensor timestamp
+//   in ms, int64 send time in microseconds since the Unix epoch
+// followed by object count times
+//   uint16 class id, float32 confidence, int16 x, y, width, height, float32 distance
+// and the depth frame, if there is one
+//   uint16 depth width, uint16 depth height, 0 if there is no depth, the rest of the message is the RVL coded
+//   Z16 depth frame, see DepthCodec.h
+struct DetectionMessage
+{
+    static const uint16_t Version = 3;
+    static const size_t HeaderSize = 4 + 30;
+    static const size_t ObjectSize = 18;
+    static const size_t DepthHeaderSize = 4;
+
+    int camera;
+    uint64_t frameNumber;
+    double sensorTimestamp;
+    int64_t sentUs;
+    std::vector<PublishedObject> objects;
+    // size and RVL code of the depth frame, empty if not sent
+    cv::Size depthSize;
+    std::vector<uint8_t> depth;
+
+    std::string encode() const;
+    // parse one message without its length prefix, of this version or of version 2 without the depth frame,
+    // false if it is malformed
+    bool decode(const char *data, size_t size);
+};
+
+// microseconds since the Unix epoch, the clock of the send time
+int64_t publisherClockUs();
+
+// Streams the detections of every frame to any number of TCP clients. Publishing encodes the message once and
+// only appends it to the bounded queue of each client, every client is served by its own thread, so a stalled
+// client never holds up the pipeline. A full queue drops the oldest message, a client that keeps its queue full
+// for maxDropped messages in a row is disconnected. With depth set, the depth frame is sent along with the detections.
+class DetectionPublisher
+{
+public:
+    // config is the publisher section: address, port (0 for any free port), maxClients, maxDropped, depth and
+    // queue.capacity and queue.policy of the client queues, which must not block
+    DetectionPublisher(const Poco::Util::AbstractConfiguration & config);
+    ~DetectionPublisher();
+    void start();
+    void stop();
+    bool isRunning() const { return (bool)_server; }
+    // the depth frame is to be added to the messages
+    bool sendsDepth() const { return _sendDepth; }
+    // the port actually bound, only valid while running
+    unsigned short port() const;
+    size_t clientCount();
+    // queue the message for every connected client, the send time is set here
+    void publish(DetectionMessage & message);
+
+private:
+    struct Client
+    {
+        Client(const Poco::Net::StreamSocket & socket, const Poco::Util::AbstractConfiguration & config);
+        Poco::Net::StreamSocket socket;
+        StageQueue<std::shared_ptr<const std::string>> queue;
+        int droppedInRow;
+        std::atomic<bool> disconnected;
+    };
+
+    friend class PublisherConnection;
+    std::shared_ptr<Client> addClient(const Poco::Net::StreamSocket & socket);
+    void removeClient(const std::shared_ptr<Client> & client);
+    void disconnect(Client & client);
+
+    Poco::Logger & _logger;
+    std::string _address;
+    unsigned short _port;
+    int _maxClients;
+    int _maxDropped;
+    const bool _sendDepth;
+    Poco::AutoPtr<Poco::Util::AbstractConfiguration> _queueConfig;
+    std::unique_ptr<Poco::ThreadPool> _threadPool;
+    std::unique_ptr<Poco::Net::TCPServer> _server;
+    std::mutex _clientsMutex;
+    bool _stopping;
+    std::vector<std::shared_ptr<Client>> _clients;
+    MetricGauge & _clientsGauge;
+    MetricCounter & _messagesPublished;
+    MetricCounter & _messagesDropped;
+    MetricCounter & _clientsDropped;
+};
@@ -0,0 +1,313 @@
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <Poco/BinaryReader.h>
+#include <Poco/BinaryWriter.h>
+#include <Poco/DateTime.h>
+#include <Poco/DateTimeFormatter.h>
+#include <Poco/LocalDateTime.h>
+#include <Poco/Logger.h>
+#include <Poco/Timestamp.h>
+#include <Poco/Util/AbstractConfiguration.h>
+#include "EventLog.h"
+#include "Metrics.h"
+#include "StageTrace.h"
+
+using std::string;
+using std::vector;
+using Poco::BinaryReader;
+using Poco::BinaryWriter;
+using Poco::Logger;
+using Poco::Util::AbstractConfiguration;
+
+static const char FileMagic[8] = { 'R', 'S', 'C', 'V', 'E', 'V', 'T', 0 };
+static const uint16_t FileVersion = 1;
+// events a thread can log between two drains
+static const uint64_t RingCapacity = 4096;
+
+static const char *StageNames[] = { "capture", "align", "preprocess", "inference", "postprocess" };
+static const char *QueueNames[] = { "align", "preprocess", "inference", "postprocess", "display" };
+
+// single producer single consumer ring of one thread, the producer only moves written and the writer thread only read
+struct EventRing
+{
+    EventRecord records[RingCapacity];
+    std::atomic<uint64_t> written{ 0 };
+    std::atomic<uint64_t> read{ 0 };
+    // the owning thread exited, a new thread may take the ring over
+    std::atomic<bool> released{ false };
+    uint16_t id;
+};
+
+static std::atomic<bool> enabled{ false };
+static std::mutex registryMutex;
+static vector<std::unique_ptr<EventRing>> registry;
+
+static EventRing * acquireRing()
+{
+    std::lock_guard<std::mutex> lock(registryMutex);
+    for (std::unique_ptr<EventRing> & ring : registry)
+    {
+        bool released = true;
+        if (ring->released.compare_exchange_strong(released, false))
+            return ring.get();
+    }
+    registry.emplace_back(new EventRing);
+    registry.back()->id = (uint16_t)registry.size();
+    return registry.back().get();
+}
+
+// ring of the calling thread, handed back to the registry when the thread exits
+struct LocalRing
+{
+    EventRing *ring{ nullptr };
+    EventRing & get()
+    {
+        if (ring == nullptr)
+            ring = acquireRing();
+        return *ring;
+    }
+    ~LocalRing()
+    {
+        if (ring != nullptr)
+            ring->released = true;
+    }
+};
+
+static thread_local LocalRing local;
+
+static MetricCounter & droppedEvents()
+{
+    static MetricCounter & dropped = metrics().counter("rscvdnn_event_log_dropped_total", "Events dropped by a full event ring");
+    return dropped;
+}
+
+bool eventLogEnabled()
+{
+    return enabled.load(std::memory_order_relaxed);
+}
+
+void logEvent(EventId id, uint32_t camera, uint64_t frame, EventArg a, EventArg b, EventArg c)
+{
+    if (!eventLogEnabled())
+        return;
+
+    EventRing & ring = local.get();
+    uint64_t index = ring.written.load(std::memory_order_relaxed);
+    if (index - ring.read.load(std::memory_order_acquire) >= RingCapacity)
+    {
+        droppedEvents().add();
+        return;
+    }
+    ring.records[index % RingCapacity] = EventRecord{ traceNow(), frame, (uint16_t)id, ring.id, camera, { a.bits, b.bits, c.bits } };
+    ring.written.store(index + 1, std::memory_order_release);
+}
+
+static double argDouble(uint64_t bits)
+{
+    double value;
+    std::memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+static const char * argName(const char * const * names, size_t count, uint64_t index)
+{
+    return index < count ? names[index] : "unknown";
+}
+
+string formatEvent(const EventRecord & record, const string & time)
+{
+    std::ostringstream text;
+    text << time << " t" << record.thread << " camera " << record.camera << " frame " << record.frame << ": " << std::fixed;
+    switch ((EventId)record.event)
+    {
+    case EventId::FrameCaptured:
+        text << "captured, sensor time " << std::setprecision(3) << argDouble(record.args[0]) << " ms";
+        break;
+    case EventId::StageDone:
+        text << argName(StageNames, sizeof(StageNames) / sizeof(StageNames[0]), record.args[0]) << " took "
+            << std::setprecision(3) << record.args[1] / 1e6 << " ms";
+        break;
+    case EventId::QueueDropped:
+        text << "the " << argName(QueueNames, sizeof(QueueNames) / sizeof(QueueNames[0]), record.args[0])
+            << " queue was full, " << record.args[1] << " frames dropped so far";
+        break;
+    case EventId::InferenceSkipped:
+        text << "inference skipped, " << record.args[0] << " frames in a row";
+        break;
+    case EventId::ObjectDetected:
+        text << "class " << record.args[0] << " confidence " << std::setprecision(2) << argDouble(record.args[1]);
+        if (argDouble(record.args[2]) > 0.0)
+            text << ", " << argDouble(record.args[2]) << " meters away";
+        else
+            text << ", over range";
+        break;
+    default:
+        text << "event " << record.event << " " << record.args[0] << " " << record.args[1] << " " << record.args[2];
+    }
+    return text.str();
+}
+
+// local time of a steady clock time, given the Unix time in ns of steady clock 0
+static string formatTime(int64_t time, int64_t epochOffset)
+{
+    Poco::Timestamp timestamp((time + epochOffset) / 1000);
+    return Poco::DateTimeFormatter::format(Poco::LocalDateTime(Poco::DateTime(timestamp)), "%Y-%m-%d %H:%M:%S.%F");
+}
+
+void decodeEventLog(const string & path, std::ostream & out)
+{
+    std::ifstream file(path, std::ios::binary);
+    BinaryReader reader(file, BinaryReader::LITTLE_ENDIAN_BYTE_ORDER);
+    char magic[sizeof(FileMagic)] = {};
+    file.read(magic, sizeof(magic));
+    Poco::UInt16 version = 0, recordSize = 0;
+    Poco::UInt32 reserved = 0;
+    Poco::Int64 steady = 0, epoch = 0;
+    reader >> version >> recordSize >> reserved >> steady >> epoch;
+    if (!file || std::memcmp(magic, FileMagic, sizeof(magic)) != 0 || recordSize < EventRecord::Size)
+        throw std::runtime_error(path + " is not an event log");
+
+    while (true)
+    {
+        EventRecord record;
+        Poco::Int64 time = 0;
+        Poco::UInt64 frame = 0;
+        Poco::UInt32 camera = 0;
+        reader >> time >> frame >> record.event >> record.thread >> camera;
+        for (uint64_t & arg : record.args)
+        {
+            Poco::UInt64 value = 0;
+            reader >> value;
+            arg = value;
+        }
+        // records of later versions may carry more
+        file.ignore(recordSize - EventRecord::Size);
+        if (!file)
+            break;
+        record.time = time;
+        record.frame = frame;
+        record.camera = camera;
+        out << formatEvent(record, formatTime(record.time, epoch - steady)) << "\n";
+    }
+}
+
+EventLogWriter::EventLogWriter(const AbstractConfiguration & config)
+    : _logger{ Logger::get("EventLogWriter") }
+    , _eventLogger{ Logger::get("EventLog") }
+    , _path{ config.getString("path", "") }
+    , _flushMs{ std::max(1, config.getInt("flushMs", 100)) }
+    , _running{ false }
+    , _epochOffset{ 0 }
+{
+}
+
+EventLogWriter::~EventLogWriter()
+{
+    stop();
+}
+
+void EventLogWriter::start()
+{
+    if (_running)
+        return;
+
+    int64_t steady = traceNow();
+    int64_t epoch = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+    _epochOffset = epoch - steady;
+    if (!_path.empty())
+    {
+        _file.open(_path, std::ios::binary | std::ios::trunc);
+        if (!_file)
+            throw std::runtime_error("cannot write event log " + _path);
+        BinaryWriter writer(_file, BinaryWriter::LITTLE_ENDIAN_BYTE_ORDER);
+        writer.writeRaw(FileMagic, sizeof(FileMagic));
+        writer << (Poco::UInt16)FileVersion << (Poco::UInt16)EventRecord::Size << (Poco::UInt32)0
+            << (Poco::Int64)steady << (Poco::Int64)epoch;
+    }
+
+    // events logged before the start are not of this log
+    {
+        std::lock_guard<std::mutex> lock(registryMutex);
+        for (std::unique_ptr<EventRing> & ring : registry)
+            ring->read.store(ring->written.load(std::memory_order_acquire), std::memory_order_release);
+    }
+    _running = true;
+    enabled = true;
+    _thread = std::thread(&EventLogWriter::run, this);
+    poco_information(_logger, "event log started" + (_path.empty() ? string() : ", writing to " + _path));
+}
+
+void EventLogWriter::stop()
+{
+    if (!_running)
+        return;
+
+    enabled = false;
+    _running = false;
+    _wake.set();
+    _thread.join();
+    // the events logged up to the stop
+    drain();
+    if (_file.is_open())
+    {
+        _file.close();
+        if (!_file)
+            poco_error(_logger, "event log " + _path + " not completely written");
+    }
+    poco_information(_logger, "event log stopped, " + std::to_string(droppedEvents().value()) + " events dropped");
+}
+
+void EventLogWriter::run()
+{
+    setTraceThreadName("event log");
+    while (_running)
+    {
+        _wake.tryWait(_flushMs);
+        drain();
+    }
+}
+
+void EventLogWriter::drain()
+{
+    _batch.clear();
+    {
+        std::lock_guard<std::mutex> lock(registryMutex);
+        for (std::unique_ptr<EventRing> & ring : registry)
+        {
+            uint64_t end = ring->written.load(std::memory_order_acquire);
+            for (uint64_t i = ring->read.load(std::memory_order_relaxed); i < end; i++)
+                _batch.push_back(ring->records[i % RingCapacity]);
+            ring->read.store(end, std::memory_order_release);
+        }
+    }
+    if (_batch.empty())
+        return;
+
+    // the events of all threads in the order they happened
+    std::stable_sort(_batch.begin(), _batch.end(), [](const EventRecord & a, const EventRecord & b) { return a.time < b.time; });
+    if (_eventLogger.debug())
+    {
+        for (const EventRecord & record : _batch)
+            _eventLogger.debug(formatEvent(record, formatTime(record.time, _epochOffset)));
+    }
+    if (_file.is_open())
+    {
+        BinaryWriter writer(_file, BinaryWriter::LITTLE_ENDIAN_BYTE_ORDER);
+        for (const EventRecord & record : _batch)
+        {
+            writer << (Poco::Int64)record.time << (Poco::UInt64)record.frame << record.event << record.thread << (Poco::UInt32)record.camera;
+            for (uint64_t arg : record.args)
+                writer << (Poco::UInt64)arg;
+        }
+        writer.flush();
+    }
+}
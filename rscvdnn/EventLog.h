@@ -0,0 +1,105 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <ostream>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <vector>
+#include <Poco/Event.h>
+#include <Poco/Logger.h>
+#include <Poco/Util/AbstractConfiguration.h>
+
+// Binary log of per-frame events, stage timings, queue drops, skipped inferences and detections, cheap enough for
+// the hot path. Every thread appends fixed size records to a ring of its own without locks or formatting, an
+// EventLogWriter thread drains the rings, formats the events into the Poco logger EventLog at debug priority, so
+// they reach the channels of [logging], and appends them raw to a file for later decoding if configured.
+// A full ring drops the new events, counted in rscvdnn_event_log_dropped_total.
+//
+// A log file is little endian, header: char[8] "RSCVEVT", uint16 version (1), uint16 record size, uint32 reserved,
+// int64 steady clock in ns and int64 ns since the Unix epoch at the same moment, followed by the records:
+// int64 steady clock in ns, uint64 frame number, uint16 event, uint16 thread, uint32 camera index, uint64 args[3].
+
+enum class EventId : uint16_t
+{
+    // sensor timestamp of the frame in ms
+    FrameCaptured = 1,
+    // pipeline stage, EventStage, and its duration in ns
+    StageDone,
+    // queue the frame was dropped from, EventQueue, and the frames it dropped so far
+    QueueDropped,
+    // frames skipped in a row by the scene gate
+    InferenceSkipped,
+    // class id, confidence and distance in meters of an object
+    ObjectDetected
+};
+
+enum EventStage : uint16_t { StageCapture, StageAlign, StagePreprocess, StageInference, StagePostprocess };
+enum EventQueue : uint16_t { QueueAlign, QueuePreprocess, QueueInference, QueuePostprocess, QueueDisplay };
+
+// an integer or floating point event argument, which of the two the event tells
+struct EventArg
+{
+    uint64_t bits;
+
+    EventArg() : bits{ 0 } {}
+    template <typename T, typename std::enable_if<std::is_integral<T>::value || std::is_enum<T>::value, int>::type = 0>
+    EventArg(T value) : bits{ (uint64_t)value } {}
+    EventArg(double value) { std::memcpy(&bits, &value, sizeof(bits)); }
+};
+
+struct EventRecord
+{
+    static const size_t Size = 48;
+
+    int64_t time;
+    uint64_t frame;
+    uint16_t event;
+    uint16_t thread;
+    uint32_t camera;
+    uint64_t args[3];
+};
+
+bool eventLogEnabled();
+// append an event of the calling thread, does nothing unless a writer is running
+void logEvent(EventId id, uint32_t camera, uint64_t frame, EventArg a = EventArg(), EventArg b = EventArg(), EventArg c = EventArg());
+// the text of an event, time as given
+std::string formatEvent(const EventRecord & record, const std::string & time);
+// print the events of a log file as text, throws if the file is not an event log
+void decodeEventLog(const std::string & path, std::ostream & out);
+
+// Drains the event rings of all threads, configured by the eventLog section: enabled, path of the binary log,
+// empty for none, and flushMs, the interval between drains.
+class EventLogWriter
+{
+public:
+    EventLogWriter(const Poco::Util::AbstractConfiguration & config);
+    ~EventLogWriter();
+    EventLogWriter(const EventLogWriter &) = delete;
+    EventLogWriter & operator=(const EventLogWriter &) = delete;
+
+    // start logging events, one writer at a time
+    void start();
+    // drain what is left and stop logging events
+    void stop();
+    bool isRunning() const { return _running; }
+
+private:
+    void run();
+    // format and write the events recorded so far, oldest first
+    void drain();
+
+    Poco::Logger & _logger;
+    Poco::Logger & _eventLogger;
+    const std::string _path;
+    const long _flushMs;
+    std::ofstream _file;
+    std::thread _thread;
+    std::atomic<bool> _running;
+    Poco::Event _wake;
+    // Unix time in ns of steady clock 0
+    int64_t _epochOffset;
+    std::vector<EventRecord> _batch;
+};
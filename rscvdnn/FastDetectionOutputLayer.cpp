@@ -0,0 +1,79 @@
+#include <vector>
+#include <cfloat>
+#include <opencv2/core.hpp>
+#include <opencv2/dnn.hpp>
+#include "FastDetectionOutputLayer.h"
+#include "DetectionKernels.h"
+#include "ConvKernels.h"
+
+using std::vector;
+using cv::dnn::LayerParams;
+using cv::dnn::MatShape;
+
+FastDetectionOutputLayer::FastDetectionOutputLayer(const LayerParams & params)
+{
+    setParamsFrom(params);
+    _params.numClasses = params.get<int>("num_classes");
+    _params.backgroundLabelId = params.get<int>("background_label_id", 0);
+    _params.confidenceThreshold = params.get<float>("confidence_threshold", -FLT_MAX);
+    _params.nmsThreshold = params.get<float>("nms_threshold", 0.3f);
+    _params.topK = params.get<int>("top_k", -1);
+    _params.keepTopK = params.get<int>("keep_top_k");
+    _params.clip = params.get<bool>("clip", false);
+}
+
+bool FastDetectionOutputLayer::accepts(const LayerParams & params)
+{
+    // the Caffe importer flattens nms_param into the layer parameters
+    return params.has("num_classes") && params.get<int>("keep_top_k", -1) > 0
+        && params.get<bool>("share_location", true) && !params.get<bool>("variance_encoded_in_target", false)
+        && params.get<bool>("normalized_bbox", true) && !params.get<bool>("loc_pred_transposed", false)
+        && params.get<float>("eta", 1.0f) == 1.0f && params.get<cv::String>("code_type", "") == "CENTER_SIZE";
+}
+
+cv::Ptr<cv::dnn::Layer> FastDetectionOutputLayer::create(LayerParams & params)
+{
+    return cv::Ptr<cv::dnn::Layer>(new FastDetectionOutputLayer(params));
+}
+
+bool FastDetectionOutputLayer::getMemoryShapes(const vector<MatShape> & inputs, const int requiredOutputs,
+    vector<MatShape> & outputs, vector<MatShape> & internals) const
+{
+    CV_Assert(inputs.size() >= 3);
+    // the number of detections is unknown before NMS, room is made for the most that can be kept
+    outputs.assign(1, cv::dnn::shape(1, 1, inputs[0][0] * _params.keepTopK, 7));
+    return false;
+}
+
+void FastDetectionOutputLayer::forward(cv::InputArrayOfArrays inputs_arr, cv::OutputArrayOfArrays outputs_arr, cv::OutputArrayOfArrays internals_arr)
+{
+    vector<cv::Mat> inputs, outputs;
+    inputs_arr.getMatVector(inputs);
+    outputs_arr.getMatVector(outputs);
+
+    const cv::Mat & loc = inputs[0];
+    const cv::Mat & conf = inputs[1];
+    const cv::Mat & priors = inputs[2];
+    cv::Mat & detections = outputs[0];
+    const int num = loc.size[0];
+    const int numPriors = static_cast<int>(priors.total() / 8);
+    const bool useAvx2 = cpuHasAvx2();
+
+    float *dst = detections.ptr<float>();
+    const int maxRows = detections.size[2];
+    int rows = 0;
+    for (int n = 0; n < num; n++)
+    {
+        rows += detectionOutput(loc.ptr<float>() + (size_t)n * numPriors * 4, conf.ptr<float>() + (size_t)n * numPriors * _params.numClasses,
+            priors.ptr<float>(), numPriors, _params, _scratch, n, dst + rows * 7, maxRows - rows, useAvx2);
+    }
+
+    // unused rows get image id -1 and zero confidence, as the stock layer does when nothing is detected
+    for (int i = rows; i < maxRows; i++)
+    {
+        float *row = dst + i * 7;
+        row[0] = -1.0f;
+        for (int k = 1; k < 7; k++)
+            row[k] = 0.0f;
+    }
+}
@@ -0,0 +1,23 @@
+#pragma once
+#include <vector>
+#include <opencv2/dnn.hpp>
+#include "DetectionKernels.h"
+
+// SSD DetectionOutput that filters the scores before decoding, only the boxes of priors with a score
+// above the confidence threshold are decoded, followed by per-class NMS with top-k
+class FastDetectionOutputLayer : public cv::dnn::Layer
+{
+public:
+    FastDetectionOutputLayer(const cv::dnn::LayerParams & params);
+    // true if params describe a detection output this layer handles
+    static bool accepts(const cv::dnn::LayerParams & params);
+    static cv::Ptr<cv::dnn::Layer> create(cv::dnn::LayerParams & params);
+
+    bool getMemoryShapes(const std::vector<cv::dnn::MatShape> & inputs, const int requiredOutputs,
+        std::vector<cv::dnn::MatShape> & outputs, std::vector<cv::dnn::MatShape> & internals) const override;
+    void forward(cv::InputArrayOfArrays inputs, cv::OutputArrayOfArrays outputs, cv::OutputArrayOfArrays internals) override;
+
+private:
+    DetectionOutputParams _params;
+    DetectionOutputScratch _scratch;
+};
@@ -0,0 +1,551 @@
+#include <string>
+#include <functional>
+#include <vector>
+#include <sstream>
+#include <iomanip>
+#include <cmath>
+#include <stdexcept>
+#include <Poco/Exception.h>
+#include <Poco/Logger.h>
+#include <Poco/Util/AbstractConfiguration.h>
+#include <opencv2/opencv.hpp>
+#include "FramePipeline.h"
+#include "FrameStages.h"
+#include "DepthCodec.h"
+#include "StageTrace.h"
+#include "EventLog.h"
+#include "StartupTrace.h"
+
+using std::string;
+using std::vector;
+using std::pair;
+using std::ostringstream;
+using Poco::Logger;
+using Poco::Util::AbstractConfiguration;
+
+// depth shown in the depth view, from blue near the camera to red at this distance and beyond
+static const double ColorizeRangeMeters = 6.0;
+
+// metric labels of a camera, followed by more labels if given
+static string cameraLabels(const CameraSettings & camera, const string & labels = "")
+{
+    return "camera=\"" + camera.serial + "\"" + (labels.empty() ? "" : "," + labels);
+}
+
+FramePipeline::FramePipeline(const AbstractConfiguration & config, const CameraSettings & camera, int index, DetectionPublisher * publisher)
+    : _camera(camera)
+    , _index{ index }
+    , _logger{ Logger::get("FramePipeline." + camera.serial) }
+    , _running{ false }
+    , _detecting{ false }
+    , _depthView{ false }
+    , _alignQueue("align", *config.createView("pipeline.queue.align"))
+    , _preprocessQueue("preprocess", *config.createView("pipeline.queue.preprocess"))
+    , _inferenceQueue("inference", *config.createView("pipeline.queue.inference"))
+    , _postprocessQueue("postprocess", *config.createView("pipeline.queue.postprocess"))
+    , _displayQueue("display", *config.createView("pipeline.queue.display"))
+    , _source{ nullptr }
+    , _bgrColor{ false }
+    , _depthScale{ 0.001f }
+    , _depthPool("depth", cameraLabels(camera))
+    , _depthViewPool("depthView", cameraLabels(camera))
+    , _detector(*config.createView("detector"))
+    , _sceneGate(*config.createView("detector.sceneGate"))
+    , _depthGate(*config.createView("detector.depthGate"))
+    , _wasDetecting{ false }
+    , _annotate{ config.getBool("pipeline.annotate", true) }
+    , _publisher{ publisher }
+    , _recorder{ config.getBool("recorder.enabled", false) ? new RecordingWriter(*config.createView("recorder"), camera.serial, index) : nullptr }
+    , _lastFrameNumber{ 0 }
+    , _lastOutputTime{ 0 }
+    , _outputIntervalMs{ 0.0 }
+    , _framesCaptured(metrics().counter("rscvdnn_frames_captured_total", "Frames taken from the camera", cameraLabels(camera)))
+    , _framesSkipped(metrics().counter("rscvdnn_sensor_frames_skipped_total", "Frames the camera produced but the pipeline never received", cameraLabels(camera)))
+    , _framesOutput(metrics().counter("rscvdnn_frames_output_total", "Frames handed to display", cameraLabels(camera)))
+    , _outputFps(metrics().gauge("rscvdnn_output_fps", "Smoothed rate of frames handed to display", cameraLabels(camera)))
+    , _inferenceLatency(metrics().histogram("rscvdnn_inference_latency_seconds", "Duration of a detector run, waiting for a shared network included", cameraLabels(camera)))
+    , _alignDuration(stageDuration(camera.serial, "align"))
+    , _preprocessDuration(stageDuration(camera.serial, "preprocess"))
+    , _inferenceDuration(stageDuration(camera.serial, "inference"))
+    , _postprocessDuration(stageDuration(camera.serial, "postprocess"))
+{
+    for (const pair<string, QueueStats> & queue : queueStats())
+    {
+        string labels = cameraLabels(camera, "queue=\"" + queue.first + "\"");
+        _queueMetrics.push_back(QueueMetrics{
+            &metrics().counter("rscvdnn_queue_enqueued_total", "Frames pushed to a stage queue", labels),
+            &metrics().counter("rscvdnn_queue_dropped_total", "Frames dropped by a full stage queue", labels),
+            &metrics().gauge("rscvdnn_queue_depth", "Frames waiting in a stage queue", labels),
+            &metrics().gauge("rscvdnn_queue_high_water", "Most frames ever waiting in a stage queue", labels) });
+    }
+    _metricsCollector = metrics().addCollector(std::bind(&FramePipeline::collectQueueMetrics, this));
+}
+
+LatencyHistogram & FramePipeline::stageDuration(const string & serial, const string & stage)
+{
+    return metrics().histogram("rscvdnn_stage_duration_seconds", "Processing time of a frame per stage",
+        "camera=\"" + serial + "\",stage=\"" + stage + "\"");
+}
+
+FramePipeline::~FramePipeline()
+{
+    stop();
+    metrics().removeCollector(_metricsCollector);
+}
+
+void FramePipeline::loadModel(const string & prototxt, const string & caffemodel, NetPool * pool)
+{
+    _detector.useNetPool(pool);
+    _detector.loadModel(prototxt, caffemodel);
+}
+
+void FramePipeline::start(FrameSource & source)
+{
+    if (_running)
+        return;
+
+    _source = &source;
+    _bgrColor = source.bgrColor();
+    _depthScale = source.depthScale();
+    _sceneGate.setDepthScale(_depthScale);
+
+    // calculate the proper crop size and region for DNN model to work, unless the camera has a region of its own
+    cv::Size frameSize = source.frameSize();
+    cv::Rect frameRect(cv::Point(0, 0), frameSize);
+    float whRatio = (float)_detector.inputSize().width / _detector.inputSize().height;
+    cv::Size cropSize = ((float)frameSize.width / frameSize.height) > whRatio ?
+        cv::Size(static_cast<int>(frameSize.height * whRatio), frameSize.height) :
+        cv::Size(frameSize.width, static_cast<int>(frameSize.width / whRatio));
+    cv::Point ptRoiLt((frameSize.width - cropSize.width) / 2, (frameSize.height - cropSize.height) / 2);
+    _rectRoi = _camera.roi.empty() ? cv::Rect(ptRoiLt, cropSize) : (_camera.roi & frameRect);
+    if (_rectRoi.empty())
+        throw std::invalid_argument("roi of camera " + _camera.serial + " is outside of its frames");
+    // the parts of the frame around the ROI are grayed out
+    _rectsOutsideRoi.clear();
+    for (const cv::Rect & outside : {
+        cv::Rect(0, 0, frameRect.width, _rectRoi.y),
+        cv::Rect(0, _rectRoi.br().y, frameRect.width, frameRect.height - _rectRoi.br().y),
+        cv::Rect(0, _rectRoi.y, _rectRoi.x, _rectRoi.height),
+        cv::Rect(_rectRoi.br().x, _rectRoi.y, frameRect.width - _rectRoi.br().x, _rectRoi.height) })
+    {
+        if (!outside.empty())
+            _rectsOutsideRoi.push_back(outside);
+    }
+
+    // a frame holds its depth in meters from preprocess on, in every queue after it, in the stage working on it
+    // and with whoever takes it from the display queue, a depth view from postprocess on
+    size_t inFlight = _inferenceQueue.capacity() + _postprocessQueue.capacity() + _displayQueue.capacity() + 6;
+    _depthPool.reset(_rectRoi.size(), CV_64FC1, inFlight);
+    _depthViewPool.reset(frameSize, CV_8UC3, _displayQueue.capacity() + 5);
+    // a source without depth has every object over range
+    _zeroDepth = cv::Mat::zeros(frameSize, CV_16UC1);
+    _colorizer.setRange(_depthScale, ColorizeRangeMeters);
+
+    _lastDetections.clear();
+    _sceneGate.reset();
+    _wasDetecting = false;
+    _lastFrameNumber = 0;
+    _lastOutputTime = 0;
+    _outputIntervalMs = 0.0;
+    _alignQueue.reopen();
+    _preprocessQueue.reopen();
+    _inferenceQueue.reopen();
+    _postprocessQueue.reopen();
+    _displayQueue.reopen();
+    if (_recorder)
+        _recorder->start(source.frameSize(), _depthScale);
+
+    _running = true;
+    _threads.emplace_back(&FramePipeline::runCapture, this);
+    _threads.emplace_back(&FramePipeline::runAlign, this);
+    _threads.emplace_back(&FramePipeline::runPreprocess, this);
+    _threads.emplace_back(&FramePipeline::runInference, this);
+    _threads.emplace_back(&FramePipeline::runPostprocess, this);
+}
+
+void FramePipeline::stop()
+{
+    if (!_running)
+        return;
+
+    _running = false;
+    // a device gone while streaming delivers nothing, the capture stage would wait in read for good
+    _source->requestStop();
+    _alignQueue.close();
+    _preprocessQueue.close();
+    _inferenceQueue.close();
+    _postprocessQueue.close();
+    _displayQueue.close();
+    for (std::thread & thread : _threads)
+        thread.join();
+    _threads.clear();
+    if (_recorder)
+        _recorder->stop();
+
+    if (_wasDetecting)
+        logDetectorStats();
+    logQueueStats();
+}
+
+void FramePipeline::pushFrame(StageQueue<PipelineFrame> & queue, EventQueue id, PipelineFrame & frame)
+{
+    // the frame dropped is the oldest queued one or this one, depending on the policy of the queue,
+    // a queue only refuses frames without dropping one after it was closed by stop, every stage has a frame of
+    // its own to take the dropped ones, whose vectors are kept like those of the queue slots
+    static thread_local PipelineFrame dropped;
+    if (!queue.push(std::move(frame), &dropped) && _running)
+        logEvent(EventId::QueueDropped, _index, dropped.frameNumber, id, queue.stats().dropped);
+    // the buffers of the dropped frame go back to where they came from
+    dropped = PipelineFrame();
+}
+
+bool FramePipeline::nextFrame(PipelineFrame & frame)
+{
+    return _displayQueue.pop(frame);
+}
+
+bool FramePipeline::latestFrame(PipelineFrame & frame)
+{
+    bool found = false;
+    while (_displayQueue.tryPop(frame))
+        found = true;
+    return found;
+}
+
+vector<pair<string, QueueStats>> FramePipeline::queueStats() const
+{
+    return {
+        { _alignQueue.name(), _alignQueue.stats() },
+        { _preprocessQueue.name(), _preprocessQueue.stats() },
+        { _inferenceQueue.name(), _inferenceQueue.stats() },
+        { _postprocessQueue.name(), _postprocessQueue.stats() },
+        { _displayQueue.name(), _displayQueue.stats() }
+    };
+}
+
+void FramePipeline::logQueueStats()
+{
+    for (const pair<string, QueueStats> & queue : queueStats())
+    {
+        ostringstream msg;
+        msg << "queue " << queue.first << ": " << queue.second.enqueued << " enqueued, " << queue.second.dropped
+            << " dropped, high water mark " << queue.second.highWater;
+        poco_information(_logger, msg.str());
+    }
+}
+
+void FramePipeline::collectQueueMetrics()
+{
+    vector<pair<string, QueueStats>> stats = queueStats();
+    for (size_t i = 0; i < stats.size(); i++)
+    {
+        _queueMetrics[i].enqueued->set(stats[i].second.enqueued);
+        _queueMetrics[i].dropped->set(stats[i].second.dropped);
+        _queueMetrics[i].depth->set((double)stats[i].second.depth);
+        _queueMetrics[i].highWater->set((double)stats[i].second.highWater);
+    }
+}
+
+void FramePipeline::countDetections(const Detections & detections)
+{
+    for (const Detection & detection : detections)
+    {
+        if (detection.classId >= (int)_detectionCounts.size())
+            _detectionCounts.resize(detection.classId + 1, nullptr);
+        MetricCounter *& count = _detectionCounts[detection.classId];
+        if (count == nullptr)
+            count = &metrics().counter("rscvdnn_detections_total", "Objects detected by the network",
+                "class=\"" + _detector.className(detection.classId) + "\"");
+        count->add();
+    }
+}
+
+void FramePipeline::runCapture()
+{
+    setTraceThreadName(_camera.serial + " capture");
+    PipelineFrame frame;
+    int64_t waitStart = traceNow();
+    // a recorded source played to its end has no more frames, the stages drain what is queued and finish
+    while (_running && _source->read(frame))
+    {
+        frame.detect = _detecting;
+        frame.bgr = _bgrColor;
+        // gaps in the frame numbers are frames lost before they reached the pipeline
+        if (_lastFrameNumber != 0 && frame.frameNumber > _lastFrameNumber + 1)
+            _framesSkipped.add(frame.frameNumber - _lastFrameNumber - 1);
+        _lastFrameNumber = frame.frameNumber;
+        _framesCaptured.add();
+        setTraceFrame(frame.frameNumber);
+        int64_t readEnd = traceNow();
+        traceStage("read_frame", waitStart, readEnd, frame.sensorTimestamp);
+        logEvent(EventId::FrameCaptured, _index, frame.frameNumber, frame.sensorTimestamp);
+        logEvent(EventId::StageDone, _index, frame.frameNumber, StageCapture, readEnd - waitStart);
+        pushFrame(_alignQueue, QueueAlign, frame);
+        waitStart = traceNow();
+    }
+    _alignQueue.close();
+}
+
+void FramePipeline::runAlign()
+{
+    setTraceThreadName(_camera.serial + " align");
+    PipelineFrame frame;
+    while (_alignQueue.pop(frame))
+    {
+        setTraceFrame(frame.frameNumber);
+        int64_t start = traceNow();
+        {
+            TraceScope scope("align");
+            _source->align(frame);
+        }
+        int64_t elapsed = traceNow() - start;
+        _alignDuration.record(elapsed / 1e6);
+        logEvent(EventId::StageDone, _index, frame.frameNumber, StageAlign, elapsed);
+        pushFrame(_preprocessQueue, QueuePreprocess, frame);
+    }
+    _preprocessQueue.close();
+}
+
+void FramePipeline::runPreprocess()
+{
+    setTraceThreadName(_camera.serial + " preprocess");
+    PipelineFrame frame;
+    while (_preprocessQueue.pop(frame))
+    {
+        setTraceFrame(frame.frameNumber);
+        int64_t start = traceNow();
+        if (frame.detect)
+            preprocess(frame);
+        int64_t elapsed = traceNow() - start;
+        _preprocessDuration.record(elapsed / 1e6);
+        logEvent(EventId::StageDone, _index, frame.frameNumber, StagePreprocess, elapsed);
+        pushFrame(_inferenceQueue, QueueInference, frame);
+    }
+    _inferenceQueue.close();
+}
+
+void FramePipeline::runInference()
+{
+    setTraceThreadName(_camera.serial + " inference");
+    PipelineFrame frame;
+    while (_inferenceQueue.pop(frame))
+    {
+        setTraceFrame(frame.frameNumber);
+        // the gate reference and the statistics follow the detection switch as frames see it
+        if (frame.detect && !_wasDetecting)
+            _sceneGate.reset();
+        else if (!frame.detect && _wasDetecting)
+            logDetectorStats();
+        _wasDetecting = frame.detect;
+
+        int64_t start = traceNow();
+        if (frame.detect)
+            infer(frame);
+        int64_t elapsed = traceNow() - start;
+        _inferenceDuration.record(elapsed / 1e6);
+        logEvent(EventId::StageDone, _index, frame.frameNumber, StageInference, elapsed);
+        pushFrame(_postprocessQueue, QueuePostprocess, frame);
+    }
+    _postprocessQueue.close();
+}
+
+void FramePipeline::runPostprocess()
+{
+    setTraceThreadName(_camera.serial + " postprocess");
+    PipelineFrame frame;
+    while (_postprocessQueue.pop(frame))
+    {
+        setTraceFrame(frame.frameNumber);
+        int64_t start = traceNow();
+        if (frame.detect)
+            measure(frame);
+        // recorded before the detections are drawn into the frame
+        if (_recorder)
+            record(frame);
+        if (frame.detect)
+        {
+            if (_annotate)
+                overlay(frame);
+            if (_publisher != nullptr && _publisher->isRunning())
+                publish(frame);
+        }
+        if (_depthView)
+        {
+            TraceScope scope("colorize");
+            colorize(frame);
+        }
+        int64_t end = traceNow();
+        _postprocessDuration.record((end - start) / 1e6);
+        logEvent(EventId::StageDone, _index, frame.frameNumber, StagePostprocess, end - start);
+
+        // exponentially smoothed output rate, about the last 16 frames
+        if (_lastOutputTime != 0)
+        {
+            double intervalMs = (end - _lastOutputTime) / 1e6;
+            _outputIntervalMs = (_outputIntervalMs > 0.0) ? _outputIntervalMs + (intervalMs - _outputIntervalMs) / 16.0 : intervalMs;
+            if (_outputIntervalMs > 0.0)
+                _outputFps.set(1000.0 / _outputIntervalMs);
+        }
+        _lastOutputTime = end;
+        _framesOutput.add();
+        pushFrame(_displayQueue, QueueDisplay, frame);
+    }
+    _displayQueue.close();
+}
+
+void FramePipeline::preprocess(PipelineFrame & frame)
+{
+    TraceScope scope("preprocess");
+    // BGR for OpenCV, in place in the color frame, unless the source delivers it so, the display takes either
+    frame.matColor = frame.color;
+    if (!frame.bgr)
+        cv::cvtColor(frame.matColor, frame.matColor, cv::COLOR_RGB2BGR);
+    frame.bgr = true;
+    const cv::Mat & matDepthRaw = frame.depth.empty() ? _zeroDepth : frame.depth;
+
+    // crop the input frame, only the ROI is converted to meters
+    frame.matDepthRaw = matDepthRaw(_rectRoi);
+    frame.matDepth = _depthPool.acquire();
+    frame.matDepthRaw.convertTo(frame.matDepth, CV_64F, _depthScale);
+}
+
+void FramePipeline::colorize(PipelineFrame & frame)
+{
+    if (frame.depth.empty())
+        return;
+
+    // jet colors over the range of a few meters, no depth stays black
+    frame.depthView = _depthViewPool.acquire();
+    _colorizer.colorize(frame.depth, frame.depthView);
+}
+
+void FramePipeline::infer(PipelineFrame & frame)
+{
+    cv::Mat matColorRoi = frame.matColor(_rectRoi);
+    // run the network only if the scene changed since the last inferred frame, otherwise reuse its detections
+    if (_sceneGate.shouldInfer(matColorRoi, frame.matDepthRaw))
+    {
+        int64 tickStart = cv::getTickCount();
+        // restrict the detection to foreground regions if there is any depth to tell
+        if (_depthGate.propose(frame.matDepthRaw, _depthScale, _regions))
+            _lastDetections = _detector.detect(matColorRoi, _regions);
+        else
+            _lastDetections = _detector.detect(matColorRoi);
+        double inferenceMs = (cv::getTickCount() - tickStart) * 1000.0 / cv::getTickFrequency();
+        _sceneGate.commit(inferenceMs);
+        _inferenceLatency.record(inferenceMs);
+        countDetections(_lastDetections);
+        startupDetected();
+    }
+    else
+        logEvent(EventId::InferenceSkipped, _index, frame.frameNumber, _sceneGate.skipRun());
+    frame.detections = _lastDetections;
+}
+
+void FramePipeline::measure(PipelineFrame & frame)
+{
+    TraceScope scope("measure");
+    measureDistances(frame.matDepth, frame.detections, frame.distances);
+    if (eventLogEnabled())
+    {
+        for (size_t i = 0; i < frame.detections.size(); i++)
+        {
+            const Detection & detection = frame.detections[i];
+            logEvent(EventId::ObjectDetected, _index, frame.frameNumber, detection.classId, (double)detection.confidence, (double)frame.distances[i]);
+        }
+    }
+}
+
+void FramePipeline::overlay(PipelineFrame & frame)
+{
+    TraceScope scope("overlay");
+    annotateFrame(frame.matColor, _rectRoi, _rectsOutsideRoi, frame.detections, frame.distances,
+        [this](int classId) -> const string & { return _detector.className(classId); }, _overlayBuffers);
+}
+
+vector<PublishedObject> FramePipeline::objects(const PipelineFrame & frame) const
+{
+    vector<PublishedObject> objects;
+    for (size_t i = 0; i < frame.detections.size(); i++)
+    {
+        const Detection & detection = frame.detections[i];
+        objects.push_back(PublishedObject{ detection.classId, detection.confidence,
+            detection.box + _rectRoi.tl(), (i < frame.distances.size()) ? frame.distances[i] : 0.0f });
+    }
+    return objects;
+}
+
+DetectionMessage FramePipeline::detectionMessage(const PipelineFrame & frame) const
+{
+    DetectionMessage message;
+    message.camera = _index;
+    message.frameNumber = frame.frameNumber;
+    message.sensorTimestamp = frame.sensorTimestamp;
+    message.sentUs = 0;
+    message.objects = objects(frame);
+    return message;
+}
+
+void FramePipeline::publish(const PipelineFrame & frame)
+{
+    TraceScope scope("publish");
+    DetectionMessage message = detectionMessage(frame);
+    if (_publisher->sendsDepth() && !frame.depth.empty() && _publisher->clientCount() > 0)
+    {
+        TraceScope scope("depth_encode");
+        encodeDepthRvl(frame.depth, message.depth);
+        message.depthSize = frame.depth.size();
+    }
+    _publisher->publish(message);
+}
+
+void FramePipeline::record(const PipelineFrame & frame)
+{
+    TraceScope scope("record");
+    RecordedFrame recorded;
+    recorded.frameNumber = frame.frameNumber;
+    recorded.timestamp = frame.sensorTimestamp;
+    // copies, the frame is annotated next and its buffers go back to the source, recordings are BGR
+    if (frame.bgr)
+        recorded.color = frame.color.clone();
+    else
+        cv::cvtColor(frame.color, recorded.color, cv::COLOR_RGB2BGR);
+    recorded.depth = frame.depth.clone();
+    recorded.detections = detectionMessage(frame);
+    recorded.detections.sentUs = publisherClockUs();
+    _recorder->record(std::move(recorded));
+}
+
+void FramePipeline::logDetectorStats()
+{
+    if (_sceneGate.enabled())
+    {
+        ostringstream msg;
+        msg << "scene gate: " << _sceneGate.framesSkipped() << " frames skipped, " << _sceneGate.framesInferred()
+            << " frames inferred, about " << std::lround(_sceneGate.cpuSavedMs()) << " ms of inference saved";
+        poco_information(_logger, msg.str());
+    }
+
+    if (_depthGate.enabled() && _depthGate.pixelsFull() > 0)
+    {
+        ostringstream msg;
+        msg << "depth gate: " << std::lround(100.0 * _depthGate.pixelsProposed() / _depthGate.pixelsFull())
+            << "% of ROI pixels fed to the network";
+        poco_information(_logger, msg.str());
+    }
+
+    const CascadeStats & cascade = _detector.cascadeStats();
+    if (_detector.cascadeEnabled() && cascade.frames > 0)
+    {
+        ostringstream msg;
+        msg << std::fixed << std::setprecision(2) << "cascade: " << cascade.cascadeMs / cascade.frames << " ms per frame, "
+            << cascade.rejected << " of " << cascade.frames << " frames rejected by the coarse pass";
+        if (cascade.verifiedFrames > 0)
+        {
+            msg << ", single stage " << cascade.singleStageMs / cascade.verifiedFrames << " ms per frame";
+            if (cascade.referenceObjects > 0)
+                msg << ", recall " << 100.0 * cascade.recalledObjects / cascade.referenceObjects << "%";
+        }
+        poco_information(_logger, msg.str());
+    }
+}
@@ -0,0 +1,150 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+#include <Poco/Logger.h>
+#include <Poco/Util/AbstractConfiguration.h>
+#include <opencv2/opencv.hpp>
+#include "PipelineFrame.h"
+#include "FrameSource.h"
+#include "StageQueue.h"
+#include "Metrics.h"
+#include "DetectionPublisher.h"
+#include "Recording.h"
+#include "MatPool.h"
+#include "FrameStages.h"
+#include "CameraSettings.h"
+#include "SceneChangeGate.h"
+#include "DepthRegionProposal.h"
+#include "ObjectDetector.h"
+#include "EventLog.h"
+
+// Frame pipeline of one camera, fed by a FrameSource. Capture, align, preprocess, inference and postprocess stages each run on their own
+// thread and pass frames to the next stage through a StageQueue, whose capacity and overflow policy are configured per queue under
+// pipeline.queue.<stage> and named after the stage consuming it. The display stage is the GUI thread picking
+// the latest frame of the display queue. When a recorded source ends, every stage finishes the frames queued before it
+// and closes the queue after it. Frame rate, drops, stage durations, inference latency and detections per
+// class are published to the process metrics registry labeled with the camera serial, and the detections of every
+// frame to the clients of the detection publisher if there is one. With recorder.enabled, the frames and their
+// detections are also recorded. The buffers a frame gets on its way come from pools sized at start, frames
+// leaving the pipeline or dropped by a queue give them back.
+class FramePipeline
+{
+public:
+    // index is the number of the camera in published messages, publisher may be null
+    FramePipeline(const Poco::Util::AbstractConfiguration & config, const CameraSettings & camera, int index, DetectionPublisher * publisher);
+    ~FramePipeline();
+    // pool runs the network for this pipeline and others, a network of its own is loaded if null
+    void loadModel(const std::string & prototxt, const std::string & caffemodel, NetPool * pool);
+    cv::Size inputSize() const { return _detector.inputSize(); }
+    const CameraSettings & camera() const { return _camera; }
+
+    // start pulling frames from source, which must already be started
+    void start(FrameSource & source);
+    // stop and join the stage threads, the capture stage may wait for a frame so the source is asked to stop first,
+    // must be called before source is stopped
+    void stop();
+    bool isRunning() const { return _running; }
+    void setDetecting(bool on) { _detecting = on; }
+    void setDepthView(bool on) { _depthView = on; }
+    // the most recent frame ready for display, older ones still queued are skipped
+    bool latestFrame(PipelineFrame & frame);
+    // wait for the next frame ready for display, false once a finished recording is drained or the pipeline stopped
+    bool nextFrame(PipelineFrame & frame);
+    // the detections of frame in color frame coordinates with their distances
+    std::vector<PublishedObject> objects(const PipelineFrame & frame) const;
+    const std::string & className(int classId) const { return _detector.className(classId); }
+
+    // counters of every queue in pipeline order
+    std::vector<std::pair<std::string, QueueStats>> queueStats() const;
+    void logQueueStats();
+    // processing time histogram of a stage, align, preprocess, inference or postprocess, of the pipelines of camera
+    // serial in the metrics registry, it outlives the pipeline
+    static LatencyHistogram & stageDuration(const std::string & serial, const std::string & stage);
+
+private:
+    // series of one stage queue mirrored into the metrics registry
+    struct QueueMetrics
+    {
+        MetricCounter *enqueued;
+        MetricCounter *dropped;
+        MetricGauge *depth;
+        MetricGauge *highWater;
+    };
+
+    void runCapture();
+    void runAlign();
+    void runPreprocess();
+    void runInference();
+    void runPostprocess();
+    // push frame to the next stage, logging a drop
+    void pushFrame(StageQueue<PipelineFrame> & queue, EventQueue id, PipelineFrame & frame);
+    void preprocess(PipelineFrame & frame);
+    void infer(PipelineFrame & frame);
+    void measure(PipelineFrame & frame);
+    void overlay(PipelineFrame & frame);
+    void colorize(PipelineFrame & frame);
+    DetectionMessage detectionMessage(const PipelineFrame & frame) const;
+    void publish(const PipelineFrame & frame);
+    void record(const PipelineFrame & frame);
+    void logDetectorStats();
+    void collectQueueMetrics();
+    void countDetections(const Detections & detections);
+
+    const CameraSettings _camera;
+    const int _index;
+    Poco::Logger & _logger;
+    std::atomic<bool> _running;
+    std::atomic<bool> _detecting;
+    std::atomic<bool> _depthView;
+    StageQueue<PipelineFrame> _alignQueue;
+    StageQueue<PipelineFrame> _preprocessQueue;
+    StageQueue<PipelineFrame> _inferenceQueue;
+    StageQueue<PipelineFrame> _postprocessQueue;
+    StageQueue<PipelineFrame> _displayQueue;
+    std::vector<std::thread> _threads;
+    FrameSource *_source;
+    bool _bgrColor;
+    float _depthScale;
+    cv::Rect _rectRoi;
+    std::vector<cv::Rect> _rectsOutsideRoi;
+    // per-frame buffers, sized at start for the frames that can be in flight, so the steady state allocates none
+    MatPool _depthPool;
+    MatPool _depthViewPool;
+    cv::Mat _zeroDepth;
+    // scratch of the postprocess stage, only touched by its thread while running
+    OverlayBuffers _overlayBuffers;
+    DepthColorizer _colorizer;
+    // state of the inference stage, only touched by its thread while running
+    ObjectDetector _detector;
+    SceneChangeGate _sceneGate;
+    DepthRegionProposal _depthGate;
+    std::vector<cv::Rect> _regions;
+    Detections _lastDetections;
+    bool _wasDetecting;
+    // draw the detections into the color frame, off when nobody looks at the frames
+    const bool _annotate;
+    DetectionPublisher *_publisher;
+    std::unique_ptr<RecordingWriter> _recorder;
+    // detections per class id, created as classes show up
+    std::vector<MetricCounter *> _detectionCounts;
+    // state of the capture and postprocess stages for the frame counts and rate
+    uint64_t _lastFrameNumber;
+    int64_t _lastOutputTime;
+    double _outputIntervalMs;
+    MetricCounter & _framesCaptured;
+    MetricCounter & _framesSkipped;
+    MetricCounter & _framesOutput;
+    MetricGauge & _outputFps;
+    LatencyHistogram & _inferenceLatency;
+    LatencyHistogram & _alignDuration;
+    LatencyHistogram & _preprocessDuration;
+    LatencyHistogram & _inferenceDuration;
+    LatencyHistogram & _postprocessDuration;
+    std::vector<QueueMetrics> _queueMetrics;
+    int _metricsCollector;
+};
@@ -0,0 +1,216 @@
+#include <string>
+#include <chrono>
+#include <algorithm>
+#include <Poco/File.h>
+#include <Poco/Path.h>
+#include <Poco/String.h>
+#include <Poco/Logger.h>
+#include <Poco/Util/AbstractConfiguration.h>
+#include "FrameSource.h"
+#include "RealSenseSource.h"
+#include "VideoFileSource.h"
+#include "ImageSequenceSource.h"
+#include "RecordingSource.h"
+#include "StageTrace.h"
+
+using std::string;
+using Poco::Logger;
+using Poco::Util::AbstractConfiguration;
+
+FrameSource::FrameSource(const string & name, const AbstractConfiguration & config, int decodeThreads)
+    : _logger{ Logger::get("FrameSource." + name) }
+    , _realTime{ config.getBool("playbackRealTime", true) }
+    , _repeat{ config.getBool("playbackRepeat", true) }
+    , _name{ name }
+    , _prefetch{ (size_t)std::max(1, config.getInt("prefetch", 4)) }
+    , _decodeThreads{ std::max(1, decodeThreads) }
+    , _frameIntervalMs{ 0.0 }
+    , _slots(_prefetch, Slot{ PipelineFrame(), SlotState::Free })
+    , _grabCount{ 0 }
+    , _decodeCount{ 0 }
+    , _readCount{ 0 }
+    , _ended{ false }
+    , _stopping{ false }
+{
+}
+
+FrameSource::~FrameSource()
+{
+}
+
+void FrameSource::start()
+{
+    if (!_threads.empty())
+        return;
+
+    _grabCount = 0;
+    _decodeCount = 0;
+    _readCount = 0;
+    _ended = false;
+    _stopping = false;
+    open();
+    _threads.emplace_back(&FrameSource::runReader, this);
+    for (int i = 0; i < _decodeThreads; i++)
+        _threads.emplace_back(&FrameSource::runDecoder, this);
+}
+
+void FrameSource::stop()
+{
+    if (_threads.empty())
+        return;
+
+    requestStop();
+    for (std::thread & thread : _threads)
+        thread.join();
+    _threads.clear();
+    // the frames not read let go of their buffers before the source closes
+    for (Slot & slot : _slots)
+    {
+        slot.frame = PipelineFrame();
+        slot.state = SlotState::Free;
+    }
+    close();
+}
+
+void FrameSource::requestStop()
+{
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _stopping = true;
+    }
+    _changed.notify_all();
+}
+
+bool FrameSource::stopping()
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _stopping;
+}
+
+bool FrameSource::read(PipelineFrame & frame)
+{
+    std::unique_lock<std::mutex> lock(_mutex);
+    while (true)
+    {
+        auto ready = [this] { return _readCount < _grabCount && (_slots[_readCount % _prefetch].state == SlotState::Decoded
+            || _slots[_readCount % _prefetch].state == SlotState::Failed); };
+        _changed.wait(lock, [this, &ready] { return _stopping || ready() || (_ended && _readCount == _grabCount); });
+        if (_stopping || !ready())
+            return false;
+
+        // frames that failed to decode are skipped
+        Slot & slot = _slots[_readCount % _prefetch];
+        bool decoded = slot.state == SlotState::Decoded;
+        if (decoded)
+            frame = std::move(slot.frame);
+        else
+            slot.frame = PipelineFrame();
+        slot.state = SlotState::Free;
+        _readCount++;
+        _changed.notify_all();
+        if (decoded)
+            return true;
+    }
+}
+
+void FrameSource::runReader()
+{
+    setTraceThreadName(_name + " read");
+    auto playStart = std::chrono::steady_clock::now();
+    while (true)
+    {
+        {
+            // read ahead no more than prefetch frames, and no faster than recorded if playing in real time
+            std::unique_lock<std::mutex> lock(_mutex);
+            _changed.wait(lock, [this] { return _stopping || _grabCount - _readCount < _prefetch; });
+            if (_realTime && _frameIntervalMs > 0.0)
+            {
+                auto offset = std::chrono::microseconds((int64_t)(_grabCount * _frameIntervalMs * 1000.0));
+                // a late frame is not made up for by reading the following ones faster
+                if (playStart + offset < std::chrono::steady_clock::now())
+                    playStart = std::chrono::steady_clock::now() - offset;
+                _changed.wait_until(lock, playStart + offset, [this] { return _stopping; });
+            }
+            if (_stopping)
+                return;
+        }
+
+        // the slot of the next frame is free, nobody else touches it until it is grabbed
+        Slot & slot = _slots[_grabCount % _prefetch];
+        slot.frame.sequence = _grabCount;
+        bool grabbed = false;
+        try
+        {
+            TraceScope scope("grab");
+            grabbed = grab(slot.frame);
+        }
+        catch (const std::exception & e)
+        {
+            poco_error(_logger, string("reading frame: ") + e.what());
+        }
+        if (!grabbed)
+            slot.frame = PipelineFrame();
+
+        std::lock_guard<std::mutex> lock(_mutex);
+        if (grabbed)
+        {
+            slot.state = SlotState::Grabbed;
+            _grabCount++;
+        }
+        else
+            _ended = true;
+        _changed.notify_all();
+        if (!grabbed)
+            return;
+    }
+}
+
+void FrameSource::runDecoder()
+{
+    setTraceThreadName(_name + " decode");
+    while (true)
+    {
+        Slot *slot = nullptr;
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            _changed.wait(lock, [this] { return _stopping || _ended || _decodeCount < _grabCount; });
+            if (_stopping || _decodeCount == _grabCount)
+                return;
+            slot = &_slots[_decodeCount % _prefetch];
+            slot->state = SlotState::Decoding;
+            _decodeCount++;
+        }
+
+        uint64_t sequence = slot->frame.sequence;
+        bool decoded = false;
+        try
+        {
+            setTraceFrame(sequence);
+            TraceScope scope("decode");
+            decode(slot->frame);
+            decoded = true;
+        }
+        catch (const std::exception & e)
+        {
+            poco_error(_logger, "decoding frame " + std::to_string(sequence) + ": " + e.what());
+        }
+
+        std::lock_guard<std::mutex> lock(_mutex);
+        slot->state = decoded ? SlotState::Decoded : SlotState::Failed;
+        _changed.notify_all();
+    }
+}
+
+std::unique_ptr<FrameSource> createFrameSource(const CameraSettings & settings, const AbstractConfiguration & config)
+{
+    if (settings.playback.empty())
+        return std::unique_ptr<FrameSource>(new RealSenseSource(settings, config));
+    if (Poco::File(settings.playback).isDirectory())
+        return std::unique_ptr<FrameSource>(new ImageSequenceSource(settings, config));
+    string extension = Poco::Path(settings.playback).getExtension();
+    if (Poco::icompare(extension, "bag") == 0)
+        return std::unique_ptr<FrameSource>(new BagFileSource(settings, config));
+    if (Poco::icompare(extension, "rscvrec") == 0)
+        return std::unique_ptr<FrameSource>(new RecordingSource(settings, config));
+    return std::unique_ptr<FrameSource>(new VideoFileSource(settings, config));
+}
@@ -0,0 +1,99 @@
+#pragma once
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <Poco/Logger.h>
+#include <Poco/Util/AbstractConfiguration.h>
+#include <opencv2/core.hpp>
+#include "CameraSettings.h"
+#include "PipelineFrame.h"
+
+// Where the frames of a pipeline come from: a live camera, a .bag recording, a recording of our own, a video file
+// or a directory of images.
+// A reader thread takes frames from the source in order and up to prefetch frames ahead of the pipeline, decode
+// threads turn them into mats in parallel, and read hands them out in their original order. The frames read ahead
+// are kept in a ring of prefetch slots made with the source, the frame of a sequence in slot sequence % prefetch, so
+// reading ahead allocates nothing of its own. Sources reading files
+// can run at the recorded frame rate or as fast as the pipeline takes their frames, and start over at their end.
+class FrameSource
+{
+public:
+    virtual ~FrameSource();
+    FrameSource(const FrameSource &) = delete;
+    FrameSource & operator=(const FrameSource &) = delete;
+
+    // open the source and start reading ahead
+    void start();
+    // stop reading and close the source, frames not read yet are dropped
+    void stop();
+    // wake read and the reader thread without waiting for them, so a source that delivers no frames, e.g. a device
+    // waiting to be plugged in again, lets its consumer go, stop still has to follow
+    void requestStop();
+    // wait for the next frame in order, false once the source ended and every frame was read, or it stopped
+    bool read(PipelineFrame & frame);
+
+    const std::string & name() const { return _name; }
+    // size of the registered color and depth frames, valid once started
+    virtual cv::Size frameSize() const = 0;
+    // meters per depth unit
+    virtual float depthScale() const = 0;
+    // channel order of the color frames, RGB unless the source delivers BGR
+    virtual bool bgrColor() const { return false; }
+    // register color and depth of a frame read, runs on the align stage, sources delivering registered frames
+    // have nothing to do
+    virtual void align(PipelineFrame & frame) {}
+
+protected:
+    // config is the cameras section, for the playback and prefetch settings
+    FrameSource(const std::string & name, const Poco::Util::AbstractConfiguration & config, int decodeThreads);
+    // every derived source has to stop in its destructor, before its members are gone
+    virtual void open() = 0;
+    virtual void close() = 0;
+    // take the next frame from the source on the reader thread, its sequence is set, false at the end
+    virtual bool grab(PipelineFrame & frame) = 0;
+    // turn what grab took into color and depth mats on a decode thread
+    virtual void decode(PipelineFrame & frame) {}
+    // the recorded frame rate, frames are read no faster than this if the playback is real time, 0 if unknown
+    void setFrameRate(double fps) { _frameIntervalMs = (fps > 0.0) ? 1000.0 / fps : 0.0; }
+    bool stopping();
+
+    Poco::Logger & _logger;
+    const bool _realTime;
+    const bool _repeat;
+
+private:
+    enum class SlotState : uint8_t { Free, Grabbed, Decoding, Decoded, Failed };
+
+    // a frame read ahead, owned by whichever thread its state says, the reader while free, a decoder while decoding
+    struct Slot
+    {
+        PipelineFrame frame;
+        SlotState state;
+    };
+
+    void runReader();
+    void runDecoder();
+
+    const std::string _name;
+    const size_t _prefetch;
+    const int _decodeThreads;
+    double _frameIntervalMs;
+    std::vector<std::thread> _threads;
+    std::mutex _mutex;
+    std::condition_variable _changed;
+    std::vector<Slot> _slots;
+    // frames taken from the source, handed to a decoder and read, the slots of the frames in between are taken
+    uint64_t _grabCount;
+    uint64_t _decodeCount;
+    uint64_t _readCount;
+    bool _ended;
+    bool _stopping;
+};
+
+// the source of a camera, a live device unless its playback is a .bag file, a .rscvrec recording, a video file or
+// a directory of images
+std::unique_ptr<FrameSource> createFrameSource(const CameraSettings & settings, const Poco::Util::AbstractConfiguration & config);
@@ -0,0 +1,125 @@
+#include <cstdio>
+#include <algorithm>
+#include <string>
+#include <vector>
+#include <opencv2/opencv.hpp>
+#include "FrameStages.h"
+
+using std::string;
+using std::vector;
+
+void measureDistances(const cv::Mat & depth, const Detections & detections, vector<float> & distances)
+{
+    distances.clear();
+    for (const Detection & detection : detections)
+    {
+        cv::Rect object = detection.box & cv::Rect(0, 0, depth.cols, depth.rows);
+
+        // mean depth inside the detection region
+        int nzCount = cv::countNonZero(depth(object));
+        double meanDistance = (nzCount > 0) ? cv::sum(depth(object))[0] / nzCount : 0.0;
+        distances.push_back((float)meanDistance);
+    }
+}
+
+void annotateFrame(cv::Mat & frame, const cv::Rect & roi, const vector<cv::Rect> & outside, const Detections & detections,
+    const vector<float> & distances, const std::function<const string & (int)> & className, OverlayBuffers & buffers)
+{
+    cv::Mat matColorRoi = frame(roi);
+    cv::Rect roiRect(0, 0, roi.width, roi.height);
+    for (size_t i = 0; i < detections.size(); i++)
+    {
+        const Detection & detection = detections[i];
+        cv::Rect object = detection.box & roiRect;
+        cv::rectangle(matColorRoi, object, cv::Scalar(0, 255, 0));
+
+        // two significant digits, as a stream with precision 2 prints them, the text reuses the buffer of the last one
+        buffers.text = "<";
+        buffers.text += className(detection.classId);
+        buffers.text += "> : ";
+        if (distances[i] > 0.0f)
+        {
+            char distance[16];
+            std::snprintf(distance, sizeof(distance), "%.2g", distances[i]);
+            buffers.text += distance;
+            buffers.text += " meters away";
+        }
+        else
+            buffers.text += "over range";
+
+        // the label centered on the object
+        int baseLine = 0;
+        cv::Size labelSize = getTextSize(buffers.text, cv::FONT_HERSHEY_COMPLEX, 0.6, 2, &baseLine);
+        cv::Point ptCenter = (object.br() + object.tl()) * 0.5;
+        ptCenter.x = ptCenter.x - labelSize.width / 2;
+        cv::rectangle(matColorRoi,
+            cv::Rect(cv::Point(ptCenter.x, ptCenter.y - labelSize.height), cv::Size(labelSize.width, labelSize.height + baseLine)),
+            cv::Scalar(128, 255, 128), CV_FILLED);
+        putText(matColorRoi, buffers.text, ptCenter, cv::FONT_HERSHEY_COMPLEX, 0.6, cv::Scalar(0, 0, 0), 2);
+    }
+
+    // gray out the outside of ROI, through a scratch of the frame size so strips of any size fit in it
+    buffers.gray.create(frame.size(), CV_8UC1);
+    for (const cv::Rect & rect : outside)
+    {
+        cv::Mat matColorOutside = frame(rect);
+        cv::Mat matGray = buffers.gray(cv::Rect(0, 0, rect.width, rect.height));
+        cv::cvtColor(matColorOutside, matGray, cv::COLOR_BGR2GRAY);
+        cv::cvtColor(matGray, matColorOutside, cv::COLOR_GRAY2BGR);
+    }
+}
+
+InputBlob::InputBlob(double scale, double mean)
+    : _scale{ scale }
+    , _mean{ mean }
+{
+}
+
+const cv::Mat & InputBlob::set(const cv::Mat * images, size_t count, const cv::Size & size)
+{
+    int sizes[] = { (int)count, 3, size.height, size.width };
+    _blob.create(4, sizes, CV_32F);
+    for (size_t i = 0; i < count; i++)
+    {
+        const cv::Mat * image = &images[i];
+        if (image->size() != size)
+        {
+            cv::resize(*image, _resized, size, 0, 0, cv::INTER_LINEAR);
+            image = &_resized;
+        }
+        // (x - mean) * scale in the order blobFromImages computes it, so the blobs are the same to the bit, then every
+        // channel into its plane of the blob
+        image->convertTo(_scaled, CV_32F);
+        _scaled -= cv::Scalar::all(_mean);
+        _scaled *= _scale;
+        for (int c = 0; c < 3; c++)
+            _planes[c] = cv::Mat(size, CV_32F, _blob.ptr<float>((int)i, c));
+        cv::split(_scaled, _planes);
+    }
+    return _blob;
+}
+
+DepthColorizer::DepthColorizer()
+    : _scale{ 0.0 }
+{
+    // the jet colormap looked up once, applyColorMap builds its table on every call
+    cv::Mat ramp(1, 256, CV_8UC1);
+    for (int i = 0; i < 256; i++)
+        ramp.at<uchar>(i) = (uchar)i;
+    cv::applyColorMap(ramp, _lut, cv::COLORMAP_JET);
+    cv::cvtColor(_lut, _lut, cv::COLOR_BGR2RGB);
+}
+
+void DepthColorizer::setRange(float depthScale, double rangeMeters)
+{
+    _scale = 255.0 / (rangeMeters / depthScale);
+}
+
+void DepthColorizer::colorize(const cv::Mat & depth, cv::Mat & view)
+{
+    depth.convertTo(_depth8, CV_8U, _scale);
+    cv::cvtColor(_depth8, _depth8x3, cv::COLOR_GRAY2BGR);
+    cv::LUT(_depth8x3, _lut, view);
+    cv::compare(depth, 0, _holes, cv::CMP_EQ);
+    view.setTo(cv::Scalar::all(0), _holes);
+}
@@ -0,0 +1,61 @@
+#pragma once
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+#include <opencv2/core.hpp>
+#include "Detection.h"
+
+// Per-frame work of the pipeline stages that does not depend on pipeline state, shared with the stage benchmarks.
+// Whatever a stage needs from one frame to the next is kept in buffers owned by the caller, so a stage allocates
+// nothing once the first frames went through.
+
+// mean distance in meters of the nonzero depth inside every detection, 0 if there is none, depth is the ROI in meters
+void measureDistances(const cv::Mat & depth, const Detections & detections, std::vector<float> & distances);
+
+// what annotateFrame keeps between frames, the gray scratch and the text of the label being drawn
+struct OverlayBuffers
+{
+    cv::Mat gray;
+    std::string text;
+};
+
+// draw the detections with their class and distance into the ROI of a BGR frame and turn the rest of the frame, given
+// as the rects outside of the ROI, gray, the frame stays BGR, putText allocates for every label it draws
+void annotateFrame(cv::Mat & frame, const cv::Rect & roi, const std::vector<cv::Rect> & outside, const Detections & detections,
+    const std::vector<float> & distances, const std::function<const std::string & (int)> & className, OverlayBuffers & buffers);
+
+// Network input blob of a batch of images, stretched to the input size, mean subtracted and scaled in BGR order,
+// as cv::dnn::blobFromImages does without swapping channels or cropping, which is what the box decoding assumes.
+class InputBlob
+{
+public:
+    InputBlob(double scale, double mean);
+    // the blob of count images at size, valid until the next call
+    const cv::Mat & set(const cv::Mat * images, size_t count, const cv::Size & size);
+
+private:
+    const double _scale;
+    const double _mean;
+    cv::Mat _blob;
+    cv::Mat _resized;
+    cv::Mat _scaled;
+    cv::Mat _planes[3];
+};
+
+// RGB jet colors of depth from blue near the camera to red at the range and beyond, no depth stays black
+class DepthColorizer
+{
+public:
+    DepthColorizer();
+    void setRange(float depthScale, double rangeMeters);
+    // view is written in place if it already has the size of depth
+    void colorize(const cv::Mat & depth, cv::Mat & view);
+
+private:
+    cv::Mat _lut;
+    double _scale;
+    cv::Mat _depth8;
+    cv::Mat _depth8x3;
+    cv::Mat _holes;
+};
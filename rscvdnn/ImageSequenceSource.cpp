@@ -0,0 +1,92 @@
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <stdexcept>
+#include <Poco/DirectoryIterator.h>
+#include <Poco/File.h>
+#include <Poco/Path.h>
+#include <Poco/String.h>
+#include <Poco/Util/AbstractConfiguration.h>
+#include <opencv2/opencv.hpp>
+#include "ImageSequenceSource.h"
+
+using std::string;
+using std::vector;
+using std::pair;
+using Poco::DirectoryIterator;
+using Poco::File;
+using Poco::Path;
+using Poco::Util::AbstractConfiguration;
+
+static const string ColorSuffix = "_color.png";
+static const string DepthSuffix = "_depth.png";
+
+ImageSequenceSource::ImageSequenceSource(const CameraSettings & settings, const AbstractConfiguration & config)
+    : FrameSource(settings.serial, config, config.getInt("decodeThreads", 2))
+    , _directory{ settings.playback }
+    , _fps{ (double)settings.color.fps }
+    , _depthScale{ (float)config.getDouble("depthScale", 0.001) }
+    , _next{ 0 }
+{
+}
+
+ImageSequenceSource::~ImageSequenceSource()
+{
+    stop();
+}
+
+void ImageSequenceSource::open()
+{
+    _images.clear();
+    for (DirectoryIterator it(_directory), end; it != end; ++it)
+    {
+        const string & name = it.name();
+        if (name.size() <= ColorSuffix.size() || Poco::icompare(name, name.size() - ColorSuffix.size(), ColorSuffix.size(), ColorSuffix) != 0)
+            continue;
+        Path depth(it.path());
+        depth.setFileName(name.substr(0, name.size() - ColorSuffix.size()) + DepthSuffix);
+        _images.push_back({ it.path().toString(), File(depth).exists() ? depth.toString() : "" });
+    }
+    if (_images.empty())
+        throw std::runtime_error("no *" + ColorSuffix + " images in " + _directory);
+    std::sort(_images.begin(), _images.end());
+
+    cv::Mat first = cv::imread(_images[0].first, cv::IMREAD_COLOR);
+    if (first.empty())
+        throw std::runtime_error("cannot read image " + _images[0].first);
+    _frameSize = first.size();
+    setFrameRate(_fps);
+    _next = 0;
+}
+
+bool ImageSequenceSource::grab(PipelineFrame & frame)
+{
+    if (_next == _images.size())
+    {
+        if (!_repeat)
+        {
+            poco_information(_logger, "end of " + _directory);
+            return false;
+        }
+        _next = 0;
+    }
+    // the decode threads find the images by the frame number
+    frame.frameNumber = _next++;
+    frame.sensorTimestamp = (_fps > 0.0) ? frame.frameNumber * 1000.0 / _fps : 0.0;
+    return true;
+}
+
+void ImageSequenceSource::decode(PipelineFrame & frame)
+{
+    const pair<string, string> & images = _images[frame.frameNumber];
+    frame.color = cv::imread(images.first, cv::IMREAD_COLOR);
+    if (frame.color.size() != _frameSize)
+        throw std::runtime_error("image " + images.first + " is missing or not the size of the first one");
+    cv::cvtColor(frame.color, frame.color, cv::COLOR_BGR2RGB);
+    if (!images.second.empty())
+    {
+        frame.depth = cv::imread(images.second, cv::IMREAD_ANYDEPTH);
+        if (frame.depth.size() != _frameSize || frame.depth.type() != CV_16UC1)
+            throw std::runtime_error("depth image " + images.second + " is not 16 bit or not the size of its color image");
+    }
+}
@@ -0,0 +1,34 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <Poco/Util/AbstractConfiguration.h>
+#include <opencv2/core.hpp>
+#include "CameraSettings.h"
+#include "FrameSource.h"
+
+// A directory of images, <name>_color.png for every frame with <name>_depth.png holding its 16 bit depth
+// registered to the color image if there is depth, played in the order of the names at the frame rate of the camera.
+// The images are read and decoded by the decode threads in parallel.
+class ImageSequenceSource : public FrameSource
+{
+public:
+    ImageSequenceSource(const CameraSettings & settings, const Poco::Util::AbstractConfiguration & config);
+    ~ImageSequenceSource();
+    cv::Size frameSize() const override { return _frameSize; }
+    float depthScale() const override { return _depthScale; }
+
+protected:
+    void open() override;
+    void close() override {}
+    bool grab(PipelineFrame & frame) override;
+    void decode(PipelineFrame & frame) override;
+
+private:
+    const std::string _directory;
+    const double _fps;
+    const float _depthScale;
+    // the color image and the depth image or empty of every frame, not changed while started
+    std::vector<std::pair<std::string, std::string>> _images;
+    cv::Size _frameSize;
+    size_t _next;
+};
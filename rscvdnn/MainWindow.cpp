@@ -1,7 +1,10 @@
 #include <string>
 #include <sstream>
+#include <iomanip>
 #include <cmath>
+#include <Poco/AutoPtr.h>
 #include <Poco/Logger.h>
+#include <Poco/Notification.h>
 #include <Poco/Util/Application.h>
 #include <Poco/Util/AbstractConfiguration.h>
 #include <Eigen/Core>
@@ -17,12 +20,15 @@
 #include <opencv2/dnn.hpp>
 #include "MainWindow.h"
 #include "VideoWindow.h"
+#include "CameraRig.h"
+#include "StreamController.h"
+#include "StageTrace.h"
 
 using std::string;
-using std::mutex;
-using std::lock_guard;
 using std::ostringstream;
+using Poco::AutoPtr;
 using Poco::Logger;
+using Poco::Notification;
 using Poco::Util::Application;
 using Poco::Util::AbstractConfiguration;
 using Eigen::Vector2i;
@@ -34,20 +40,14 @@ using nanogui::Label;
 using nanogui::Button;
 using nanogui::MessageDialog;
 
-MainWindow::MainWindow(const Vector2i & size, const string & caption)
+MainWindow::MainWindow(const Vector2i & size, const string & caption, CameraRig & rig, StreamController & stream)
     : Screen(size, caption)
     , _logger{ Logger::get("MainWindow") }
     , _config(Application::instance().config())
-    , _isVideoStarted{ false }
     , _colorRatio{ 16.0f / 9.0f }
     , _depthRatio{ 16.0f / 9.0f }
-    , _align(RS2_STREAM_COLOR)
-    , _inWidth{ 300 }
-    , _inHeight{ 300 }
-    , _inScaleFactor{ 0.007843f }
-    , _meanVal{ 127.5f }
-    , _classNames{ "background", "aeroplane", "bicycle", "bird", "boat", "bottle", "bus", "car", "cat", "chair",
-                   "cow", "diningtable", "dog", "horse", "motorbike", "person", "pottedplant", "sheep", "sofa", "train", "tvmonitor" }
+    , _rig(rig)
+    , _stream(stream)
 {
     // initialize text translation table
     initTextMap();
@@ -76,74 +76,58 @@ MainWindow::MainWindow(const Vector2i & size, const string & caption)
     _btnStartCvdnn->setTooltip("Start MobileNet Single-Shot Detector");
     _btnStartCvdnn->setChangeCallback([&](bool state) { onToggleCvdnn(state); });
 
-    _colorWindow = nullptr;
-    _depthWindow = nullptr;
+    // the cameras started with the window show their color stream, detecting if asked to, once their start succeeded,
+    // its event is still queued even if it is done
+    StreamState state = _stream.state();
+    _autoStarting = state == StreamState::Starting || state == StreamState::Streaming || state == StreamState::Detecting;
 
     performLayout();
 
-    // load trained DNN model
-    _net = cv::dnn::readNetFromCaffe("MobileNetSSD_deploy.prototxt", "MobileNetSSD_deploy.caffemodel");
+    // the GUI thread is the display stage
+    setTraceThreadName("display");
 }
 
 void MainWindow::onToggleColorStream(bool on)
 {
-    if (on && !tryStartVideo())
+    if (!on && !_colorWindows.empty())
     {
-        _btnColorStream->setPushed(false);
-        return;
-    }
-
-    if (on && _colorWindow == nullptr)
-    {
-        _colorWindow = new VideoWindow(this, _textmap[TextId::ColorStream]);
-        _colorWindow->setPosition(Vector2i(_settingWindow->size()(0), 0));
-        performLayout();
-        resizeEvent(this->size());
-    }
-    else if (!on && _colorWindow != nullptr)
-    {
-        _colorWindow->dispose();
-        _colorWindow = nullptr;
-        if (_depthWindow == nullptr)
-            stopVideo();
+        for (VideoWindow *window : _colorWindows)
+            window->dispose();
+        _colorWindows.clear();
     }
+    // the windows open once the cameras are streaming, which may take a while
+    syncStream();
+    if (on)
+        showVideoWindows();
 }
 
 void MainWindow::onToggleDepthStream(bool on)
 {
-    if (on && !tryStartVideo())
+    if (!on && !_depthWindows.empty())
     {
-        _btnDepthStream->setPushed(false);
-        return;
-    }
-
-    if (on && _depthWindow == nullptr)
-    {
-        _depthWindow = new VideoWindow(this, _textmap[TextId::DepthStream]);
-        _depthWindow->setPosition(Vector2i(_settingWindow->size()(0) + 30, 30));
-        performLayout();
-        resizeEvent(this->size());
-    }
-    else if (!on && _depthWindow != nullptr)
-    {
-        _depthWindow->dispose();
-        _depthWindow = nullptr;
-        if (_colorWindow == nullptr)
-            stopVideo();
+        if (_stream.isStreaming())
+            _rig.setDepthView(false);
+        for (VideoWindow *window : _depthWindows)
+            window->dispose();
+        _depthWindows.clear();
     }
+    syncStream();
+    if (on)
+        showVideoWindows();
 }
 
 void MainWindow::onToggleCvdnn(bool on)
 {
-    if (on && !isVideoStarted())
+    // a stream still starting is asked to detect once it is up
+    if (on && !_stream.isStreaming() && _stream.state() != StreamState::Starting)
     {
         new MessageDialog(this, MessageDialog::Type::Warning, "Warning", "Please start playing color or depth stream before DNN detector.");
         _btnStartCvdnn->setPushed(false);
         return;
     }
 
-    lock_guard<mutex> guard{ _mutex };
-    _isCvdnnStarted = on;
+    // a switch during a transition is applied when it is done
+    _stream.setDetecting(on);
 }
 
 bool MainWindow::keyboardEvent(int key, int scancode, int action, int modifiers)
@@ -156,6 +140,12 @@ bool MainWindow::keyboardEvent(int key, int scancode, int action, int modifiers)
         setVisible(false);
         return true;
     }
+
+    if (key == GLFW_KEY_T && action == GLFW_PRESS)
+    {
+        dumpTrace();
+        return true;
+    }
     return false;
 }
 
@@ -165,28 +155,43 @@ bool MainWindow::resizeEvent(const Eigen::Vector2i & size)
     Vector2i new_setting_size = Vector2i(std::max(150, _settingWindow->size()(0)), size(1) - 3);
     _settingWindow->setSize(new_setting_size);
 
-    // color window take full available space
-    if (_colorWindow != nullptr)
-        _colorWindow->setSize(Vector2i(size(0) - new_setting_size(0) - 3, size(1) - 15));
+    // the cameras share the available space in a grid, color windows take a full cell each
+    size_t count = std::max(_colorWindows.size(), _depthWindows.size());
+    if (count == 0)
+        return true;
+    int columns = (int)std::ceil(std::sqrt((double)count));
+    int rows = (int)((count + columns - 1) / columns);
+    Vector2i cellSize((size(0) - new_setting_size(0) - 3) / columns, (size(1) - 15) / rows);
 
-    if (_depthWindow != nullptr)
+    for (size_t i = 0; i < count; i++)
     {
-        float depth2ScreenRatio = 0.25f;
-        // rescale depth window to fit with depth frame
-        Vector2i new_depth_size(0, 0);
-        if (_depthRatio > ((float)size(0) / size(1)))
+        Vector2i cellPosition(new_setting_size(0) + (int)(i % columns) * cellSize(0), (int)(i / columns) * cellSize(1));
+        if (i < _colorWindows.size())
         {
-            // space width is smaller than expected ratio
-            new_depth_size(0) = std::lround(size(0) * depth2ScreenRatio);
-            new_depth_size(1) = std::lround(new_depth_size(0) / _depthRatio);
+            _colorWindows[i]->setPosition(cellPosition);
+            _colorWindows[i]->setSize(cellSize);
         }
-        else
+
+        if (i < _depthWindows.size())
         {
-            // space height is smaller than expected ratio
-            new_depth_size(1) = std::lround(size(1) * depth2ScreenRatio);
-            new_depth_size(0) = std::lround(new_depth_size(1) * _depthRatio);
+            float depth2ScreenRatio = 0.25f;
+            // rescale depth window to fit with depth frame
+            Vector2i new_depth_size(0, 0);
+            if (_depthRatio > ((float)cellSize(0) / cellSize(1)))
+            {
+                // space width is smaller than expected ratio
+                new_depth_size(0) = std::lround(cellSize(0) * depth2ScreenRatio);
+                new_depth_size(1) = std::lround(new_depth_size(0) / _depthRatio);
+            }
+            else
+            {
+                // space height is smaller than expected ratio
+                new_depth_size(1) = std::lround(cellSize(1) * depth2ScreenRatio);
+                new_depth_size(0) = std::lround(new_depth_size(1) * _depthRatio);
+            }
+            _depthWindows[i]->setPosition(cellPosition + Vector2i(30, 30));
+            _depthWindows[i]->setSize(new_depth_size);
         }
-        _depthWindow->setSize(new_depth_size);
     }
 
     return true;
@@ -194,27 +199,46 @@ bool MainWindow::resizeEvent(const Eigen::Vector2i & size)
 
 void MainWindow::draw(NVGcontext * ctx)
 {
-    if (isVideoStarted())
+    // frames are captured, detected and annotated by the pipeline threads, only the latest one of each camera is shown
+    handleStreamEvents();
+    PipelineFrame frame;
+    for (size_t i = 0; _stream.isStreaming() && i < _rig.cameraCount(); i++)
     {
-        rs2::frameset frames = _pipe.wait_for_frames();
-        frames = _align.proccess(frames);
-        rs2::video_frame colorFrame = frames.get_color_frame();
-        rs2::depth_frame depthFrame = frames.get_depth_frame();
+        if (!_rig.pipeline(i).latestFrame(frame))
+            continue;
+        setTraceFrame(frame.frameNumber);
+        if (i < _colorWindows.size())
+            _colorWindows[i]->setVideoFrame(frame.color, frame.bgr);
+
+        if (i < _depthWindows.size() && !frame.depthView.empty())
+            _depthWindows[i]->setVideoFrame(frame.depthView);
+    }
 
-        if (isCvdnnStarted())
-            detectObjects(colorFrame, depthFrame, _depthScale);
+    Screen::draw(ctx);
+}
 
-        if (_colorWindow != nullptr)
-            _colorWindow->setVideoFrame(colorFrame);
+void MainWindow::drawAll()
+{
+    // widgets, video textures and the buffer swap of the frame set in draw
+    TraceScope scope("draw_swap");
+    Screen::drawAll();
+}
 
-        if (_depthWindow != nullptr)
-        {
-            rs2::colorizer colormap;
-            _depthWindow->setVideoFrame(colormap(depthFrame));
-        }
+void MainWindow::dumpTrace()
+{
+    // the first press starts tracing if it is off in the configuration, the next one writes the trace
+    if (!traceEnabled())
+    {
+        setTraceEnabled(true);
+        poco_information(_logger, "stage tracing started, press T again to write the trace");
+        return;
     }
 
-    Screen::draw(ctx);
+    string path = _config.getString("trace.path", "rscvdnn_trace.json");
+    if (writeChromeTrace(path))
+        poco_information(_logger, "stage trace written to " + path);
+    else
+        poco_error(_logger, "cannot write stage trace to " + path);
 }
 
 void MainWindow::initTextMap()
@@ -229,166 +253,80 @@ void MainWindow::initTextMap()
     _textmap[TextId::StartDetect] = _config.getString(lang + ".StartDetect", "Start Detecting");
 }
 
-bool MainWindow::tryStartVideo()
+void MainWindow::syncStream()
 {
-    lock_guard<mutex> guard{ _mutex };
-
-    if (_isVideoStarted)
-        return true;
+    if (_btnColorStream->pushed() || _btnDepthStream->pushed())
+        _stream.start();
+    else
+        _stream.stop();
+}
 
-    try
+void MainWindow::handleStreamEvents()
+{
+    while (true)
     {
-        // check if realsense device connected
-        rs2::context ctx;
-        if (ctx.query_devices().size() == 0)
+        AutoPtr<Notification> notification(_stream.events().dequeueNotification());
+        StreamEvent *event = dynamic_cast<StreamEvent *>(notification.get());
+        if (event == nullptr)
+            break;
+
+        bool autoStarted = _autoStarting && event->transition() == StreamState::Starting;
+        if (autoStarted)
+            _autoStarting = false;
+        if (event->transition() == StreamState::Starting && event->state() == StreamState::Idle)
         {
-            new MessageDialog(this, MessageDialog::Type::Warning, "Warning", "No RealSense device is found, please connect the device and try again.");
-            return false;
+            new MessageDialog(this, MessageDialog::Type::Warning, "Warning", event->error());
+            _btnColorStream->setPushed(false);
+            _btnDepthStream->setPushed(false);
+            _btnStartCvdnn->setPushed(false);
+            continue;
         }
-
-        // Even though both streams are manually configured here,
-        // the depth frame will have the same size as color frame after align process
-        rs2::config config;
-        config.enable_stream(RS2_STREAM_COLOR, 1920, 1080, RS2_FORMAT_RGB8, 30);
-        config.enable_stream(RS2_STREAM_DEPTH, 640, 480, RS2_FORMAT_Z16, 30);
-        // Start streaming with configured streams
-        auto profile = _pipe.start(config).get_stream(RS2_STREAM_COLOR).as<rs2::video_stream_profile>();
-        _depthScale = _pipe.get_active_profile().get_device().first<rs2::depth_sensor>().get_depth_scale();
-
-        // calculate the proper crop size and region for DNN model to work
-        float whRatio = (float)_inWidth / _inHeight;
-        cv::Size cropSize = ((float)profile.width() / profile.height()) > whRatio ?
-            cv::Size(static_cast<int>(profile.height() * whRatio), profile.height()) :
-            cv::Size(profile.width(), static_cast<int>(profile.width() / whRatio));
-        cv::Point ptRoiLt((profile.width() - cropSize.width) / 2, (profile.height() - cropSize.height) / 2);
-        _rectRoi = cv::Rect(ptRoiLt, cropSize);
-        _rectRoiLeft = cv::Rect(0, 0, _rectRoi.tl().x - 1, cropSize.height);
-        _rectRoiRight = cv::Rect(_rectRoi.br().x + 1, 0, profile.width() - _rectRoi.br().x - 1, cropSize.height);
-
-        _isVideoStarted = true;
-        return true;
-    }
-    catch (const rs2::error & e)
-    {
-        ostringstream errmsg;
-        errmsg << "RealSense error calling " << e.get_failed_function() << "(" << e.get_failed_args() << "):\n    " << e.what();
-        poco_error(_logger, errmsg.str());
-        return false;
-    }
-    catch (const std::exception & e)
-    {
-        poco_error(_logger, string(e.what()));
-        return false;
+        if (autoStarted)
+        {
+            _btnColorStream->setPushed(true);
+            // detection may also have been switched on while the cameras were starting
+            _btnStartCvdnn->setPushed(_btnStartCvdnn->pushed() || event->state() == StreamState::Detecting);
+        }
+        if (event->transition() == StreamState::Starting)
+        {
+            _stream.setDetecting(_btnStartCvdnn->pushed());
+            showVideoWindows();
+        }
+        // the buttons may have changed while the cameras were starting or stopping
+        syncStream();
     }
 }
 
-void MainWindow::stopVideo()
+void MainWindow::showVideoWindows()
 {
-    lock_guard<mutex> guard{ _mutex };
-
-    if (!_isVideoStarted)
+    if (!_stream.isStreaming())
         return;
 
-    try
+    bool opened = false;
+    if (_btnColorStream->pushed() && _colorWindows.empty())
     {
-        _isVideoStarted = false;
-        _pipe.stop();
+        for (size_t i = 0; i < _rig.cameraCount(); i++)
+            _colorWindows.push_back(new VideoWindow(this, videoTitle(TextId::ColorStream, i)));
+        opened = true;
     }
-    catch (const rs2::error & e)
+    if (_btnDepthStream->pushed() && _depthWindows.empty())
     {
-        ostringstream errmsg;
-        errmsg << "RealSense error calling " << e.get_failed_function() << "(" << e.get_failed_args() << "):\n    " << e.what();
-        poco_error(_logger, errmsg.str());
-        return;
+        for (size_t i = 0; i < _rig.cameraCount(); i++)
+            _depthWindows.push_back(new VideoWindow(this, videoTitle(TextId::DepthStream, i)));
+        opened = true;
     }
-    catch (const std::exception & e)
+    if (opened)
     {
-        poco_error(_logger, string(e.what()));
-        return;
+        performLayout();
+        resizeEvent(this->size());
     }
+    _rig.setDepthView(!_depthWindows.empty());
 }
 
-bool MainWindow::isVideoStarted()
-{
-    lock_guard<mutex> guard{ _mutex };
-    return _isVideoStarted;
-}
-
-bool MainWindow::isCvdnnStarted()
-{
-    lock_guard<mutex> guard{ _mutex };
-    return _isCvdnnStarted;
-}
-
-void MainWindow::detectObjects(rs2::video_frame color_frame, rs2::depth_frame depth_frame, float depth_scale)
+string MainWindow::videoTitle(TextId stream, size_t index)
 {
-    // convert RealSense frame to OpenCV Mat
-    cv::Mat matColor(cv::Size(color_frame.get_width(), color_frame.get_height()), CV_8UC3, (void*)color_frame.get_data(), cv::Mat::AUTO_STEP);
-    cv::cvtColor(matColor, matColor, cv::COLOR_RGB2BGR);
-    // convert and clone depth frame to OpenCV Mat
-    cv::Mat matDepth = cv::Mat(cv::Size(depth_frame.get_width(), depth_frame.get_height()), CV_16UC1, (void*)depth_frame.get_data(), cv::Mat::AUTO_STEP).clone();
-    matDepth.convertTo(matDepth, CV_64F);
-    matDepth = matDepth * _depthScale;
-
-    // convert mat to batch of images
-    cv::Mat inputBlob = cv::dnn::blobFromImage(matColor, _inScaleFactor, cv::Size((int)_inWidth, (int)_inHeight), _meanVal, false);
-    // set the network input
-    _net.setInput(inputBlob, "data");
-    // compute output
-    cv::Mat detection = _net.forward("detection_out");
-    cv::Mat detectionMat(detection.size[2], detection.size[3], CV_32F, detection.ptr<float>());
-    // crop the input frame
-    cv::Mat matColorRoi = matColor(_rectRoi);
-    matDepth = matDepth(_rectRoi);
-
-    float confidenceThreshold = 0.8f;
-    for (int i = 0; i < detectionMat.rows; i++)
-    {
-        float confidence = detectionMat.at<float>(i, 2);
-
-        if (confidence > confidenceThreshold)
-        {
-            size_t objectClass = (size_t)(detectionMat.at<float>(i, 1));
-
-            int xLeftBottom = static_cast<int>(detectionMat.at<float>(i, 3) * matColorRoi.cols);
-            int yLeftBottom = static_cast<int>(detectionMat.at<float>(i, 4) * matColorRoi.rows);
-            int xRightTop = static_cast<int>(detectionMat.at<float>(i, 5) * matColorRoi.cols);
-            int yRightTop = static_cast<int>(detectionMat.at<float>(i, 6) * matColorRoi.rows);
-
-            cv::Rect object((int)xLeftBottom, (int)yLeftBottom, (int)(xRightTop - xLeftBottom), (int)(yRightTop - yLeftBottom));
-            object = object & cv::Rect(0, 0, matDepth.cols, matDepth.rows);
-
-            // mean depth inside the detection region
-            int nzCount = cv::countNonZero(matDepth(object));
-            double meanDistance = (nzCount > 0) ? cv::sum(matDepth(object))[0] / nzCount : 0.0;
-            std::ostringstream ssout;
-            ssout << "<" << _classNames[objectClass] << "> : ";
-            if (meanDistance > 0.0)
-                ssout << std::setprecision(2) << meanDistance << " meters away";
-            else
-                ssout << "over range";
-
-            cv::rectangle(matColorRoi, object, cv::Scalar(0, 255, 0));
-            int baseLine = 0;
-            cv::Size labelSize = getTextSize(ssout.str(), cv::FONT_HERSHEY_COMPLEX, 0.6, 2, &baseLine);
-            cv::Point ptCenter = (object.br() + object.tl()) * 0.5;
-            ptCenter.x = ptCenter.x - labelSize.width / 2;
-            cv::rectangle(matColorRoi,
-                cv::Rect(cv::Point(ptCenter.x, ptCenter.y - labelSize.height), cv::Size(labelSize.width, labelSize.height + baseLine)),
-                cv::Scalar(128, 255, 128), CV_FILLED);
-            putText(matColorRoi, ssout.str(), ptCenter, cv::FONT_HERSHEY_COMPLEX, 0.6, cv::Scalar(0, 0, 0), 2);
-        }
-    }
-
-    cv::cvtColor(matColorRoi, matColorRoi, cv::COLOR_BGR2RGB);
-    // gray out the left of ROI
-    cv::Mat matColorRoiLeft = matColor(_rectRoiLeft);
-    cv::Mat matGrayLeft;
-    cv::cvtColor(matColorRoiLeft, matGrayLeft, cv::COLOR_RGB2GRAY);
-    cv::cvtColor(matGrayLeft, matColorRoiLeft, cv::COLOR_GRAY2RGB);
-    // gray out the roght of ROI
-    cv::Mat matColorRoiRight = matColor(_rectRoiRight);
-    cv::Mat matGrayRight;
-    cv::cvtColor(matColorRoiRight, matGrayRight, cv::COLOR_RGB2GRAY);
-    cv::cvtColor(matGrayRight, matColorRoiRight, cv::COLOR_GRAY2RGB);
+    // the serial number tells the cameras apart
+    if (_rig.cameraCount() == 1)
+        return _textmap[stream];
+    return _textmap[stream] + " " + _rig.pipeline(index).camera().serial;
 }
@@ -1,7 +1,7 @@
 #pragma once
 #include <string>
-#include <mutex>
 #include <unordered_map>
+#include <vector>
 #include <Poco/Logger.h>
 #include <Poco/Util/LayeredConfiguration.h>
 #include <Eigen/Core>
@@ -13,6 +13,8 @@
 #include <opencv2/opencv.hpp>
 #include <opencv2/dnn.hpp>
 #include "VideoWindow.h"
+#include "CameraRig.h"
+#include "StreamController.h"
 
 // text translation id for multilingual GUI text
 enum class TextId : uint8_t
@@ -31,21 +33,28 @@ using TextMap = std::unordered_map<TextId, std::string>;
 class MainWindow : public nanogui::Screen
 {
 public:
-    MainWindow(const Eigen::Vector2i & size, const std::string & caption);
+    // the cameras of rig, which loads its model already, are started and stopped through stream, which may be starting
+    MainWindow(const Eigen::Vector2i & size, const std::string & caption, CameraRig & rig, StreamController & stream);
     void onToggleColorStream(bool on);
     void onToggleDepthStream(bool on);
     void onToggleCvdnn(bool on);
     bool keyboardEvent(int key, int scancode, int action, int modifiers) override;
     bool resizeEvent(const Eigen::Vector2i & size) override;
     void draw(NVGcontext *ctx) override;
+    void drawAll() override;
 
 protected:
     void initTextMap();
-    bool tryStartVideo();
-    void stopVideo();
-    bool isVideoStarted();
-    bool isCvdnnStarted();
-    void detectObjects(rs2::video_frame color_frame, rs2::depth_frame depth_frame, float depth_scale);
+    // start or stop the cameras as the stream buttons want them, unless a transition is running
+    void syncStream();
+    // pick up the transitions finished since the last frame
+    void handleStreamEvents();
+    // open the windows of the streams whose button is pushed
+    void showVideoWindows();
+    // write the Chrome trace of the pipeline stages
+    void dumpTrace();
+    // title of a video window of camera index
+    std::string videoTitle(TextId stream, size_t index);
 
 private:
     Poco::Logger & _logger;
@@ -55,23 +64,13 @@ private:
     nanogui::Button *_btnColorStream;
     nanogui::Button *_btnDepthStream;
     nanogui::Button *_btnStartCvdnn;
-    VideoWindow *_colorWindow;
-    VideoWindow *_depthWindow;
+    // color and depth window of every camera, empty while the stream is not shown
+    std::vector<VideoWindow *> _colorWindows;
+    std::vector<VideoWindow *> _depthWindows;
     const float _colorRatio;
     const float _depthRatio;
-    std::mutex _mutex;
-    bool _isVideoStarted;
-    bool _isCvdnnStarted;
-    rs2::pipeline _pipe;
-    rs2::align _align;
-    float _depthScale;
-    const size_t _inWidth;
-    const size_t _inHeight;
-    const float _inScaleFactor;
-    const float _meanVal;
-    const std::array<std::string, 21> _classNames;
-    cv::dnn::Net _net;
-    cv::Rect _rectRoi;
-    cv::Rect _rectRoiLeft;
-    cv::Rect _rectRoiRight;
+    CameraRig & _rig;
+    StreamController & _stream;
+    // the cameras were starting when the window opened, the buttons follow once the start is done
+    bool _autoStarting;
 };
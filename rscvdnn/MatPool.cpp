@@ -0,0 +1,51 @@
+#include <string>
+#include <vector>
+#include <opencv2/core.hpp>
+#include "MatPool.h"
+
+using std::string;
+
+MatPool::MatPool(const string & name, const string & labels)
+    : _type{ CV_8UC1 }
+    , _next{ 0 }
+    , _grown(metrics().counter("rscvdnn_buffer_pool_grown_total", "Frame buffers allocated because every pooled one was in use",
+        "pool=\"" + name + "\"" + (labels.empty() ? "" : "," + labels)))
+{
+}
+
+void MatPool::reset(const cv::Size & size, int type, size_t count)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    _size = size;
+    _type = type;
+    _next = 0;
+    // buffers still held by frames of the earlier stream are freed with the last of those frames
+    _buffers.clear();
+    for (size_t i = 0; i < count; i++)
+        _buffers.push_back(cv::Mat(size, type));
+}
+
+cv::Mat MatPool::acquire()
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    for (size_t n = 0; n < _buffers.size(); n++)
+    {
+        size_t i = (_next + n) % _buffers.size();
+        // the count is only ever raised by whoever holds a reference, so a buffer seen free stays free
+        if (_buffers[i].u != nullptr && CV_XADD(&_buffers[i].u->refcount, 0) == 1)
+        {
+            _next = i + 1;
+            return _buffers[i];
+        }
+    }
+    _grown.add();
+    _buffers.push_back(cv::Mat(_size, _type));
+    _next = 0;
+    return _buffers.back();
+}
+
+size_t MatPool::size()
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _buffers.size();
+}
@@ -0,0 +1,34 @@
+#pragma once
+#include <mutex>
+#include <string>
+#include <vector>
+#include <opencv2/core.hpp>
+#include "Metrics.h"
+
+// Buffers of one size and type for frames on their way through the pipeline queues. A buffer is handed out again
+// once every Mat referring to it is gone, which the pool tells from the reference count of the buffer, so frames
+// dropped by a queue give their buffers back on their own. A pool sized at stream start for the frames that can be
+// in flight never allocates, it only grows if more are, counted in rscvdnn_buffer_pool_grown_total.
+class MatPool
+{
+public:
+    // name of the buffers, labels the metrics series together with labels if given
+    MatPool(const std::string & name, const std::string & labels);
+    MatPool(const MatPool &) = delete;
+    MatPool & operator=(const MatPool &) = delete;
+
+    // allocate count buffers of size and type, the buffers of an earlier size are dropped
+    void reset(const cv::Size & size, int type, size_t count);
+    // a buffer nobody else refers to, safe to call from any thread
+    cv::Mat acquire();
+    size_t size();
+
+private:
+    std::mutex _mutex;
+    std::vector<cv::Mat> _buffers;
+    cv::Size _size;
+    int _type;
+    // where the search for a free buffer starts, next to the one handed out last
+    size_t _next;
+    MetricCounter & _grown;
+};
@@ -0,0 +1,180 @@
+#include <algorithm>
+#include <cmath>
+#include <string>
+#include <iomanip>
+#include <stdexcept>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#include "Metrics.h"
+
+using std::string;
+using std::ostream;
+
+static void writeSeries(ostream & out, const string & name, const string & labels)
+{
+    out << name;
+    if (!labels.empty())
+        out << "{" << labels << "}";
+}
+
+void MetricCounter::render(ostream & out, const string & name, const string & labels) const
+{
+    writeSeries(out, name, labels);
+    out << " " << value() << "\n";
+}
+
+void MetricGauge::render(ostream & out, const string & name, const string & labels) const
+{
+    writeSeries(out, name, labels);
+    out << " " << value() << "\n";
+}
+
+LatencyHistogram::LatencyHistogram()
+{
+    for (std::atomic<uint64_t> & bucket : _buckets)
+        bucket.store(0, std::memory_order_relaxed);
+}
+
+int LatencyHistogram::bucketIndex(uint64_t us)
+{
+    // values below SubBuckets get a bucket each, above that the 5 leading bits select the bucket
+    if (us < SubBuckets)
+        return (int)us;
+#ifdef _MSC_VER
+    unsigned long msb;
+    _BitScanReverse64(&msb, us);
+#else
+    int msb = 63 - __builtin_clzll(us);
+#endif
+    int shift = (int)msb - 4;
+    int index = SubBuckets + shift * SubBuckets + (int)((us >> shift) & (SubBuckets - 1));
+    return (index < BucketCount) ? index : BucketCount - 1;
+}
+
+double LatencyHistogram::bucketValue(int index)
+{
+    if (index < SubBuckets)
+        return index + 0.5;
+    int shift = (index - SubBuckets) / SubBuckets;
+    int sub = (index - SubBuckets) % SubBuckets;
+    return std::ldexp(SubBuckets + sub + 0.5, shift);
+}
+
+void LatencyHistogram::record(double ms)
+{
+    uint64_t us = (ms > 0.0) ? (uint64_t)(ms * 1000.0 + 0.5) : 0;
+    _buckets[bucketIndex(us)].fetch_add(1, std::memory_order_relaxed);
+    _sumUs.fetch_add(us, std::memory_order_relaxed);
+    _count.fetch_add(1, std::memory_order_relaxed);
+}
+
+double LatencyHistogram::percentile(double q) const
+{
+    // buckets are read one by one while recording goes on, the total is taken from the same reads
+    uint64_t counts[BucketCount];
+    uint64_t total = 0;
+    for (int i = 0; i < BucketCount; i++)
+    {
+        counts[i] = _buckets[i].load(std::memory_order_relaxed);
+        total += counts[i];
+    }
+    if (total == 0)
+        return 0.0;
+
+    uint64_t rank = std::max<uint64_t>(1, (uint64_t)std::ceil(q * total));
+    uint64_t cumulative = 0;
+    for (int i = 0; i < BucketCount; i++)
+    {
+        cumulative += counts[i];
+        if (cumulative >= rank)
+            return bucketValue(i) / 1000.0;
+    }
+    return bucketValue(BucketCount - 1) / 1000.0;
+}
+
+void LatencyHistogram::render(ostream & out, const string & name, const string & labels) const
+{
+    static const double quantiles[] = { 0.5, 0.9, 0.99, 0.999 };
+    static const char *quantileLabels[] = { "0.5", "0.9", "0.99", "0.999" };
+    const string separator = labels.empty() ? "" : ",";
+    for (int i = 0; i < 4; i++)
+    {
+        writeSeries(out, name, labels + separator + "quantile=\"" + quantileLabels[i] + "\"");
+        out << " " << percentile(quantiles[i]) / 1000.0 << "\n";
+    }
+    writeSeries(out, name + "_sum", labels);
+    out << " " << _sumUs.load(std::memory_order_relaxed) / 1e6 << "\n";
+    writeSeries(out, name + "_count", labels);
+    out << " " << count() << "\n";
+}
+
+template <typename T>
+T & MetricsRegistry::series(const string & name, const string & help, const string & type, const string & labels)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    Family & family = _families[name];
+    if (family.type.empty())
+    {
+        family.help = help;
+        family.type = type;
+    }
+    else if (family.type != type)
+        throw std::logic_error("metric " + name + " registered as " + family.type + " and " + type);
+
+    std::unique_ptr<Metric> & metric = family.series[labels];
+    if (!metric)
+        metric.reset(new T);
+    return static_cast<T &>(*metric);
+}
+
+MetricCounter & MetricsRegistry::counter(const string & name, const string & help, const string & labels)
+{
+    return series<MetricCounter>(name, help, "counter", labels);
+}
+
+MetricGauge & MetricsRegistry::gauge(const string & name, const string & help, const string & labels)
+{
+    return series<MetricGauge>(name, help, "gauge", labels);
+}
+
+LatencyHistogram & MetricsRegistry::histogram(const string & name, const string & help, const string & labels)
+{
+    return series<LatencyHistogram>(name, help, "summary", labels);
+}
+
+int MetricsRegistry::addCollector(std::function<void()> collect)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    _collectors[_nextCollector] = std::move(collect);
+    return _nextCollector++;
+}
+
+void MetricsRegistry::removeCollector(int id)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    _collectors.erase(id);
+}
+
+void MetricsRegistry::render(ostream & out)
+{
+    // the lock only keeps series from being added meanwhile, the hot path never takes it
+    std::lock_guard<std::mutex> lock(_mutex);
+    for (auto & collector : _collectors)
+        collector.second();
+
+    out << std::setprecision(9);
+    for (const auto & family : _families)
+    {
+        out << "# HELP " << family.first << " " << family.second.help << "\n";
+        out << "# TYPE " << family.first << " " << family.second.type << "\n";
+        for (const auto & series : family.second.series)
+            series.second->render(out, family.first, series.first);
+    }
+}
+
+MetricsRegistry & metrics()
+{
+    static MetricsRegistry registry;
+    return registry;
+}
@@ -0,0 +1,105 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+
+// Process-wide metrics in the Prometheus text exposition format. Metrics are created once through the registry,
+// which hands out references that stay valid for the life of the process, and are then updated on the hot path
+// with relaxed atomics only.
+
+class Metric
+{
+public:
+    virtual ~Metric() {}
+    // write the samples of this series, labels are the series labels without braces
+    virtual void render(std::ostream & out, const std::string & name, const std::string & labels) const = 0;
+};
+
+class MetricCounter : public Metric
+{
+public:
+    void add(uint64_t n = 1) { _value.fetch_add(n, std::memory_order_relaxed); }
+    // for counters mirrored from a count kept elsewhere
+    void set(uint64_t value) { _value.store(value, std::memory_order_relaxed); }
+    uint64_t value() const { return _value.load(std::memory_order_relaxed); }
+    void render(std::ostream & out, const std::string & name, const std::string & labels) const override;
+
+private:
+    std::atomic<uint64_t> _value{ 0 };
+};
+
+class MetricGauge : public Metric
+{
+public:
+    void set(double value) { _value.store(value, std::memory_order_relaxed); }
+    double value() const { return _value.load(std::memory_order_relaxed); }
+    void render(std::ostream & out, const std::string & name, const std::string & labels) const override;
+
+private:
+    std::atomic<double> _value{ 0.0 };
+};
+
+// HDR style histogram of durations, log-linear buckets of 16 sub-buckets per power of two microseconds keep the
+// relative error of any percentile below 1/16 from 1 us up to hours, recording is one atomic increment.
+// Exposed as a summary in seconds with the 0.5, 0.9, 0.99 and 0.999 quantiles since start.
+class LatencyHistogram : public Metric
+{
+public:
+    static const int SubBuckets = 16;
+    static const int BucketCount = SubBuckets + 33 * SubBuckets;
+
+    LatencyHistogram();
+    void record(double ms);
+    uint64_t count() const { return _count.load(std::memory_order_relaxed); }
+    // value in milliseconds below which the fraction q of the recorded durations falls, 0 if empty
+    double percentile(double q) const;
+    void render(std::ostream & out, const std::string & name, const std::string & labels) const override;
+
+private:
+    static int bucketIndex(uint64_t us);
+    // the middle of a bucket in microseconds
+    static double bucketValue(int index);
+
+    std::atomic<uint64_t> _buckets[BucketCount];
+    std::atomic<uint64_t> _count{ 0 };
+    std::atomic<uint64_t> _sumUs{ 0 };
+};
+
+class MetricsRegistry
+{
+public:
+    // the series of name with the given labels, e.g. stage="align", created on first use
+    MetricCounter & counter(const std::string & name, const std::string & help, const std::string & labels = "");
+    MetricGauge & gauge(const std::string & name, const std::string & help, const std::string & labels = "");
+    LatencyHistogram & histogram(const std::string & name, const std::string & help, const std::string & labels = "");
+
+    // collectors run before every render, to refresh metrics mirrored from elsewhere, they run under the registry
+    // lock and must not create metrics, a removed collector is guaranteed not to be running
+    int addCollector(std::function<void()> collect);
+    void removeCollector(int id);
+    void render(std::ostream & out);
+
+private:
+    struct Family
+    {
+        std::string help;
+        std::string type;
+        std::map<std::string, std::unique_ptr<Metric>> series;
+    };
+
+    template <typename T>
+    T & series(const std::string & name, const std::string & help, const std::string & type, const std::string & labels);
+
+    std::mutex _mutex;
+    std::map<std::string, Family> _families;
+    std::map<int, std::function<void()>> _collectors;
+    int _nextCollector{ 0 };
+};
+
+// the registry of the process
+MetricsRegistry & metrics();
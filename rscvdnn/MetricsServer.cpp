@@ -0,0 +1,109 @@
+#include <string>
+#include <Poco/Logger.h>
+#include <Poco/Net/HTTPRequestHandler.h>
+#include <Poco/Net/HTTPRequestHandlerFactory.h>
+#include <Poco/Net/HTTPServerParams.h>
+#include <Poco/Net/HTTPServerRequest.h>
+#include <Poco/Net/HTTPServerResponse.h>
+#include <Poco/Net/ServerSocket.h>
+#include <Poco/Net/SocketAddress.h>
+#include <Poco/Util/AbstractConfiguration.h>
+#include "MetricsServer.h"
+
+using std::string;
+using Poco::Logger;
+using Poco::Net::HTTPRequest;
+using Poco::Net::HTTPRequestHandler;
+using Poco::Net::HTTPRequestHandlerFactory;
+using Poco::Net::HTTPResponse;
+using Poco::Net::HTTPServer;
+using Poco::Net::HTTPServerParams;
+using Poco::Net::HTTPServerRequest;
+using Poco::Net::HTTPServerResponse;
+using Poco::Net::ServerSocket;
+using Poco::Net::SocketAddress;
+using Poco::Util::AbstractConfiguration;
+
+class MetricsRequestHandler : public HTTPRequestHandler
+{
+public:
+    MetricsRequestHandler(MetricsRegistry & registry) : _registry(registry) {}
+
+    void handleRequest(HTTPServerRequest & request, HTTPServerResponse & response) override
+    {
+        if (request.getMethod() != HTTPRequest::HTTP_GET || request.getURI() != "/metrics")
+        {
+            response.setStatusAndReason(HTTPResponse::HTTP_NOT_FOUND);
+            response.setContentLength(0);
+            response.send();
+            return;
+        }
+        response.setContentType("text/plain; version=0.0.4");
+        response.setChunkedTransferEncoding(true);
+        _registry.render(response.send());
+    }
+
+private:
+    MetricsRegistry & _registry;
+};
+
+class MetricsRequestHandlerFactory : public HTTPRequestHandlerFactory
+{
+public:
+    MetricsRequestHandlerFactory(MetricsRegistry & registry) : _registry(registry) {}
+
+    HTTPRequestHandler * createRequestHandler(const HTTPServerRequest & request) override
+    {
+        return new MetricsRequestHandler(_registry);
+    }
+
+private:
+    MetricsRegistry & _registry;
+};
+
+MetricsServer::MetricsServer(const AbstractConfiguration & config, MetricsRegistry & registry)
+    : _logger{ Logger::get("MetricsServer") }
+    , _registry(registry)
+    , _address{ config.getString("address", "127.0.0.1") }
+    , _port{ (unsigned short)config.getUInt("port", 9464) }
+{
+}
+
+MetricsServer::~MetricsServer()
+{
+    stop();
+}
+
+void MetricsServer::start()
+{
+    if (_server)
+        return;
+
+    HTTPServerParams *params = new HTTPServerParams;
+    // scrapes are rare and short, a couple of threads is plenty
+    params->setMaxThreads(2);
+    params->setMaxQueued(16);
+    params->setKeepAlive(false);
+    _server.reset(new HTTPServer(new MetricsRequestHandlerFactory(_registry), ServerSocket(SocketAddress(_address, _port)), params));
+    _server->start();
+    poco_information(_logger, "serving metrics on " + url());
+}
+
+void MetricsServer::stop()
+{
+    if (!_server)
+        return;
+
+    _server->stopAll(true);
+    _server.reset();
+}
+
+unsigned short MetricsServer::port() const
+{
+    return _server ? _server->port() : 0;
+}
+
+string MetricsServer::url() const
+{
+    return "http://" + _address + ":" + std::to_string(port()) + "/metrics";
+}
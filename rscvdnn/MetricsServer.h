@@ -0,0 +1,30 @@
+#pragma once
+#include <memory>
+#include <string>
+#include <Poco/Logger.h>
+#include <Poco/Net/HTTPServer.h>
+#include <Poco/Util/AbstractConfiguration.h>
+#include "Metrics.h"
+
+// Serves a metrics registry for Prometheus scraping, GET /metrics answers with the text exposition format,
+// other paths with 404. Requests are handled on a small thread pool of the HTTP server and only read the metrics.
+class MetricsServer
+{
+public:
+    // config is the metrics section: address and port to listen on, port 0 takes any free port
+    MetricsServer(const Poco::Util::AbstractConfiguration & config, MetricsRegistry & registry);
+    ~MetricsServer();
+    void start();
+    void stop();
+    bool isRunning() const { return (bool)_server; }
+    // the port actually bound, only valid while running
+    unsigned short port() const;
+    std::string url() const;
+
+private:
+    Poco::Logger & _logger;
+    MetricsRegistry & _registry;
+    std::string _address;
+    unsigned short _port;
+    std::unique_ptr<Poco::Net::HTTPServer> _server;
+};
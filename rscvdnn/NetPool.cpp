@@ -0,0 +1,161 @@
+#include <string>
+#include <vector>
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+#include <opencv2/dnn.hpp>
+#include "NetPool.h"
+
+using std::string;
+using std::vector;
+
+static vector<char> readFile(const string & path)
+{
+    std::ifstream file(path, std::ios::binary);
+    if (!file)
+        throw std::runtime_error("cannot read " + path);
+    return vector<char>(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+}
+
+NetPool::NetPool(const string & prototxt, const string & caffemodel, int workers)
+    : _next{ 0 }
+    , _pending{ 0 }
+    , _stopping{ false }
+{
+    CV_Assert(workers > 0);
+    const vector<char> proto = readFile(prototxt);
+    const vector<char> model = readFile(caffemodel);
+
+    for (int i = 0; i < workers; i++)
+    {
+        std::unique_ptr<Worker> worker(new Worker);
+        worker->net = cv::dnn::readNetFromCaffe(proto.data(), proto.size(), model.data(), model.size());
+        // instantiate the layers now, while the custom ones are registered and not on the first job
+        for (const cv::String & name : worker->net.getLayerNames())
+            worker->net.getLayer(worker->net.getLayerId(name));
+        _workers.push_back(std::move(worker));
+    }
+
+    for (int i = 0; i < workers; i++)
+        _workers[i]->thread = std::thread(&NetPool::run, this, i);
+}
+
+void NetPool::warmUp(const cv::Size & inputSize)
+{
+    int sizes[] = { 1, 3, inputSize.height, inputSize.width };
+    const cv::Mat blob(4, sizes, CV_32F, cv::Scalar(0));
+    // the workers only touch their nets for jobs, and there are none yet
+    vector<std::thread> threads;
+    for (std::unique_ptr<Worker> & worker : _workers)
+    {
+        cv::dnn::Net & net = worker->net;
+        threads.emplace_back([&net, &blob]()
+        {
+            net.setInput(blob);
+            net.forward();
+        });
+    }
+    for (std::thread & thread : threads)
+        thread.join();
+}
+
+NetPool::~NetPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(_wakeMutex);
+        _stopping = true;
+    }
+    _wake.notify_all();
+    // workers finish the queued jobs before they exit
+    for (std::unique_ptr<Worker> & worker : _workers)
+        worker->thread.join();
+}
+
+void NetPool::push(Task & task)
+{
+    {
+        std::lock_guard<std::mutex> lock(_wakeMutex);
+        _pending++;
+    }
+    Worker & worker = *_workers[_next++ % _workers.size()];
+    {
+        std::lock_guard<std::mutex> lock(worker.mutex);
+        worker.tasks.push_back(&task);
+    }
+    _wake.notify_one();
+}
+
+bool NetPool::pop(int index, Task *& task)
+{
+    // the owner takes its jobs in submission order
+    Worker & worker = *_workers[index];
+    std::lock_guard<std::mutex> lock(worker.mutex);
+    if (worker.tasks.empty())
+        return false;
+    task = worker.tasks.front();
+    worker.tasks.pop_front();
+    return true;
+}
+
+bool NetPool::steal(int index, Task *& task)
+{
+    // thieves take from the back, away from the owner, starting at the next worker so victims are spread
+    for (size_t k = 1; k < _workers.size(); k++)
+    {
+        Worker & victim = *_workers[(index + k) % _workers.size()];
+        std::lock_guard<std::mutex> lock(victim.mutex);
+        if (victim.tasks.empty())
+            continue;
+        task = victim.tasks.back();
+        victim.tasks.pop_back();
+        return true;
+    }
+    return false;
+}
+
+void NetPool::run(int index)
+{
+    Worker & worker = *_workers[index];
+    while (true)
+    {
+        Task *task = nullptr;
+        bool stolen = false;
+        if (pop(index, task) || (stolen = steal(index, task)))
+        {
+            {
+                std::lock_guard<std::mutex> lock(_wakeMutex);
+                _pending--;
+            }
+            // the task may be gone once it ran
+            task->run(*task, worker.net);
+            worker.executed++;
+            if (stolen)
+                worker.stolen++;
+            continue;
+        }
+
+        // a job counted in _pending but not in any queue yet is about to be pushed, waiting returns right away
+        std::unique_lock<std::mutex> lock(_wakeMutex);
+        _wake.wait(lock, [this] { return _stopping || _pending > 0; });
+        if (_stopping && _pending == 0)
+            return;
+    }
+}
+
+void NetPool::finish(WaitingTask & task)
+{
+    {
+        std::lock_guard<std::mutex> lock(_doneMutex);
+        task.done = true;
+    }
+    _done.notify_all();
+}
+
+void NetPool::wait(WaitingTask & task)
+{
+    std::unique_lock<std::mutex> lock(_doneMutex);
+    _done.wait(lock, [&task] { return task.done; });
+    lock.unlock();
+    if (task.error)
+        std::rethrow_exception(task.error);
+}
@@ -0,0 +1,142 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <condition_variable>
+#include <exception>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <opencv2/dnn.hpp>
+#include "RingBuffer.h"
+
+// Pool of worker threads, each with its own instance of the same network, for concurrent inference.
+// cv::dnn::Net is not safe for concurrent forward calls, so every worker owns a net and with it the activation
+// buffers. The model files are read once, and the weights of the custom layers are shared by all instances.
+// Jobs are queued to the workers round robin, a worker out of jobs steals the most recently queued ones of another.
+// The queues only hold pointers to the jobs, a job run by execute lives on the stack of its caller.
+class NetPool
+{
+public:
+    // load one net per worker, the custom layers to use must be registered during construction
+    NetPool(const std::string & prototxt, const std::string & caffemodel, int workers);
+    ~NetPool();
+    NetPool(const NetPool &) = delete;
+    NetPool & operator=(const NetPool &) = delete;
+
+    // run job on the net of whichever worker gets to it first, the future carries its result or exception
+    template <typename Job>
+    std::future<typename std::result_of<Job(cv::dnn::Net &)>::type> submit(Job && job)
+    {
+        using Result = typename std::result_of<Job(cv::dnn::Net &)>::type;
+        SubmittedTask<Result> *task = new SubmittedTask<Result>(std::forward<Job>(job));
+        std::future<Result> result = task->task.get_future();
+        push(*task);
+        return result;
+    }
+
+    // run job on the net of whichever worker gets to it first and wait for it, an exception of job is rethrown,
+    // unlike submit it allocates nothing, for callers waiting for the job anyway
+    template <typename Job>
+    void execute(Job & job)
+    {
+        ExecutedTask<Job> task(this, job);
+        push(task);
+        wait(task);
+    }
+
+    // run one forward of a blank input of size on every net at once, so the buffer allocations and kernel choices of
+    // the first forward are not made on the first frames, only before any job is submitted
+    void warmUp(const cv::Size & inputSize);
+
+    int workers() const { return (int)_workers.size(); }
+    // jobs a worker ran, and how many of them it took from the queue of another worker
+    uint64_t executed(int worker) const { return _workers[worker]->executed; }
+    uint64_t stolen(int worker) const { return _workers[worker]->stolen; }
+
+private:
+    // a job in the queue of a worker, run calls it with the net of the worker that took it
+    struct Task
+    {
+        explicit Task(void (*call)(Task & task, cv::dnn::Net & net)) : run{ call } {}
+        void (*run)(Task & task, cv::dnn::Net & net);
+    };
+
+    // the task of submit, deleted once it ran
+    template <typename Result>
+    struct SubmittedTask : Task
+    {
+        template <typename Job>
+        explicit SubmittedTask(Job && job) : Task(&SubmittedTask::call), task(std::forward<Job>(job)) {}
+
+        static void call(Task & base, cv::dnn::Net & net)
+        {
+            std::unique_ptr<SubmittedTask> self(static_cast<SubmittedTask *>(&base));
+            self->task(net);
+        }
+
+        std::packaged_task<Result(cv::dnn::Net &)> task;
+    };
+
+    // the task of execute, done is guarded by _doneMutex, its caller may be gone right after it is set
+    struct WaitingTask : Task
+    {
+        WaitingTask(void (*call)(Task & task, cv::dnn::Net & net), NetPool * pool) : Task(call), pool{ pool }, done{ false } {}
+
+        NetPool *pool;
+        bool done;
+        std::exception_ptr error;
+    };
+
+    template <typename Job>
+    struct ExecutedTask : WaitingTask
+    {
+        ExecutedTask(NetPool * pool, Job & job) : WaitingTask(&ExecutedTask::call, pool), job(job) {}
+
+        static void call(Task & base, cv::dnn::Net & net)
+        {
+            ExecutedTask & self = static_cast<ExecutedTask &>(base);
+            try
+            {
+                self.job(net);
+            }
+            catch (...)
+            {
+                self.error = std::current_exception();
+            }
+            self.pool->finish(self);
+        }
+
+        Job & job;
+    };
+
+    struct Worker
+    {
+        std::mutex mutex;
+        RingBuffer<Task *> tasks{ 16 };
+        cv::dnn::Net net;
+        std::thread thread;
+        std::atomic<uint64_t> executed{ 0 };
+        std::atomic<uint64_t> stolen{ 0 };
+    };
+
+    void push(Task & task);
+    bool pop(int index, Task *& task);
+    bool steal(int index, Task *& task);
+    void run(int index);
+    void finish(WaitingTask & task);
+    void wait(WaitingTask & task);
+
+    std::vector<std::unique_ptr<Worker>> _workers;
+    std::atomic<unsigned> _next;
+    // tasks queued and not yet taken by a worker, guarded by _wakeMutex for the sleeping workers
+    int _pending;
+    bool _stopping;
+    std::mutex _wakeMutex;
+    std::condition_variable _wake;
+    // signals every task of execute that is done
+    std::mutex _doneMutex;
+    std::condition_variable _done;
+};
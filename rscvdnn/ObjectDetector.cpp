@@ -0,0 +1,247 @@
+#include <string>
+#include <vector>
+#include <cmath>
+#include <algorithm>
+#include <Poco/Util/AbstractConfiguration.h>
+#include <opencv2/opencv.hpp>
+#include <opencv2/dnn.hpp>
+#include "ObjectDetector.h"
+#include "StageTrace.h"
+
+using std::string;
+using std::vector;
+using Poco::Util::AbstractConfiguration;
+
+ObjectDetector::ObjectDetector(const AbstractConfiguration & config)
+    : _inWidth{ InputSide }
+    , _inHeight{ InputSide }
+    , _inScaleFactor{ 0.007843f }
+    , _meanVal{ 127.5f }
+    , _confidenceThreshold{ static_cast<float>(config.getDouble("confidenceThreshold", 0.8)) }
+    , _nmsThreshold{ static_cast<float>(config.getDouble("nmsThreshold", 0.45)) }
+    , _classNames{ "background", "aeroplane", "bicycle", "bird", "boat", "bottle", "bus", "car", "cat", "chair",
+                   "cow", "diningtable", "dog", "horse", "motorbike", "person", "pottedplant", "sheep", "sofa", "train", "tvmonitor" }
+    , _pool{ nullptr }
+    , _input(_inScaleFactor, _meanVal)
+    , _coarseInput(_inScaleFactor, _meanVal)
+    , _imageRegion(1)
+    , _cascadeEnabled{ config.getBool("cascade.enabled", false) }
+    , _coarseSize{ config.getInt("cascade.inputSize", 160), config.getInt("cascade.inputSize", 160) }
+    , _candidateThreshold{ static_cast<float>(config.getDouble("cascade.candidateThreshold", 0.3)) }
+    , _cascadeZoom{ config.getBool("cascade.zoom", false) }
+    , _verifyInterval{ config.getInt("cascade.verifyInterval", 0) }
+    , _cascadeStats{}
+{
+}
+
+void ObjectDetector::loadModel(const string & prototxt, const string & caffemodel)
+{
+    if (_pool == nullptr)
+        _net = cv::dnn::readNetFromCaffe(prototxt, caffemodel);
+    if (_cascadeEnabled)
+        _netCoarse = cv::dnn::readNetFromCaffe(prototxt, caffemodel);
+}
+
+const Detections & ObjectDetector::detect(const cv::Mat & image)
+{
+    if (!_cascadeEnabled)
+    {
+        forward(_net, image, inputSize(), _confidenceThreshold, _input, _objects);
+        return _objects;
+    }
+
+    int64 tickStart = cv::getTickCount();
+    detectCascade(image, _objects);
+    _cascadeStats.cascadeMs += (cv::getTickCount() - tickStart) * 1000.0 / cv::getTickFrequency();
+    _cascadeStats.frames++;
+
+    if (_verifyInterval > 0 && _cascadeStats.frames % _verifyInterval == 0)
+        verifyCascade(image, _objects);
+    return _objects;
+}
+
+const Detections & ObjectDetector::detect(const cv::Mat & image, const vector<cv::Rect> & regions)
+{
+    _objects.clear();
+    if (regions.empty())
+        return _objects;
+
+    // scale the crops as the whole image would be scaled, so objects keep the size the network is used to,
+    // the input side is rounded up to the network stride to limit the number of distinct input shapes
+    int inSide = static_cast<int>(std::ceil(regions.front().width * (double)_inWidth / image.cols / 32.0)) * 32;
+    inSide = std::min(inSide, (int)_inWidth);
+
+    int64_t stageStart = traceNow();
+    _crops.clear();
+    for (const cv::Rect & region : regions)
+        _crops.push_back(image(region));
+    const cv::Mat & inputBlob = _input.set(_crops.data(), _crops.size(), cv::Size(inSide, inSide));
+    int64_t stageEnd = traceNow();
+    traceStage("blob", stageStart, stageEnd);
+    cv::Mat detection = runNet(_net, inputBlob);
+    stageStart = stageEnd;
+    stageEnd = traceNow();
+    traceStage("forward", stageStart, stageEnd);
+
+    TraceScope scope("decode");
+    parseDetections(detection, regions, _confidenceThreshold, _objects);
+    if (regions.size() == 1)
+        return _objects;
+
+    // objects on the overlap of adjacent regions are found more than once
+    Detections kept;
+    for (int classId = 1; classId < (int)_classNames.size(); classId++)
+    {
+        vector<cv::Rect> boxes;
+        vector<float> scores;
+        vector<size_t> index;
+        for (size_t i = 0; i < _objects.size(); i++)
+        {
+            if (_objects[i].classId != classId)
+                continue;
+            boxes.push_back(_objects[i].box);
+            scores.push_back(_objects[i].confidence);
+            index.push_back(i);
+        }
+        if (boxes.empty())
+            continue;
+
+        vector<int> indices;
+        cv::dnn::NMSBoxes(boxes, scores, _confidenceThreshold, _nmsThreshold, indices);
+        for (int k : indices)
+            kept.push_back(_objects[index[k]]);
+    }
+    _objects.swap(kept);
+    return _objects;
+}
+
+void ObjectDetector::forward(cv::dnn::Net & net, const cv::Mat & image, const cv::Size & inSize, float threshold, InputBlob & input,
+    Detections & objects)
+{
+    int64_t stageStart = traceNow();
+    // convert mat to batch of images
+    const cv::Mat & inputBlob = input.set(&image, 1, inSize);
+    int64_t stageEnd = traceNow();
+    traceStage("blob", stageStart, stageEnd);
+    // compute output
+    cv::Mat detection = runNet(net, inputBlob);
+    stageStart = stageEnd;
+    stageEnd = traceNow();
+    traceStage("forward", stageStart, stageEnd);
+
+    objects.clear();
+    _imageRegion[0] = cv::Rect(0, 0, image.cols, image.rows);
+    parseDetections(detection, _imageRegion, threshold, objects);
+    traceStage("decode", stageEnd, traceNow());
+}
+
+cv::Mat ObjectDetector::runNet(cv::dnn::Net & net, const cv::Mat & inputBlob)
+{
+    if (_pool == nullptr || &net != &_net)
+    {
+        net.setInput(inputBlob, "data");
+        cv::Mat detection = net.forward("detection_out");
+        // the rows stay in the output blob of net until its next forward
+        return cv::Mat(detection.size[2], detection.size[3], CV_32F, detection.ptr<float>());
+    }
+
+    // the output blob belongs to the pooled instance, which goes on with the job of another detector, the rows are
+    // copied to a buffer of this detector that only grows
+    cv::Mat rows;
+    auto job = [this, &inputBlob, &rows](cv::dnn::Net & pooled)
+    {
+        pooled.setInput(inputBlob, "data");
+        cv::Mat detection = pooled.forward("detection_out");
+        int count = detection.size[2];
+        if (_detectionRows.rows < count)
+            _detectionRows.create(count, detection.size[3], CV_32F);
+        rows = _detectionRows.rowRange(0, count);
+        cv::Mat(count, detection.size[3], CV_32F, detection.ptr<float>()).copyTo(rows);
+    };
+    _pool->execute(job);
+    return rows;
+}
+
+void ObjectDetector::detectCascade(const cv::Mat & image, Detections & objects)
+{
+    // the coarse pass only tells whether anything is worth a closer look
+    forward(_netCoarse, image, _coarseSize, _candidateThreshold, _coarseInput, _candidates);
+    if (_candidates.empty())
+    {
+        _cascadeStats.rejected++;
+        objects.clear();
+        return;
+    }
+
+    if (_cascadeZoom)
+    {
+        // zoom in on the square enclosing all candidates with some margin, if it is notably smaller than the image
+        cv::Rect area = _candidates.front().box;
+        for (const Detection & candidate : _candidates)
+            area |= candidate.box;
+        int side = std::min(std::min(image.cols, image.rows), cvRound(std::max(area.width, area.height) * 1.25));
+        if (side * 2 < image.cols)
+        {
+            cv::Point center = (area.tl() + area.br()) * 0.5;
+            int x = std::min(std::max(0, center.x - side / 2), image.cols - side);
+            int y = std::min(std::max(0, center.y - side / 2), image.rows - side);
+            cv::Rect zoom(x, y, side, side);
+            forward(_net, image(zoom), inputSize(), _confidenceThreshold, _input, objects);
+            for (Detection & object : objects)
+                object.box += zoom.tl();
+            return;
+        }
+    }
+
+    forward(_net, image, inputSize(), _confidenceThreshold, _input, objects);
+}
+
+void ObjectDetector::verifyCascade(const cv::Mat & image, const Detections & objects)
+{
+    int64 tickStart = cv::getTickCount();
+    Detections reference;
+    forward(_net, image, inputSize(), _confidenceThreshold, _input, reference);
+    _cascadeStats.singleStageMs += (cv::getTickCount() - tickStart) * 1000.0 / cv::getTickFrequency();
+    _cascadeStats.verifiedFrames++;
+
+    // an object counts as recalled if the cascade found the same class overlapping it by IoU 0.5 or more
+    for (const Detection & expected : reference)
+    {
+        _cascadeStats.referenceObjects++;
+        for (const Detection & object : objects)
+        {
+            double intersection = (expected.box & object.box).area();
+            double iou = intersection / (expected.box.area() + object.box.area() - intersection);
+            if (object.classId == expected.classId && iou >= 0.5)
+            {
+                _cascadeStats.recalledObjects++;
+                break;
+            }
+        }
+    }
+}
+
+void ObjectDetector::parseDetections(const cv::Mat & rows, const vector<cv::Rect> & regions, float threshold, Detections & objects) const
+{
+    // each row is [image_id, label, confidence, xmin, ymin, xmax, ymax], coordinates are normalized to the input image
+    for (int i = 0; i < rows.rows; i++)
+    {
+        const float *row = rows.ptr<float>(i);
+        int imageId = static_cast<int>(row[0]);
+        int objectClass = static_cast<int>(row[1]);
+        float confidence = row[2];
+        if (confidence <= threshold || imageId < 0 || imageId >= (int)regions.size()
+            || objectClass < 0 || objectClass >= (int)_classNames.size())
+            continue;
+
+        const cv::Rect & region = regions[imageId];
+        int xLeftBottom = static_cast<int>(row[3] * region.width);
+        int yLeftBottom = static_cast<int>(row[4] * region.height);
+        int xRightTop = static_cast<int>(row[5] * region.width);
+        int yRightTop = static_cast<int>(row[6] * region.height);
+
+        cv::Rect object(xLeftBottom, yLeftBottom, xRightTop - xLeftBottom, yRightTop - yLeftBottom);
+        object = object & cv::Rect(0, 0, region.width, region.height);
+        objects.push_back({ objectClass, confidence, object + region.tl() });
+    }
+}
@@ -0,0 +1,84 @@
+#pragma once
+#include <array>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <Poco/Util/AbstractConfiguration.h>
+#include <opencv2/opencv.hpp>
+#include <opencv2/dnn.hpp>
+#include "Detection.h"
+#include "NetPool.h"
+#include "FrameStages.h"
+
+// running statistics of the coarse-to-fine cascade, the single-stage path is only run on verification frames
+struct CascadeStats
+{
+    uint64_t frames;
+    // frames the coarse pass found nothing on, the full pass was skipped
+    uint64_t rejected;
+    uint64_t verifiedFrames;
+    uint64_t referenceObjects;
+    uint64_t recalledObjects;
+    double cascadeMs;
+    double singleStageMs;
+};
+
+// MobileNet-SSD object detector wrapping the OpenCV DNN network
+class ObjectDetector
+{
+public:
+    // edge length of the square network input
+    static const int InputSide = 300;
+
+    ObjectDetector(const Poco::Util::AbstractConfiguration & config);
+    // run the full network on the instances of pool, shared with other detectors, instead of a network of
+    // its own, must be set before loading the model and outlive the detector
+    void useNetPool(NetPool * pool) { _pool = pool; }
+    void loadModel(const std::string & prototxt, const std::string & caffemodel);
+    // detect objects in the whole image, the detections are valid until the next detect
+    const Detections & detect(const cv::Mat & image);
+    // detect objects only inside the square regions of image, all of the same size, as one batch,
+    // the regions keep the scale the whole image would have at network input size
+    const Detections & detect(const cv::Mat & image, const std::vector<cv::Rect> & regions);
+
+    cv::Size inputSize() const { return cv::Size((int)_inWidth, (int)_inHeight); }
+    const std::string & className(int classId) const { return _classNames[classId]; }
+    bool cascadeEnabled() const { return _cascadeEnabled; }
+    const CascadeStats & cascadeStats() const { return _cascadeStats; }
+    // append the objects of the rows of a detection_out blob, one detection of 7 floats per row, above threshold,
+    // in frame coordinates of the region every batch image was cut from
+    void parseDetections(const cv::Mat & rows, const std::vector<cv::Rect> & regions, float threshold, Detections & objects) const;
+
+private:
+    void forward(cv::dnn::Net & net, const cv::Mat & image, const cv::Size & inSize, float threshold, InputBlob & input, Detections & objects);
+    // the rows of the detection_out blob of net for inputBlob, valid until the next run
+    cv::Mat runNet(cv::dnn::Net & net, const cv::Mat & inputBlob);
+    void detectCascade(const cv::Mat & image, Detections & objects);
+    void verifyCascade(const cv::Mat & image, const Detections & objects);
+
+    const size_t _inWidth;
+    const size_t _inHeight;
+    const float _inScaleFactor;
+    const float _meanVal;
+    const float _confidenceThreshold;
+    const float _nmsThreshold;
+    const std::array<std::string, 21> _classNames;
+    cv::dnn::Net _net;
+    NetPool *_pool;
+    // buffers reused from one frame to the next
+    std::vector<cv::Mat> _crops;
+    InputBlob _input;
+    InputBlob _coarseInput;
+    cv::Mat _detectionRows;
+    std::vector<cv::Rect> _imageRegion;
+    Detections _objects;
+    Detections _candidates;
+    // coarse-to-fine cascade, the coarse pass has its own network so the input shapes never change
+    const bool _cascadeEnabled;
+    const cv::Size _coarseSize;
+    const float _candidateThreshold;
+    const bool _cascadeZoom;
+    const int _verifyInterval;
+    cv::dnn::Net _netCoarse;
+    CascadeStats _cascadeStats;
+};
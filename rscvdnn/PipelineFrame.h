@@ -0,0 +1,65 @@
+#pragma once
+#include <cstdint>
+#include <utility>
+#include <vector>
+#include <librealsense2/rs.hpp>
+#include <opencv2/core.hpp>
+#include "Detection.h"
+
+// a frame on its way from a FrameSource through the pipeline stages
+struct PipelineFrame
+{
+    PipelineFrame() = default;
+    PipelineFrame(const PipelineFrame &) = default;
+    PipelineFrame(PipelineFrame &&) = default;
+    PipelineFrame & operator=(const PipelineFrame &) = default;
+    // the frames a stage works on and the queue slots are reused from one frame to the next, moving one frame into
+    // another takes over its mats and copies the detections and distances into the vectors the target already has,
+    // so none of them allocates once it held the most objects a frame has
+    PipelineFrame & operator=(PipelineFrame && other)
+    {
+        if (this == &other)
+            return *this;
+        sequence = other.sequence;
+        frameNumber = other.frameNumber;
+        sensorTimestamp = other.sensorTimestamp;
+        detect = other.detect;
+        bgr = other.bgr;
+        frames = std::move(other.frames);
+        color = std::move(other.color);
+        depth = std::move(other.depth);
+        depthView = std::move(other.depthView);
+        matColor = std::move(other.matColor);
+        matDepth = std::move(other.matDepth);
+        matDepthRaw = std::move(other.matDepthRaw);
+        detections = other.detections;
+        distances = other.distances;
+        other.detections.clear();
+        other.distances.clear();
+        return *this;
+    }
+
+    // position of the frame in its source, starting at 0
+    uint64_t sequence = 0;
+    // frame number and timestamp in milliseconds the source gives the color frame, the hardware ones of a camera
+    uint64_t frameNumber = 0;
+    double sensorTimestamp = 0.0;
+    // detection was switched on when the frame was captured
+    bool detect = false;
+    // channel order of color, BGR if the source delivers it so and from preprocess on, RGB otherwise
+    bool bgr = false;
+    // RealSense frames the color and depth mats point into, empty for other sources
+    rs2::frameset frames;
+    // color and Z16 depth registered to each other, depth is empty if the source has none
+    cv::Mat color;
+    cv::Mat depth;
+    // colorized depth for display, only if the depth view is on
+    cv::Mat depthView;
+    // BGR view on the color frame data, and the ROI of depth in meters and raw Z16
+    cv::Mat matColor;
+    cv::Mat matDepth;
+    cv::Mat matDepthRaw;
+    Detections detections;
+    // mean distance in meters of every detection, 0 if out of range
+    std::vector<float> distances;
+};
@@ -0,0 +1,115 @@
+#include <cstdint>
+#include <vector>
+#include <algorithm>
+#include <opencv2/core.hpp>
+#include <opencv2/dnn.hpp>
+#include <opencv2/dnn/all_layers.hpp>
+#include "PointwiseConvLayer.h"
+#include "CustomLayers.h"
+#include "ConvKernels.h"
+
+using std::vector;
+using cv::dnn::LayerParams;
+using cv::dnn::MatShape;
+
+// output channels and pixels of one parallel task, the weights of a channel group stay in L2
+// while the pixel stripe is swept
+static const int ChannelGroup = 64;
+static const int PixelStripe = 240;
+
+PointwiseConvLayer::PointwiseConvLayer(const LayerParams & params)
+    : _outChannels{ params.blobs[0].size[0] }
+    , _inChannels{ params.blobs[0].size[1] }
+    , _relu{ false }
+{
+    setParamsFrom(params);
+
+    _packedWeights = sharedWeights(params, [&]()
+    {
+        cv::Mat packed(1, (int)packedPointwiseSize(_outChannels, _inChannels), CV_32F);
+        packPointwiseWeights(params.blobs[0].ptr<float>(), _outChannels, _inChannels, packed.ptr<float>());
+        if (customLayerSettings().fp16Weights && cpuHasF16c())
+        {
+            cv::Mat half;
+            cv::convertFp16(packed, half);
+            return half;
+        }
+        return packed;
+    });
+    // the layer holds the weights it computes with, the net keeps the parameters it was created from as they are
+    blobs[0] = _packedWeights;
+    if (params.get<bool>("bias_term", true) && params.blobs.size() > 1)
+        _bias = cv::Mat(1, _outChannels, CV_32F, (void*)params.blobs[1].ptr<float>()).clone();
+    else
+        _bias = cv::Mat::zeros(1, _outChannels, CV_32F);
+}
+
+bool PointwiseConvLayer::accepts(const LayerParams & params)
+{
+    if (params.blobs.empty() || params.blobs[0].dims != 4 || params.blobs[0].type() != CV_32F)
+        return false;
+
+    const cv::Mat & weights = params.blobs[0];
+    return params.get<int>("group", 1) == 1 && weights.size[2] == 1 && weights.size[3] == 1
+        && squareConvParam(params, "kernel", "kernel_size", 0) == 1 && squareConvParam(params, "stride", "stride", 1) == 1
+        && squareConvParam(params, "pad", "pad", 0) == 0 && squareConvParam(params, "dilation", "dilation", 1) == 1;
+}
+
+cv::Ptr<cv::dnn::Layer> PointwiseConvLayer::create(LayerParams & params)
+{
+    return cv::Ptr<cv::dnn::Layer>(new PointwiseConvLayer(params));
+}
+
+bool PointwiseConvLayer::getMemoryShapes(const vector<MatShape> & inputs, const int requiredOutputs,
+    vector<MatShape> & outputs, vector<MatShape> & internals) const
+{
+    CV_Assert(inputs.size() == 1 && inputs[0].size() == 4 && inputs[0][1] == _inChannels);
+    outputs.assign(1, cv::dnn::shape(inputs[0][0], _outChannels, inputs[0][2], inputs[0][3]));
+    return false;
+}
+
+bool PointwiseConvLayer::setActivation(const cv::Ptr<cv::dnn::ActivationLayer> & layer)
+{
+    // only a plain ReLU is fused, anything else stays a layer of its own
+    cv::Ptr<cv::dnn::ReLULayer> relu = layer.dynamicCast<cv::dnn::ReLULayer>();
+    _relu = !relu.empty() && relu->negativeSlope == 0.0f;
+    return _relu;
+}
+
+void PointwiseConvLayer::forward(cv::InputArrayOfArrays inputs_arr, cv::OutputArrayOfArrays outputs_arr, cv::OutputArrayOfArrays internals_arr)
+{
+    vector<cv::Mat> inputs, outputs;
+    inputs_arr.getMatVector(inputs);
+    outputs_arr.getMatVector(outputs);
+
+    const cv::Mat & src = inputs[0];
+    cv::Mat & dst = outputs[0];
+    const int num = src.size[0];
+    const int pixels = src.size[2] * src.size[3];
+    const int groups = (_outChannels + ChannelGroup - 1) / ChannelGroup;
+    const int stripes = (pixels + PixelStripe - 1) / PixelStripe;
+    const bool useAvx2 = cpuHasAvx2();
+    const bool halfWeights = _packedWeights.type() == CV_16S;
+
+    cv::parallel_for_(cv::Range(0, num * groups * stripes), [&](const cv::Range & range)
+    {
+        for (int task = range.start; task < range.end; task++)
+        {
+            int n = task / (groups * stripes);
+            int group = (task / stripes) % groups;
+            int stripe = task % stripes;
+            int ocBegin = group * ChannelGroup;
+            int pBegin = stripe * PixelStripe;
+            const float *srcImage = src.ptr<float>() + (size_t)n * _inChannels * pixels;
+            float *dstImage = dst.ptr<float>() + (size_t)n * _outChannels * pixels;
+            const int ocEnd = std::min(_outChannels, ocBegin + ChannelGroup);
+            const int pEnd = std::min(pixels, pBegin + PixelStripe);
+            if (halfWeights)
+                pointwiseConv(srcImage, _inChannels, pixels, _packedWeights.ptr<uint16_t>(), _bias.ptr<float>(), dstImage, _outChannels,
+                    ocBegin, ocEnd, pBegin, pEnd, _relu, useAvx2);
+            else
+                pointwiseConv(srcImage, _inChannels, pixels, _packedWeights.ptr<float>(), _bias.ptr<float>(), dstImage, _outChannels,
+                    ocBegin, ocEnd, pBegin, pEnd, _relu, useAvx2);
+        }
+    });
+}
@@ -0,0 +1,29 @@
+#pragma once
+#include <vector>
+#include <opencv2/dnn.hpp>
+#include <opencv2/dnn/all_layers.hpp>
+
+// 1x1 convolution as a cache-tiled GEMM over weights packed in blocks of output channels,
+// with bias and an optional fused ReLU applied in the micro-kernel. The packed weights are stored as half floats
+// when customLayers.fp16Weights is set and the CPU has F16C.
+class PointwiseConvLayer : public cv::dnn::Layer
+{
+public:
+    PointwiseConvLayer(const cv::dnn::LayerParams & params);
+    // true if params describe a convolution this layer handles
+    static bool accepts(const cv::dnn::LayerParams & params);
+    static cv::Ptr<cv::dnn::Layer> create(cv::dnn::LayerParams & params);
+
+    bool getMemoryShapes(const std::vector<cv::dnn::MatShape> & inputs, const int requiredOutputs,
+        std::vector<cv::dnn::MatShape> & outputs, std::vector<cv::dnn::MatShape> & internals) const override;
+    bool setActivation(const cv::Ptr<cv::dnn::ActivationLayer> & layer) override;
+    void forward(cv::InputArrayOfArrays inputs, cv::OutputArrayOfArrays outputs, cv::OutputArrayOfArrays internals) override;
+
+private:
+    const int _outChannels;
+    const int _inChannels;
+    bool _relu;
+    // CV_32F, or CV_16S holding IEEE half floats
+    cv::Mat _packedWeights;
+    cv::Mat _bias;
+};
@@ -0,0 +1,237 @@
+#include <cmath>
+#include <string>
+#include <thread>
+#include <chrono>
+#include <Poco/Logger.h>
+#include <Poco/Util/AbstractConfiguration.h>
+#include <librealsense2/rs.hpp>
+#include <opencv2/core.hpp>
+#include "RealSenseSource.h"
+#include "StageTrace.h"
+
+using std::string;
+using Poco::Util::AbstractConfiguration;
+
+// frame waits timing out in a row before a live device counts as gone
+static const int TimeoutsBeforeReconnect = 3;
+static const unsigned int FrameTimeoutMs = 1000;
+// frame waits of a recording, between which it is checked for its end, waiting past the end would time out
+static const unsigned int PlaybackWaitMs = 50;
+// between attempts to start a device which is not back yet
+static const int ReconnectIntervalMs = 500;
+
+// Decoding a RealSense frame is done by librealsense when it is taken, the source needs no decode threads
+RealSenseSource::RealSenseSource(const CameraSettings & settings, const AbstractConfiguration & config)
+    : FrameSource(settings.serial, config, 1)
+    , _settings(settings)
+    , _align(settings.alignTo)
+    , _depthScale{ 0.001f }
+    , _streaming{ false }
+    , _timeouts{ 0 }
+    , _firstFrameFrom{ 0 }
+    , _reconnectFrom{ 0 }
+    , _deviceLost{ false }
+    , _pluggedAt{ 0 }
+    , _firstFrame(metrics().histogram("rscvdnn_camera_first_frame_seconds",
+        "Time from a camera being plugged in or started to its first frame", "camera=\"" + settings.serial + "\""))
+{
+}
+
+RealSenseSource::~RealSenseSource()
+{
+    stop();
+}
+
+void RealSenseSource::configure(rs2::config & config)
+{
+    // Even though both streams are configured here, the frames given to the detector have the size of the
+    // stream aligned to
+    config.enable_device(_settings.serial);
+    const StreamProfile & color = _settings.color;
+    const StreamProfile & depth = _settings.depth;
+    config.enable_stream(RS2_STREAM_COLOR, color.size.width, color.size.height, color.format, color.fps);
+    config.enable_stream(RS2_STREAM_DEPTH, depth.size.width, depth.size.height, depth.format, depth.fps);
+}
+
+void RealSenseSource::open()
+{
+    _firstFrameFrom = traceNow();
+    _timeouts = 0;
+    _deviceLost = false;
+    _pluggedAt = 0;
+    _reconnectFrom = 0;
+    rs2::config config;
+    configure(config);
+    rs2::pipeline_profile profile = _pipe.start(config);
+    try
+    {
+        started(profile);
+        auto alignProfile = profile.get_stream(_settings.alignTo).as<rs2::video_stream_profile>();
+        _frameSize = cv::Size(alignProfile.width(), alignProfile.height());
+        _depthScale = profile.get_device().first<rs2::depth_sensor>().get_depth_scale();
+    }
+    catch (...)
+    {
+        _pipe.stop();
+        throw;
+    }
+    _streaming = true;
+}
+
+void RealSenseSource::close()
+{
+    // a device gone while it streamed may not have come back
+    if (_streaming)
+        _pipe.stop();
+    _streaming = false;
+}
+
+void RealSenseSource::deviceRemoved()
+{
+    _deviceLost = true;
+}
+
+void RealSenseSource::deviceAdded(int64_t time)
+{
+    // a device showing up again means the connection the pipeline has is gone, even if its removal went unseen
+    _pluggedAt = time;
+    _deviceLost = true;
+}
+
+bool RealSenseSource::reconnect()
+{
+    if (_streaming)
+    {
+        poco_warning(_logger, "device " + _settings.serial + " lost, waiting for it to come back");
+        try
+        {
+            _pipe.stop();
+        }
+        catch (const rs2::error &)
+        {
+            // the pipeline of a vanished device may have stopped on its own
+        }
+        _streaming = false;
+    }
+
+    // try at once when the device was plugged in again, otherwise every little while
+    for (int waitedMs = 0; waitedMs < ReconnectIntervalMs && _pluggedAt == 0; waitedMs += 50)
+    {
+        if (stopping())
+            return false;
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    }
+    int64_t pluggedAt = _pluggedAt.exchange(0);
+    if (pluggedAt != 0)
+        _reconnectFrom = pluggedAt;
+    try
+    {
+        rs2::config config;
+        configure(config);
+        _pipe.start(config);
+    }
+    catch (const rs2::error &)
+    {
+        return false;
+    }
+    _streaming = true;
+    _deviceLost = false;
+    _timeouts = 0;
+    _firstFrameFrom = (_reconnectFrom != 0) ? _reconnectFrom : traceNow();
+    _reconnectFrom = 0;
+    poco_information(_logger, "device " + _settings.serial + " streaming again");
+    return true;
+}
+
+bool RealSenseSource::grab(PipelineFrame & frame)
+{
+    // recordings are never reconnected, they end
+    const bool live = _settings.playback.empty();
+    while (!stopping())
+    {
+        if (live && (!_streaming || _deviceLost) && !reconnect())
+            continue;
+        // a recording played to its end may still have its last frames queued
+        if (!live && ended())
+            return _pipe.poll_for_frames(&frame.frames) && frameGrabbed(frame);
+        try
+        {
+            frame.frames = _pipe.wait_for_frames(live ? FrameTimeoutMs : PlaybackWaitMs);
+        }
+        catch (const rs2::error & e)
+        {
+            // a recording just has no frame yet, or reached its end, which the next round sees
+            if (!live)
+                continue;
+            // a frame timeout is not fatal, the device may just be slow to deliver after start
+            poco_warning(_logger, string("waiting for frames: ") + e.what());
+            if (++_timeouts >= TimeoutsBeforeReconnect)
+                _deviceLost = true;
+            continue;
+        }
+        return frameGrabbed(frame);
+    }
+    return false;
+}
+
+bool RealSenseSource::frameGrabbed(PipelineFrame & frame)
+{
+    _timeouts = 0;
+    if (_firstFrameFrom != 0)
+    {
+        double ms = (traceNow() - _firstFrameFrom) / 1e6;
+        _firstFrame.record(ms);
+        poco_information(_logger, "first frame of " + _settings.serial + " after " + std::to_string(std::lround(ms)) + " ms");
+        _firstFrameFrom = 0;
+    }
+    rs2::frame color = frame.frames.get_color_frame();
+    frame.frameNumber = color ? color.get_frame_number() : frame.sequence;
+    frame.sensorTimestamp = color ? color.get_timestamp() : 0.0;
+    return true;
+}
+
+void RealSenseSource::align(PipelineFrame & frame)
+{
+    frame.frames = _align.proccess(frame.frames);
+    rs2::video_frame color = frame.frames.get_color_frame();
+    rs2::depth_frame depth = frame.frames.get_depth_frame();
+    frame.color = cv::Mat(cv::Size(color.get_width(), color.get_height()), CV_8UC3, (void*)color.get_data(), color.get_stride_in_bytes());
+    frame.depth = cv::Mat(cv::Size(depth.get_width(), depth.get_height()), CV_16UC1, (void*)depth.get_data(), depth.get_stride_in_bytes());
+}
+
+BagFileSource::BagFileSource(const CameraSettings & settings, const AbstractConfiguration & config)
+    : RealSenseSource(settings, config)
+    , _endLogged{ false }
+{
+}
+
+BagFileSource::~BagFileSource()
+{
+    stop();
+}
+
+void BagFileSource::configure(rs2::config & config)
+{
+    config.enable_device_from_file(_settings.playback, _repeat);
+    config.enable_stream(RS2_STREAM_COLOR, -1, 0, 0, RS2_FORMAT_RGB8, 0);
+    config.enable_stream(RS2_STREAM_DEPTH, -1, 0, 0, RS2_FORMAT_Z16, 0);
+}
+
+void BagFileSource::started(rs2::pipeline_profile & profile)
+{
+    // without real time the recording is read as fast as the pipeline takes its frames, none is dropped
+    profile.get_device().as<rs2::playback>().set_real_time(_realTime);
+    _endLogged = false;
+}
+
+bool BagFileSource::ended()
+{
+    // a recording played to its end has no more frames
+    rs2::device device = _pipe.get_active_profile().get_device();
+    if (device.as<rs2::playback>().current_status() != RS2_PLAYBACK_STATUS_STOPPED)
+        return false;
+    if (!_endLogged)
+        poco_information(_logger, "end of " + _settings.playback);
+    _endLogged = true;
+    return true;
+}
@@ -0,0 +1,81 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <Poco/Util/AbstractConfiguration.h>
+#include <librealsense2/rs.hpp>
+#include <opencv2/core.hpp>
+#include "CameraSettings.h"
+#include "FrameSource.h"
+#include "Metrics.h"
+
+// A RealSense device streaming color and depth as configured for the camera. The frames are aligned on the align
+// stage of the pipeline, the color and depth mats point into the aligned frames the pipeline frame keeps.
+// A live device that stops delivering, unplugged or reset, is started again on the reader thread as soon as it is
+// back, the pipeline just sees a gap in the frames. The time from the device being plugged in, or started, to its
+// first frame is published as rscvdnn_camera_first_frame_seconds.
+class RealSenseSource : public FrameSource
+{
+public:
+    RealSenseSource(const CameraSettings & settings, const Poco::Util::AbstractConfiguration & config);
+    ~RealSenseSource();
+    cv::Size frameSize() const override { return _frameSize; }
+    float depthScale() const override { return _depthScale; }
+    bool bgrColor() const override { return _settings.color.format == RS2_FORMAT_BGR8; }
+    void align(PipelineFrame & frame) override;
+    // the device was unplugged, or plugged in again at time on the trace clock, safe to call from any thread
+    void deviceRemoved();
+    void deviceAdded(int64_t time);
+
+protected:
+    void open() override;
+    void close() override;
+    bool grab(PipelineFrame & frame) override;
+    // the device and streams to start
+    virtual void configure(rs2::config & config);
+    // called once the pipeline streams
+    virtual void started(rs2::pipeline_profile & profile) {}
+    // there will be no more frames
+    virtual bool ended() { return false; }
+
+    const CameraSettings _settings;
+    rs2::pipeline _pipe;
+
+private:
+    // start the pipeline again once the device is back, false while it is not
+    bool reconnect();
+    // the bookkeeping of a frame just waited for, always true
+    bool frameGrabbed(PipelineFrame & frame);
+
+    rs2::align _align;
+    cv::Size _frameSize;
+    float _depthScale;
+    // state of the reader thread, and of open and close
+    bool _streaming;
+    int _timeouts;
+    int64_t _firstFrameFrom;
+    // when the device lost was plugged in again, 0 if unknown
+    int64_t _reconnectFrom;
+    std::atomic<bool> _deviceLost;
+    std::atomic<int64_t> _pluggedAt;
+    LatencyHistogram & _firstFrame;
+};
+
+// A .bag recording played back in place of the device it was recorded from, with the streams it was recorded with.
+class BagFileSource : public RealSenseSource
+{
+public:
+    BagFileSource(const CameraSettings & settings, const Poco::Util::AbstractConfiguration & config);
+    ~BagFileSource();
+    // recordings are played back in RGB whatever the camera is configured to
+    bool bgrColor() const override { return false; }
+
+protected:
+    void configure(rs2::config & config) override;
+    void started(rs2::pipeline_profile & profile) override;
+    bool ended() override;
+
+private:
+    // the end was logged, ended is polled on every frame after it
+    bool _endLogged;
+};
@@ -0,0 +1,386 @@
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <cstring>
+#include <iomanip>
+#include <sstream>
+#include <stdexcept>
+#include <Poco/BinaryReader.h>
+#include <Poco/BinaryWriter.h>
+#include <Poco/DateTimeFormatter.h>
+#include <Poco/File.h>
+#include <Poco/LocalDateTime.h>
+#include <Poco/Logger.h>
+#include <Poco/MemoryStream.h>
+#include <Poco/Path.h>
+#include <Poco/SharedMemory.h>
+#include <Poco/Util/AbstractConfiguration.h>
+#include <opencv2/opencv.hpp>
+#include "Recording.h"
+#include "DepthCodec.h"
+#include "StageTrace.h"
+
+using std::string;
+using std::vector;
+using Poco::BinaryReader;
+using Poco::BinaryWriter;
+using Poco::Logger;
+using Poco::Path;
+using Poco::Util::AbstractConfiguration;
+
+static const char FileMagic[8] = { 'R', 'S', 'C', 'V', 'R', 'E', 'C', 0 };
+static const char IndexMagic[8] = { 'R', 'S', 'C', 'V', 'I', 'D', 'X', 0 };
+static const Poco::UInt32 ChunkMagic = 0x454d5246; // "FRME"
+static const size_t ChunkHeaderSize = 36;
+static const size_t TrailerSize = 24;
+static const size_t SerialSize = 32;
+static const string Extension = ".rscvrec";
+
+// path of segment number of a recording
+static string segmentPath(const string & baseName, int segment)
+{
+    std::ostringstream path;
+    path << baseName << "_" << std::setw(3) << std::setfill('0') << segment << Extension;
+    return path.str();
+}
+
+RecordingWriter::RecordingWriter(const AbstractConfiguration & config, const string & serial, int camera)
+    : _logger{ Logger::get("RecordingWriter." + serial) }
+    , _directory{ config.getString("directory", ".") }
+    , _maxFileBytes{ (uint64_t)std::max(1, config.getInt("maxFileMB", 1024)) << 20 }
+    , _jpegQuality{ config.getInt("jpegQuality", 90) }
+    , _queue("record", *config.createView("queue"))
+    , _running{ false }
+    , _segment{ 0 }
+    , _fileBytes{ 0 }
+    , _framesWritten(metrics().counter("rscvdnn_recorder_frames_total", "Frames written to recordings", "camera=\"" + serial + "\""))
+    , _bytesWritten(metrics().counter("rscvdnn_recorder_bytes_total", "Bytes written to recordings", "camera=\"" + serial + "\""))
+{
+    string color = config.getString("colorCodec", "jpeg");
+    if (color != "jpeg" && color != "raw")
+        throw std::invalid_argument("unknown recorder colorCodec " + color);
+    string depth = config.getString("depthCodec", "rvl");
+    if (depth != "rvl" && depth != "png" && depth != "raw")
+        throw std::invalid_argument("unknown recorder depthCodec " + depth);
+    _header.colorCodec = (color == "jpeg") ? RecordingHeader::ColorJpeg : RecordingHeader::ColorRaw;
+    _header.depthCodec = (depth == "rvl") ? RecordingHeader::DepthRvl : (depth == "png") ? RecordingHeader::DepthPng : RecordingHeader::DepthRaw;
+    _header.camera = camera;
+    _header.depthScale = 0.001f;
+    _header.serial = serial.substr(0, SerialSize);
+}
+
+RecordingWriter::~RecordingWriter()
+{
+    stop();
+}
+
+void RecordingWriter::start(const cv::Size & frameSize, float depthScale)
+{
+    if (_running)
+        return;
+
+    _header.frameSize = frameSize;
+    _header.depthScale = depthScale;
+    Poco::File(_directory).createDirectories();
+    Path base(_directory);
+    base.makeDirectory();
+    base.setFileName(_header.serial + "_" + Poco::DateTimeFormatter::format(Poco::LocalDateTime(), "%Y%m%d-%H%M%S"));
+    _baseName = base.toString();
+    _segment = 0;
+    openSegment();
+    _queue.reopen();
+    _running = true;
+    _thread = std::thread(&RecordingWriter::run, this);
+    poco_information(_logger, "recording to " + segmentPath(_baseName, 0));
+}
+
+void RecordingWriter::stop()
+{
+    if (!_running)
+        return;
+
+    // the frames already queued are still written
+    _queue.close();
+    _thread.join();
+    _running = false;
+    closeSegment();
+    QueueStats stats = _queue.stats();
+    poco_information(_logger, "recording stopped, " + std::to_string(stats.enqueued) + " frames queued, "
+        + std::to_string(stats.dropped) + " dropped");
+}
+
+bool RecordingWriter::record(RecordedFrame frame)
+{
+    return _running && _queue.push(std::move(frame));
+}
+
+void RecordingWriter::run()
+{
+    setTraceThreadName(_header.serial + " record");
+    RecordedFrame frame;
+    while (_queue.pop(frame))
+    {
+        setTraceFrame(frame.frameNumber);
+        try
+        {
+            if (!_file.is_open())
+                continue;
+            write(frame);
+            if (_fileBytes >= _maxFileBytes)
+            {
+                closeSegment();
+                _segment++;
+                openSegment();
+            }
+        }
+        catch (const std::exception & e)
+        {
+            // the frames written so far stay readable, the rest of the recording is dropped
+            poco_error(_logger, string("recording stopped: ") + e.what());
+            closeSegment();
+        }
+    }
+}
+
+void RecordingWriter::openSegment()
+{
+    string path = segmentPath(_baseName, _segment);
+    _file.open(path, std::ios::binary | std::ios::trunc);
+    if (!_file)
+        throw std::runtime_error("cannot write recording " + path);
+
+    char serial[SerialSize] = {};
+    std::memcpy(serial, _header.serial.data(), _header.serial.size());
+    BinaryWriter writer(_file, BinaryWriter::LITTLE_ENDIAN_BYTE_ORDER);
+    writer.writeRaw(FileMagic, sizeof(FileMagic));
+    writer << (Poco::UInt16)RecordingHeader::Version << _header.colorCodec << _header.depthCodec << (Poco::UInt16)_header.camera
+        << (Poco::UInt32)_header.frameSize.width << (Poco::UInt32)_header.frameSize.height << _header.depthScale;
+    writer.writeRaw(serial, sizeof(serial));
+    writer << (Poco::UInt32)0;
+    _fileBytes = RecordingHeader::Size;
+    _index.clear();
+}
+
+void RecordingWriter::closeSegment()
+{
+    if (!_file.is_open())
+        return;
+
+    BinaryWriter writer(_file, BinaryWriter::LITTLE_ENDIAN_BYTE_ORDER);
+    uint64_t indexOffset = _fileBytes;
+    for (const RecordingIndexEntry & entry : _index)
+    {
+        writer << (Poco::UInt64)entry.frameNumber << entry.timestamp << (Poco::UInt64)entry.offset
+            << (Poco::UInt32)entry.colorSize << (Poco::UInt32)entry.depthSize << (Poco::UInt32)entry.detectionsSize << (Poco::UInt32)0;
+    }
+    writer << (Poco::UInt64)indexOffset << (Poco::UInt64)_index.size();
+    writer.writeRaw(IndexMagic, sizeof(IndexMagic));
+    writer.flush();
+    if (!_file)
+        poco_error(_logger, "index of " + segmentPath(_baseName, _segment) + " not written");
+    _file.close();
+    _bytesWritten.add(_index.size() * RecordingIndexEntry::Size + TrailerSize);
+}
+
+void RecordingWriter::write(const RecordedFrame & frame)
+{
+    {
+        TraceScope scope("encode");
+        _colorBuffer.clear();
+        if (_header.colorCodec == RecordingHeader::ColorJpeg)
+            cv::imencode(".jpg", frame.color, _colorBuffer, { cv::IMWRITE_JPEG_QUALITY, _jpegQuality });
+        else
+        {
+            cv::Mat color = frame.color.isContinuous() ? frame.color : frame.color.clone();
+            _colorBuffer.assign(color.datastart, color.dataend);
+        }
+        _depthBuffer.clear();
+        if (!frame.depth.empty())
+        {
+            // PNG level 1 keeps up with the frame rate and is still lossless, RVL is several times faster
+            if (_header.depthCodec == RecordingHeader::DepthRvl)
+                encodeDepthRvl(frame.depth, _depthBuffer);
+            else if (_header.depthCodec == RecordingHeader::DepthPng)
+                cv::imencode(".png", frame.depth, _depthBuffer, { cv::IMWRITE_PNG_COMPRESSION, 1 });
+            else
+            {
+                cv::Mat depth = frame.depth.isContinuous() ? frame.depth : frame.depth.clone();
+                _depthBuffer.assign(depth.datastart, depth.dataend);
+            }
+        }
+    }
+
+    TraceScope scope("write");
+    string detections = frame.detections.encode();
+    RecordingIndexEntry entry{ frame.frameNumber, frame.timestamp, _fileBytes + ChunkHeaderSize,
+        (uint32_t)_colorBuffer.size(), (uint32_t)_depthBuffer.size(), (uint32_t)detections.size() };
+    BinaryWriter writer(_file, BinaryWriter::LITTLE_ENDIAN_BYTE_ORDER);
+    writer << ChunkMagic << (Poco::UInt32)(ChunkHeaderSize - 8 + entry.colorSize + entry.depthSize + entry.detectionsSize)
+        << (Poco::UInt64)entry.frameNumber << entry.timestamp << (Poco::UInt32)entry.colorSize << (Poco::UInt32)entry.depthSize
+        << (Poco::UInt32)entry.detectionsSize;
+    writer.writeRaw((const char *)_colorBuffer.data(), _colorBuffer.size());
+    writer.writeRaw((const char *)_depthBuffer.data(), _depthBuffer.size());
+    writer.writeRaw(detections);
+    if (!_file)
+        throw std::runtime_error("cannot write to " + segmentPath(_baseName, _segment));
+
+    uint64_t bytes = ChunkHeaderSize + entry.colorSize + entry.depthSize + entry.detectionsSize;
+    _fileBytes += bytes;
+    _index.push_back(entry);
+    _framesWritten.add();
+    _bytesWritten.add(bytes);
+}
+
+static Poco::SharedMemory mapFile(const string & path)
+{
+    Poco::File file(path);
+    if (!file.exists() || file.getSize() < RecordingHeader::Size)
+        throw std::runtime_error(path + " is not a recording");
+    return Poco::SharedMemory(file, Poco::SharedMemory::AM_READ);
+}
+
+RecordingReader::RecordingReader(const string & path)
+    : _path{ path }
+    , _mapping(mapFile(path))
+    , _data{ _mapping.begin() }
+    , _size{ (size_t)(_mapping.end() - _mapping.begin()) }
+    , _frameCount{ 0 }
+    , _index{ nullptr }
+{
+    Poco::MemoryInputStream stream(_data, RecordingHeader::Size);
+    BinaryReader reader(stream, BinaryReader::LITTLE_ENDIAN_BYTE_ORDER);
+    char magic[sizeof(FileMagic)];
+    Poco::UInt16 version, camera;
+    Poco::UInt32 width, height;
+    char serial[SerialSize + 1] = {};
+    stream.read(magic, sizeof(magic));
+    reader >> version >> _header.colorCodec >> _header.depthCodec >> camera >> width >> height >> _header.depthScale;
+    stream.read(serial, SerialSize);
+    if (std::memcmp(magic, FileMagic, sizeof(magic)) != 0 || version != RecordingHeader::Version)
+        throw std::runtime_error(path + " is not a recording of this version");
+    _header.camera = camera;
+    _header.frameSize = cv::Size((int)width, (int)height);
+    _header.serial = serial;
+
+    // the trailer tells where the index is, a file cut short has to be walked
+    if (_size >= RecordingHeader::Size + TrailerSize && std::memcmp(_data + _size - sizeof(IndexMagic), IndexMagic, sizeof(IndexMagic)) == 0)
+    {
+        Poco::MemoryInputStream trailer(_data + _size - TrailerSize, TrailerSize);
+        BinaryReader trailerReader(trailer, BinaryReader::LITTLE_ENDIAN_BYTE_ORDER);
+        Poco::UInt64 indexOffset, count;
+        trailerReader >> indexOffset >> count;
+        if (indexOffset + count * RecordingIndexEntry::Size + TrailerSize == _size)
+        {
+            _index = _data + indexOffset;
+            _frameCount = (size_t)count;
+            return;
+        }
+    }
+    poco_warning(Logger::get("RecordingReader"), path + " has no index, reading its frames one by one");
+    scanChunks();
+}
+
+void RecordingReader::scanChunks()
+{
+    size_t offset = RecordingHeader::Size;
+    while (offset + ChunkHeaderSize <= _size)
+    {
+        Poco::MemoryInputStream stream(_data + offset, ChunkHeaderSize);
+        BinaryReader reader(stream, BinaryReader::LITTLE_ENDIAN_BYTE_ORDER);
+        Poco::UInt32 magic, size;
+        Poco::UInt64 frameNumber;
+        RecordingIndexEntry entry;
+        reader >> magic >> size >> frameNumber >> entry.timestamp >> entry.colorSize >> entry.depthSize >> entry.detectionsSize;
+        // the last chunk may have been written only in part
+        if (magic != ChunkMagic || offset + 8 + size > _size || size != ChunkHeaderSize - 8 + entry.colorSize + entry.depthSize + entry.detectionsSize)
+            break;
+        entry.frameNumber = frameNumber;
+        entry.offset = offset + ChunkHeaderSize;
+        _scanned.push_back(entry);
+        offset += 8 + size;
+    }
+    _frameCount = _scanned.size();
+}
+
+RecordingIndexEntry RecordingReader::entry(size_t index) const
+{
+    if (index >= _frameCount)
+        throw std::out_of_range("frame " + std::to_string(index) + " is not in " + _path);
+    if (_index == nullptr)
+        return _scanned[index];
+
+    Poco::MemoryInputStream stream(_index + index * RecordingIndexEntry::Size, RecordingIndexEntry::Size);
+    BinaryReader reader(stream, BinaryReader::LITTLE_ENDIAN_BYTE_ORDER);
+    Poco::UInt64 frameNumber, offset;
+    RecordingIndexEntry entry;
+    reader >> frameNumber >> entry.timestamp >> offset >> entry.colorSize >> entry.depthSize >> entry.detectionsSize;
+    entry.frameNumber = frameNumber;
+    entry.offset = offset;
+    if (entry.offset + entry.colorSize + entry.depthSize + entry.detectionsSize > _size)
+        throw std::runtime_error("index of " + _path + " is corrupt");
+    return entry;
+}
+
+RecordedFrame RecordingReader::frame(size_t index) const
+{
+    RecordingIndexEntry at = entry(index);
+    RecordedFrame frame;
+    frame.frameNumber = at.frameNumber;
+    frame.timestamp = at.timestamp;
+
+    const char *data = _data + at.offset;
+    const cv::Size & size = _header.frameSize;
+    cv::Mat color(1, (int)at.colorSize, CV_8UC1, (void *)data);
+    if (_header.colorCodec == RecordingHeader::ColorJpeg)
+        frame.color = cv::imdecode(color, cv::IMREAD_COLOR);
+    else if (at.colorSize == (size_t)size.area() * 3)
+        frame.color = cv::Mat(size, CV_8UC3, (void *)data).clone();
+    if (frame.color.size() != size)
+        throw std::runtime_error("color of frame " + std::to_string(index) + " of " + _path + " is corrupt");
+
+    data += at.colorSize;
+    if (at.depthSize > 0)
+    {
+        cv::Mat depth(1, (int)at.depthSize, CV_8UC1, (void *)data);
+        if (_header.depthCodec == RecordingHeader::DepthRvl)
+        {
+            if (!decodeDepthRvl((const uint8_t *)data, at.depthSize, size, frame.depth))
+                frame.depth.release();
+        }
+        else if (_header.depthCodec == RecordingHeader::DepthPng)
+            frame.depth = cv::imdecode(depth, cv::IMREAD_ANYDEPTH);
+        else if (at.depthSize == (size_t)size.area() * 2)
+            frame.depth = cv::Mat(size, CV_16UC1, (void *)data).clone();
+        if (frame.depth.size() != size || frame.depth.type() != CV_16UC1)
+            throw std::runtime_error("depth of frame " + std::to_string(index) + " of " + _path + " is corrupt");
+    }
+
+    data += at.depthSize;
+    if (at.detectionsSize < 4 || !frame.detections.decode(data + 4, at.detectionsSize - 4))
+        throw std::runtime_error("detections of frame " + std::to_string(index) + " of " + _path + " are corrupt");
+    return frame;
+}
+
+vector<string> RecordingReader::segments(const string & path)
+{
+    // <serial>_<time>_<segment>.rscvrec, the segments of a recording follow each other without gaps
+    vector<string> files{ path };
+    string name = Path(path).getBaseName();
+    size_t separator = name.rfind('_');
+    if (separator == string::npos || separator + 1 == name.size())
+        return files;
+    int first = 0;
+    try
+    {
+        first = std::stoi(name.substr(separator + 1));
+    }
+    catch (const std::exception &)
+    {
+        return files;
+    }
+    Path base(path);
+    base.setFileName(name.substr(0, separator));
+    for (int segment = first + 1; Poco::File(segmentPath(base.toString(), segment)).exists(); segment++)
+        files.push_back(segmentPath(base.toString(), segment));
+    return files;
+}
@@ -0,0 +1,135 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include <Poco/Logger.h>
+#include <Poco/SharedMemory.h>
+#include <Poco/Util/AbstractConfiguration.h>
+#include <opencv2/core.hpp>
+#include "DetectionPublisher.h"
+#include "Metrics.h"
+#include "StageQueue.h"
+
+// Recordings of the frames and detections of one camera for later audit and re-analysis. A recording is split
+// into segment files of at most recorder.maxFileMB, each readable on its own. Every file is little endian,
+//   header: char[8] "RSCVREC", uint16 version (1), uint16 color codec, uint16 depth codec, uint16 camera index,
+//     uint32 width, uint32 height, float32 depth scale, char[32] camera serial, zero padded, uint32 reserved
+//   frame chunks: uint32 "FRME", uint32 size of the rest of the chunk, uint64 frame number, float64 timestamp in ms,
+//     uint32 color, depth and detections size, followed by the color, depth and detections data
+//   index: one entry per frame in recording order, uint64 frame number, float64 timestamp, uint64 file offset of
+//     the color data, uint32 color, depth and detections size, uint32 reserved
+//   trailer: uint64 file offset of the index, uint64 frame count, char[8] "RSCVIDX"
+// Color is BGR, raw or JPEG, depth Z16, raw, PNG or RVL (DepthCodec.h), and detections a DetectionMessage with
+// its length prefix. The index is written when a file is closed, a file cut short without it is read by walking its chunks.
+struct RecordingHeader
+{
+    enum ColorCodec : uint16_t { ColorRaw = 0, ColorJpeg = 1 };
+    enum DepthCodec : uint16_t { DepthRaw = 0, DepthPng = 1, DepthRvl = 2 };
+    static const uint16_t Version = 1;
+    static const size_t Size = 64;
+
+    uint16_t colorCodec;
+    uint16_t depthCodec;
+    int camera;
+    cv::Size frameSize;
+    float depthScale;
+    std::string serial;
+};
+
+struct RecordingIndexEntry
+{
+    static const size_t Size = 40;
+
+    uint64_t frameNumber;
+    double timestamp;
+    uint64_t offset;
+    uint32_t colorSize;
+    uint32_t depthSize;
+    uint32_t detectionsSize;
+};
+
+// a frame as recorded, color BGR and depth Z16 or empty
+struct RecordedFrame
+{
+    uint64_t frameNumber;
+    double timestamp;
+    cv::Mat color;
+    cv::Mat depth;
+    DetectionMessage detections;
+};
+
+// Writes the frames of one camera on a thread of its own, the pipeline only copies the frame into a bounded queue,
+// configured by recorder.queue, which drops frames rather than slowing the pipeline down unless it blocks.
+class RecordingWriter
+{
+public:
+    // config is the recorder section
+    RecordingWriter(const Poco::Util::AbstractConfiguration & config, const std::string & serial, int camera);
+    ~RecordingWriter();
+    // start a new recording of frames of the given size in the recorder directory
+    void start(const cv::Size & frameSize, float depthScale);
+    // write the frames queued and close the file
+    void stop();
+    bool isRunning() const { return _running; }
+    // queue a frame for writing, false if it was dropped
+    bool record(RecordedFrame frame);
+    QueueStats queueStats() const { return _queue.stats(); }
+
+private:
+    void run();
+    void openSegment();
+    void closeSegment();
+    void write(const RecordedFrame & frame);
+
+    Poco::Logger & _logger;
+    const std::string _directory;
+    const uint64_t _maxFileBytes;
+    const int _jpegQuality;
+    RecordingHeader _header;
+    StageQueue<RecordedFrame> _queue;
+    std::thread _thread;
+    std::atomic<bool> _running;
+    // state of the writer thread
+    std::string _baseName;
+    int _segment;
+    std::ofstream _file;
+    uint64_t _fileBytes;
+    std::vector<RecordingIndexEntry> _index;
+    std::vector<uchar> _colorBuffer;
+    std::vector<uchar> _depthBuffer;
+    MetricCounter & _framesWritten;
+    MetricCounter & _bytesWritten;
+};
+
+// One segment file of a recording, memory mapped, so any frame is found in constant time through the index.
+// Reading frames is safe from any number of threads.
+class RecordingReader
+{
+public:
+    // throws if the file is not a recording
+    RecordingReader(const std::string & path);
+    const RecordingHeader & header() const { return _header; }
+    size_t frameCount() const { return _frameCount; }
+    RecordingIndexEntry entry(size_t index) const;
+    // decode the frame at position index of the file
+    RecordedFrame frame(size_t index) const;
+    // the segment files of the recording path is the first of, in order
+    static std::vector<std::string> segments(const std::string & path);
+
+private:
+    void scanChunks();
+
+    const std::string _path;
+    Poco::SharedMemory _mapping;
+    const char *_data;
+    size_t _size;
+    RecordingHeader _header;
+    size_t _frameCount;
+    // the index in the file, or the one built from the chunks if the file has none
+    const char *_index;
+    std::vector<RecordingIndexEntry> _scanned;
+};
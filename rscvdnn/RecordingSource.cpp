@@ -0,0 +1,87 @@
+#include <string>
+#include <vector>
+#include <stdexcept>
+#include <Poco/Util/AbstractConfiguration.h>
+#include <opencv2/opencv.hpp>
+#include "RecordingSource.h"
+
+using std::string;
+using std::pair;
+using Poco::Util::AbstractConfiguration;
+
+RecordingSource::RecordingSource(const CameraSettings & settings, const AbstractConfiguration & config)
+    : FrameSource(settings.serial, config, config.getInt("decodeThreads", 2))
+    , _file{ settings.playback }
+    , _frameCount{ 0 }
+    , _depthScale{ 0.001f }
+    , _next{ 0 }
+{
+}
+
+RecordingSource::~RecordingSource()
+{
+    stop();
+}
+
+void RecordingSource::open()
+{
+    _segments.clear();
+    _frameCount = 0;
+    for (const string & path : RecordingReader::segments(_file))
+    {
+        _segments.emplace_back(new RecordingReader(path));
+        _frameCount += _segments.back()->frameCount();
+    }
+    const RecordingHeader & header = _segments.front()->header();
+    _frameSize = header.frameSize;
+    _depthScale = header.depthScale;
+    if (_frameCount == 0)
+        throw std::runtime_error(_file + " has no frames");
+
+    // the frame rate over the whole recording
+    RecordingIndexEntry first = _segments.front()->entry(0);
+    RecordingIndexEntry last = _segments.back()->entry(_segments.back()->frameCount() - 1);
+    if (_frameCount > 1 && last.timestamp > first.timestamp)
+        setFrameRate((_frameCount - 1) * 1000.0 / (last.timestamp - first.timestamp));
+    _next = 0;
+}
+
+void RecordingSource::close()
+{
+    _segments.clear();
+}
+
+pair<size_t, size_t> RecordingSource::locate(size_t position) const
+{
+    size_t segment = 0;
+    while (position >= _segments[segment]->frameCount())
+        position -= _segments[segment++]->frameCount();
+    return { segment, position };
+}
+
+bool RecordingSource::grab(PipelineFrame & frame)
+{
+    if (_next == _frameCount)
+    {
+        if (!_repeat)
+        {
+            poco_information(_logger, "end of " + _file);
+            return false;
+        }
+        _next = 0;
+    }
+    pair<size_t, size_t> at = locate(_next++);
+    RecordingIndexEntry entry = _segments[at.first]->entry(at.second);
+    frame.frameNumber = entry.frameNumber;
+    frame.sensorTimestamp = entry.timestamp;
+    return true;
+}
+
+void RecordingSource::decode(PipelineFrame & frame)
+{
+    // frames are grabbed one after the other from the start, over and over if repeated
+    pair<size_t, size_t> at = locate((size_t)(frame.sequence % _frameCount));
+    RecordedFrame recorded = _segments[at.first]->frame(at.second);
+    cv::cvtColor(recorded.color, frame.color, cv::COLOR_BGR2RGB);
+    frame.depth = recorded.depth;
+}
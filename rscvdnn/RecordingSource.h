@@ -0,0 +1,39 @@
+#pragma once
+#include <memory>
+#include <string>
+#include <vector>
+#include <Poco/Util/AbstractConfiguration.h>
+#include <opencv2/core.hpp>
+#include "CameraSettings.h"
+#include "FrameSource.h"
+#include "Recording.h"
+
+// A recording made by RecordingWriter played back, starting from the segment file given and going on through
+// the segments following it, at the recorded frame rate unless the playback is not real time. The frames are
+// decoded from the mapped files by the decode threads in parallel, their recorded detections are not used.
+class RecordingSource : public FrameSource
+{
+public:
+    RecordingSource(const CameraSettings & settings, const Poco::Util::AbstractConfiguration & config);
+    ~RecordingSource();
+    cv::Size frameSize() const override { return _frameSize; }
+    float depthScale() const override { return _depthScale; }
+
+protected:
+    void open() override;
+    void close() override;
+    bool grab(PipelineFrame & frame) override;
+    void decode(PipelineFrame & frame) override;
+
+private:
+    // the segment and the position in it of a frame of the whole recording
+    std::pair<size_t, size_t> locate(size_t position) const;
+
+    const std::string _file;
+    // not changed while started
+    std::vector<std::unique_ptr<RecordingReader>> _segments;
+    size_t _frameCount;
+    cv::Size _frameSize;
+    float _depthScale;
+    size_t _next;
+};
@@ -0,0 +1,65 @@
+#pragma once
+#include <algorithm>
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+// Double ended queue in one buffer of slots, which only grows when every slot is taken. Once a queue held the most
+// items it ever holds it allocates nothing, unlike std::deque, which allocates and frees blocks as items pass.
+// Items are moved into the slots and out of them, a slot is reused as it is, whatever an item left there.
+template <typename T>
+class RingBuffer
+{
+public:
+    explicit RingBuffer(size_t capacity = 0) : _slots(capacity), _head{ 0 }, _size{ 0 } {}
+
+    bool empty() const { return _size == 0; }
+    size_t size() const { return _size; }
+    size_t capacity() const { return _slots.size(); }
+    T & front() { return _slots[_head]; }
+    T & back() { return _slots[(_head + _size - 1) % _slots.size()]; }
+
+    template <typename U>
+    void push_back(U && item)
+    {
+        if (_size == _slots.size())
+            grow();
+        _slots[(_head + _size) % _slots.size()] = std::forward<U>(item);
+        _size++;
+    }
+
+    // the item is left in its slot, moved from if the caller took it
+    void pop_front()
+    {
+        _head = (_head + 1) % _slots.size();
+        _size--;
+    }
+
+    void pop_back()
+    {
+        _size--;
+    }
+
+    // the queued items are replaced by default ones, so they let go of what they hold
+    void clear()
+    {
+        for (size_t i = 0; i < _size; i++)
+            _slots[(_head + i) % _slots.size()] = T();
+        _head = 0;
+        _size = 0;
+    }
+
+private:
+    void grow()
+    {
+        std::vector<T> slots(std::max<size_t>(1, 2 * _slots.size()));
+        for (size_t i = 0; i < _size; i++)
+            slots[i] = std::move(_slots[(_head + i) % _slots.size()]);
+        _slots.swap(slots);
+        _head = 0;
+    }
+
+    std::vector<T> _slots;
+    size_t _head;
+    size_t _size;
+};
@@ -0,0 +1,173 @@
+#include <cstdint>
+#include <cstdlib>
+#include <bitset>
+#include <stdexcept>
+#include <string>
+#include <emmintrin.h>
+#include <Poco/Util/AbstractConfiguration.h>
+#include <opencv2/opencv.hpp>
+#include "SceneChangeGate.h"
+
+using Poco::Util::AbstractConfiguration;
+
+// gray levels per bin of the thumbnail histograms, coarse enough for noise to stay within a bin
+static const int HistogramBins = 32;
+
+static bool parseHistogramMetric(const std::string & name)
+{
+    if (name == "sad")
+        return false;
+    if (name == "histogram")
+        return true;
+    throw std::invalid_argument("unknown scene change metric " + name);
+}
+
+SceneChangeGate::SceneChangeGate(const AbstractConfiguration & config)
+    : _enabled{ config.getBool("enabled", false) }
+    , _useDepth{ config.getBool("useDepth", true) }
+    , _histogram{ parseHistogramMetric(config.getString("metric", "sad")) }
+    , _thumbSize{ config.getInt("thumbnailSize", 64), config.getInt("thumbnailSize", 64) }
+    , _threshold{ config.getDouble("threshold", 0.02) }
+    , _depthThreshold{ config.getDouble("depthThreshold", 0.05) }
+    , _depthScale{ 0.001f }
+    , _maxSkip{ config.getInt("maxSkip", 90) }
+    , _framesInferred{ 0 }
+    , _framesSkipped{ 0 }
+    , _lastChange{ 0.0 }
+    , _avgInferenceMs{ 0.0 }
+{
+    reset();
+}
+
+void SceneChangeGate::reset()
+{
+    _hasReference = false;
+    _skipRun = 0;
+}
+
+bool SceneChangeGate::shouldInfer(const cv::Mat & colorRoi, const cv::Mat & depthRoi)
+{
+    if (!_enabled)
+        return true;
+
+    // downscale before the color conversion, the thumbnail is all that is compared
+    cv::resize(colorRoi, _thumbColor, _thumbSize, 0, 0, cv::INTER_AREA);
+    cv::cvtColor(_thumbColor, _grayCur, cv::COLOR_BGR2GRAY);
+    if (_useDepth && !depthRoi.empty())
+        cv::resize(depthRoi, _depthCur, _thumbSize, 0, 0, cv::INTER_NEAREST);
+
+    if (!_hasReference)
+        return true;
+
+    _lastChange = _histogram ? histogramDistance(_grayCur, _grayRef) : meanAbsDiff8u(_grayCur, _grayRef);
+    bool changed = _lastChange > _threshold;
+    if (!changed && _useDepth && !_depthCur.empty() && !_depthRef.empty())
+        changed = meanAbsDiff16u(_depthCur, _depthRef) * _depthScale > _depthThreshold;
+
+    if (changed || (_maxSkip > 0 && _skipRun >= _maxSkip))
+        return true;
+
+    _skipRun++;
+    _framesSkipped++;
+    return false;
+}
+
+void SceneChangeGate::commit(double elapsedMs)
+{
+    _framesInferred++;
+    _avgInferenceMs = (_framesInferred == 1) ? elapsedMs : _avgInferenceMs + 0.1 * (elapsedMs - _avgInferenceMs);
+
+    if (!_enabled)
+        return;
+
+    cv::swap(_grayRef, _grayCur);
+    cv::swap(_depthRef, _depthCur);
+    _hasReference = true;
+    _skipRun = 0;
+}
+
+double SceneChangeGate::meanAbsDiff8u(const cv::Mat & a, const cv::Mat & b)
+{
+    CV_Assert(a.type() == CV_8UC1 && b.type() == CV_8UC1 && a.size() == b.size());
+
+    uint64_t sum = 0;
+    for (int y = 0; y < a.rows; y++)
+    {
+        const uint8_t *pa = a.ptr<uint8_t>(y);
+        const uint8_t *pb = b.ptr<uint8_t>(y);
+        int x = 0;
+        // PSADBW sums the absolute differences of 16 bytes into two 64-bit lanes
+        __m128i acc = _mm_setzero_si128();
+        for (; x + 16 <= a.cols; x += 16)
+            acc = _mm_add_epi64(acc, _mm_sad_epu8(_mm_loadu_si128((const __m128i *)(pa + x)), _mm_loadu_si128((const __m128i *)(pb + x))));
+        alignas(16) uint64_t lanes[2];
+        _mm_store_si128((__m128i *)lanes, acc);
+        sum += lanes[0] + lanes[1];
+        for (; x < a.cols; x++)
+            sum += std::abs(pa[x] - pb[x]);
+    }
+
+    return a.empty() ? 0.0 : sum / (a.total() * 255.0);
+}
+
+double SceneChangeGate::histogramDistance(const cv::Mat & a, const cv::Mat & b)
+{
+    CV_Assert(a.type() == CV_8UC1 && b.type() == CV_8UC1 && a.size() == b.size());
+
+    // both thumbnails have the same number of pixels, the counts are compared as they are
+    int bins[HistogramBins] = {};
+    for (int y = 0; y < a.rows; y++)
+    {
+        const uint8_t *pa = a.ptr<uint8_t>(y);
+        const uint8_t *pb = b.ptr<uint8_t>(y);
+        for (int x = 0; x < a.cols; x++)
+        {
+            bins[pa[x] * HistogramBins / 256]++;
+            bins[pb[x] * HistogramBins / 256]--;
+        }
+    }
+
+    uint64_t sum = 0;
+    for (int bin : bins)
+        sum += std::abs(bin);
+    return a.empty() ? 0.0 : sum / (2.0 * a.total());
+}
+
+double SceneChangeGate::meanAbsDiff16u(const cv::Mat & a, const cv::Mat & b)
+{
+    CV_Assert(a.type() == CV_16UC1 && b.type() == CV_16UC1 && a.size() == b.size());
+
+    // only pixels with valid depth in both frames are compared, zero means no data in Z16
+    uint64_t sum = 0;
+    uint64_t count = 0;
+    const __m128i zero = _mm_setzero_si128();
+    for (int y = 0; y < a.rows; y++)
+    {
+        const uint16_t *pa = a.ptr<uint16_t>(y);
+        const uint16_t *pb = b.ptr<uint16_t>(y);
+        int x = 0;
+        __m128i acc = _mm_setzero_si128();
+        for (; x + 8 <= a.cols; x += 8)
+        {
+            __m128i va = _mm_loadu_si128((const __m128i *)(pa + x));
+            __m128i vb = _mm_loadu_si128((const __m128i *)(pb + x));
+            __m128i invalid = _mm_or_si128(_mm_cmpeq_epi16(va, zero), _mm_cmpeq_epi16(vb, zero));
+            __m128i absdiff = _mm_andnot_si128(invalid, _mm_or_si128(_mm_subs_epu16(va, vb), _mm_subs_epu16(vb, va)));
+            acc = _mm_add_epi32(acc, _mm_add_epi32(_mm_unpacklo_epi16(absdiff, zero), _mm_unpackhi_epi16(absdiff, zero)));
+            count += 8 - std::bitset<16>(_mm_movemask_epi8(invalid)).count() / 2;
+        }
+        alignas(16) uint32_t lanes[4];
+        _mm_store_si128((__m128i *)lanes, acc);
+        sum += (uint64_t)lanes[0] + lanes[1] + lanes[2] + lanes[3];
+        for (; x < a.cols; x++)
+        {
+            if (pa[x] != 0 && pb[x] != 0)
+            {
+                sum += std::abs(pa[x] - pb[x]);
+                count++;
+            }
+        }
+    }
+
+    return (count > 0) ? (double)sum / count : 0.0;
+}
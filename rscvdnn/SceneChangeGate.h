@@ -0,0 +1,60 @@
+#pragma once
+#include <cstdint>
+#include <Poco/Util/AbstractConfiguration.h>
+#include <opencv2/opencv.hpp>
+
+// Cheap change detector deciding whether a new frame is worth running the DNN on.
+// A small grayscale thumbnail (and optionally a depth thumbnail) of the detection ROI
+// is compared against the one taken at the last inferred frame, inference is skipped
+// while the difference stays below the configured threshold. The gray thumbnails are compared by their mean
+// absolute difference (metric sad), or by the distance of their histograms (metric histogram), which ignores
+// small motion and noise that leave the brightness distribution as it is.
+class SceneChangeGate
+{
+public:
+    SceneChangeGate(const Poco::Util::AbstractConfiguration & config);
+    bool enabled() const { return _enabled; }
+    void reset();
+    void setDepthScale(float depthScale) { _depthScale = depthScale; }
+    // true if the frame differs enough from the reference to need a new inference
+    bool shouldInfer(const cv::Mat & colorRoi, const cv::Mat & depthRoi);
+    // make the last examined frame the new reference, elapsed is the inference cost
+    void commit(double elapsedMs);
+
+    uint64_t framesInferred() const { return _framesInferred; }
+    uint64_t framesSkipped() const { return _framesSkipped; }
+    // frames skipped since the last inferred one
+    int skipRun() const { return _skipRun; }
+    double lastChange() const { return _lastChange; }
+    // estimated CPU time saved by skipped frames
+    double cpuSavedMs() const { return _framesSkipped * _avgInferenceMs; }
+
+private:
+    static double meanAbsDiff8u(const cv::Mat & a, const cv::Mat & b);
+    static double meanAbsDiff16u(const cv::Mat & a, const cv::Mat & b);
+    // half the L1 distance of the normalized gray histograms, 0 for the same distribution, 1 for disjoint ones
+    static double histogramDistance(const cv::Mat & a, const cv::Mat & b);
+
+    const bool _enabled;
+    const bool _useDepth;
+    // compare the gray thumbnails by histogram instead of pixel by pixel
+    const bool _histogram;
+    const cv::Size _thumbSize;
+    // thresholds on the gray difference of the metric [0,1] and the mean depth difference in meters
+    const double _threshold;
+    const double _depthThreshold;
+    float _depthScale;
+    // force an inference after this many consecutive skipped frames, 0 to never force
+    const int _maxSkip;
+    bool _hasReference;
+    int _skipRun;
+    cv::Mat _grayRef;
+    cv::Mat _depthRef;
+    cv::Mat _grayCur;
+    cv::Mat _depthCur;
+    cv::Mat _thumbColor;
+    uint64_t _framesInferred;
+    uint64_t _framesSkipped;
+    double _lastChange;
+    double _avgInferenceMs;
+};
@@ -0,0 +1,165 @@
+#pragma once
+#include <algorithm>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <Poco/Util/AbstractConfiguration.h>
+#include "RingBuffer.h"
+
+// what a full queue does with a new item
+enum class QueuePolicy : uint8_t
+{
+    // discard the oldest queued item to make room, consumers always get the freshest frames
+    DropOldest,
+    // discard the new item, consumers see every frame up to the moment the queue filled
+    DropNewest,
+    // wait for room, the producer is slowed down to the pace of the consumer
+    Block
+};
+
+inline QueuePolicy parseQueuePolicy(const std::string & name)
+{
+    if (name == "dropOldest")
+        return QueuePolicy::DropOldest;
+    if (name == "dropNewest")
+        return QueuePolicy::DropNewest;
+    if (name == "block")
+        return QueuePolicy::Block;
+    throw std::invalid_argument("unknown queue policy " + name);
+}
+
+// counters of a queue, readable from any thread while the pipeline runs
+struct QueueStats
+{
+    uint64_t enqueued;
+    uint64_t dropped;
+    size_t depth;
+    size_t highWater;
+};
+
+// Bounded queue between two pipeline stages, with the capacity and the policy on overflow taken from
+// the configuration keys capacity and policy (dropOldest, dropNewest or block). The slots are allocated with the
+// queue and items are moved in and out of them, so passing items allocates nothing.
+template <typename T>
+class StageQueue
+{
+public:
+    StageQueue(const std::string & name, const Poco::Util::AbstractConfiguration & config)
+        : _name{ name }
+        , _capacity{ (size_t)std::max(1, config.getInt("capacity", 2)) }
+        , _policy{ parseQueuePolicy(config.getString("policy", "dropOldest")) }
+        , _items(_capacity)
+        , _closed{ false }
+        , _enqueued{ 0 }
+        , _dropped{ 0 }
+        , _highWater{ 0 }
+    {
+    }
+
+    const std::string & name() const { return _name; }
+    size_t capacity() const { return _capacity; }
+
+    // false if the queue was full and an item had to be dropped, or the queue is closed, the dropped item, the
+    // oldest one or item depending on the policy, is moved to dropped if given
+    bool push(const T & item, T *dropped = nullptr) { return pushItem(item, dropped); }
+    bool push(T && item, T *dropped = nullptr) { return pushItem(std::move(item), dropped); }
+
+    // wait for the next item, false once the queue is closed and drained
+    bool pop(T & item)
+    {
+        std::unique_lock<std::mutex> lock(_mutex);
+        _notEmpty.wait(lock, [this] { return _closed || !_items.empty(); });
+        return take(lock, item);
+    }
+
+    // the next item if there is one, never waits
+    bool tryPop(T & item)
+    {
+        std::unique_lock<std::mutex> lock(_mutex);
+        return take(lock, item);
+    }
+
+    // wake up all waiting producers and consumers, further pushes fail
+    void close()
+    {
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _closed = true;
+        }
+        _notEmpty.notify_all();
+        _notFull.notify_all();
+    }
+
+    // discard the queued items and accept pushes again, counters are kept
+    void reopen()
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _items.clear();
+        _closed = false;
+    }
+
+    QueueStats stats() const
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        return QueueStats{ _enqueued, _dropped, _items.size(), _highWater };
+    }
+
+private:
+    template <typename U>
+    bool pushItem(U && item, T *dropped)
+    {
+        std::unique_lock<std::mutex> lock(_mutex);
+        if (_policy == QueuePolicy::Block)
+            _notFull.wait(lock, [this] { return _closed || _items.size() < _capacity; });
+        if (_closed)
+            return false;
+
+        bool full = _items.size() >= _capacity;
+        if (full)
+        {
+            _dropped++;
+            if (_policy == QueuePolicy::DropNewest)
+            {
+                if (dropped != nullptr)
+                    *dropped = std::forward<U>(item);
+                return false;
+            }
+            if (dropped != nullptr)
+                *dropped = std::move(_items.front());
+            _items.pop_front();
+        }
+        _items.push_back(std::forward<U>(item));
+        _enqueued++;
+        if (_items.size() > _highWater)
+            _highWater = _items.size();
+        lock.unlock();
+        _notEmpty.notify_one();
+        return !full;
+    }
+
+    bool take(std::unique_lock<std::mutex> & lock, T & item)
+    {
+        if (_items.empty())
+            return false;
+        item = std::move(_items.front());
+        _items.pop_front();
+        lock.unlock();
+        _notFull.notify_one();
+        return true;
+    }
+
+    const std::string _name;
+    const size_t _capacity;
+    const QueuePolicy _policy;
+    mutable std::mutex _mutex;
+    std::condition_variable _notEmpty;
+    std::condition_variable _notFull;
+    RingBuffer<T> _items;
+    bool _closed;
+    uint64_t _enqueued;
+    uint64_t _dropped;
+    size_t _highWater;
+};
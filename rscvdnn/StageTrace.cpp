@@ -0,0 +1,184 @@
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "StageTrace.h"
+
+using std::string;
+using std::vector;
+
+// events kept per thread, older ones are overwritten
+static const uint64_t TraceCapacity = 8192;
+
+struct TraceEvent
+{
+    const char *name;
+    uint64_t frame;
+    int64_t start;
+    int64_t end;
+    double sensorMs;
+};
+
+// slot of a ring, stamped with its event's index + 1 once written and 0 while being written, a reader
+// keeps what it copied only if the stamp is the one expected before and after the copy
+struct TraceSlot
+{
+    std::atomic<uint64_t> stamp{ 0 };
+    std::atomic<const char *> name{ nullptr };
+    std::atomic<uint64_t> frame{ 0 };
+    std::atomic<int64_t> start{ 0 };
+    std::atomic<int64_t> end{ 0 };
+    std::atomic<double> sensorMs{ 0.0 };
+};
+
+// single producer ring of one thread, readers copy it and skip the slots overwritten meanwhile
+struct ThreadTrace
+{
+    TraceSlot events[TraceCapacity];
+    std::atomic<uint64_t> written{ 0 };
+    // the owning thread exited, a new thread may take the buffer over
+    std::atomic<bool> released{ false };
+    std::mutex nameMutex;
+    string name;
+    int id;
+};
+
+static std::atomic<bool> enabled{ false };
+static std::mutex registryMutex;
+static vector<std::unique_ptr<ThreadTrace>> registry;
+
+static ThreadTrace * acquireTrace()
+{
+    std::lock_guard<std::mutex> lock(registryMutex);
+    for (std::unique_ptr<ThreadTrace> & trace : registry)
+    {
+        bool released = true;
+        if (trace->released.compare_exchange_strong(released, false))
+        {
+            std::lock_guard<std::mutex> nameLock(trace->nameMutex);
+            trace->name.clear();
+            return trace.get();
+        }
+    }
+    registry.emplace_back(new ThreadTrace);
+    registry.back()->id = (int)registry.size();
+    return registry.back().get();
+}
+
+// buffer of the calling thread, handed back to the registry when the thread exits
+struct LocalTrace
+{
+    ThreadTrace *trace{ nullptr };
+    uint64_t frame{ 0 };
+    ThreadTrace & get()
+    {
+        if (trace == nullptr)
+            trace = acquireTrace();
+        return *trace;
+    }
+    ~LocalTrace()
+    {
+        if (trace != nullptr)
+            trace->released = true;
+    }
+};
+
+static thread_local LocalTrace local;
+
+int64_t traceNow()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void setTraceEnabled(bool on)
+{
+    enabled = on;
+}
+
+bool traceEnabled()
+{
+    return enabled.load(std::memory_order_relaxed);
+}
+
+void setTraceThreadName(const string & name)
+{
+    ThreadTrace & trace = local.get();
+    std::lock_guard<std::mutex> lock(trace.nameMutex);
+    trace.name = name;
+}
+
+void setTraceFrame(uint64_t frame)
+{
+    local.frame = frame;
+}
+
+void traceStage(const char *name, int64_t start, int64_t end, double sensorMs)
+{
+    if (!traceEnabled())
+        return;
+
+    ThreadTrace & trace = local.get();
+    uint64_t index = trace.written.load(std::memory_order_relaxed);
+    TraceSlot & slot = trace.events[index % TraceCapacity];
+    slot.stamp.store(0, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    slot.name.store(name, std::memory_order_relaxed);
+    slot.frame.store(local.frame, std::memory_order_relaxed);
+    slot.start.store(start, std::memory_order_relaxed);
+    slot.end.store(end, std::memory_order_relaxed);
+    slot.sensorMs.store(sensorMs, std::memory_order_relaxed);
+    slot.stamp.store(index + 1, std::memory_order_release);
+    trace.written.store(index + 1, std::memory_order_release);
+}
+
+bool writeChromeTrace(const string & path)
+{
+    std::ofstream out(path);
+    if (!out)
+        return false;
+
+    out << std::fixed << std::setprecision(3) << "{\"traceEvents\":[\n";
+    bool first = true;
+    std::lock_guard<std::mutex> lock(registryMutex);
+    for (const std::unique_ptr<ThreadTrace> & trace : registry)
+    {
+        // copy what the ring holds, skipping the slots the writer overwrote or was writing during the copy
+        uint64_t end = trace->written.load(std::memory_order_acquire);
+        uint64_t begin = (end > TraceCapacity) ? end - TraceCapacity : 0;
+        vector<TraceEvent> events;
+        for (uint64_t i = begin; i < end; i++)
+        {
+            const TraceSlot & slot = trace->events[i % TraceCapacity];
+            if (slot.stamp.load(std::memory_order_acquire) != i + 1)
+                continue;
+            TraceEvent event{ slot.name.load(std::memory_order_relaxed), slot.frame.load(std::memory_order_relaxed),
+                slot.start.load(std::memory_order_relaxed), slot.end.load(std::memory_order_relaxed),
+                slot.sensorMs.load(std::memory_order_relaxed) };
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (slot.stamp.load(std::memory_order_relaxed) == i + 1)
+                events.push_back(event);
+        }
+
+        {
+            std::lock_guard<std::mutex> nameLock(trace->nameMutex);
+            out << (first ? "" : ",\n") << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << trace->id
+                << ",\"args\":{\"name\":\"" << (trace->name.empty() ? "thread " + std::to_string(trace->id) : trace->name) << "\"}}";
+            first = false;
+        }
+        for (const TraceEvent & event : events)
+        {
+            out << ",\n{\"name\":\"" << event.name << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << trace->id
+                << ",\"ts\":" << event.start / 1000.0 << ",\"dur\":" << (event.end - event.start) / 1000.0
+                << ",\"args\":{\"frame\":" << event.frame;
+            if (event.sensorMs > 0.0)
+                out << ",\"sensor_ms\":" << event.sensorMs;
+            out << "}}";
+        }
+    }
+    out << "\n]}\n";
+    return (bool)out;
+}
@@ -0,0 +1,40 @@
+#pragma once
+#include <cstdint>
+#include <string>
+
+// Per-thread trace of pipeline stage timings, written without locks on the hot path and dumped as
+// Chrome trace JSON (chrome://tracing or https://ui.perfetto.dev). Every thread records into its own
+// ring buffer, a dump reads the rings of all threads while they keep recording and skips the events
+// overwritten during the read.
+
+// monotonic time in nanoseconds, the clock of all trace events
+int64_t traceNow();
+void setTraceEnabled(bool on);
+bool traceEnabled();
+// name shown for the calling thread
+void setTraceThreadName(const std::string & name);
+// frame number the following events of the calling thread belong to
+void setTraceFrame(uint64_t frame);
+// record a finished stage of the current frame of the calling thread, name must be a string literal,
+// sensorMs is the hardware timestamp of the frame if known
+void traceStage(const char *name, int64_t start, int64_t end, double sensorMs = 0.0);
+// write the buffered events of all threads, false if the file cannot be written
+bool writeChromeTrace(const std::string & path);
+
+// traces the stage lasting from its construction to the end of the scope
+class TraceScope
+{
+public:
+    TraceScope(const char *name) : _name{ name }, _start{ traceEnabled() ? traceNow() : 0 } {}
+    ~TraceScope()
+    {
+        if (_start != 0)
+            traceStage(_name, _start, traceNow());
+    }
+    TraceScope(const TraceScope &) = delete;
+    TraceScope & operator=(const TraceScope &) = delete;
+
+private:
+    const char *_name;
+    const int64_t _start;
+};
@@ -0,0 +1,92 @@
+#include <atomic>
+#include <iomanip>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <Poco/Logger.h>
+#include "StartupTrace.h"
+#include "StageTrace.h"
+#include "Metrics.h"
+
+using std::string;
+using std::vector;
+using Poco::Logger;
+
+struct StartupPhase
+{
+    const char *name;
+    int64_t start;
+    int64_t end;
+};
+
+static std::atomic<int64_t> begin{ 0 };
+static std::atomic<bool> detected{ false };
+static std::mutex phasesMutex;
+static vector<StartupPhase> phases;
+
+static Logger & startupLogger()
+{
+    static Logger & logger = Logger::get("Startup");
+    return logger;
+}
+
+static int64_t startupTime()
+{
+    int64_t time = begin.load();
+    return time != 0 ? time : traceNow();
+}
+
+void startupBegin()
+{
+    int64_t none = 0;
+    begin.compare_exchange_strong(none, traceNow());
+}
+
+void startupPhase(const char *name, int64_t start, int64_t end)
+{
+    // camera restarts later on are no part of the startup
+    if (detected.load(std::memory_order_relaxed))
+        return;
+    startupBegin();
+    double endMs = (end - startupTime()) / 1e6;
+    std::ostringstream msg;
+    msg << std::fixed << std::setprecision(1) << "startup phase " << name << " done at " << endMs << " ms, took "
+        << (end - start) / 1e6 << " ms";
+    poco_information(startupLogger(), msg.str());
+    metrics().gauge("rscvdnn_startup_phase_seconds", "Time from process start to the end of a startup phase",
+        string("phase=\"") + name + "\"").set(endMs / 1000.0);
+
+    std::lock_guard<std::mutex> lock(phasesMutex);
+    phases.push_back(StartupPhase{ name, start, end });
+}
+
+void startupDetected()
+{
+    if (detected.load(std::memory_order_relaxed) || detected.exchange(true))
+        return;
+
+    int64_t now = traceNow();
+    int64_t start = startupTime();
+    std::ostringstream msg;
+    msg << std::fixed << std::setprecision(1) << "first detection " << (now - start) / 1e6 << " ms after start";
+    {
+        std::lock_guard<std::mutex> lock(phasesMutex);
+        for (const StartupPhase & phase : phases)
+            msg << "\n  " << std::left << std::setw(16) << phase.name << std::right << std::setw(10) << (phase.start - start) / 1e6
+                << " ms to " << std::setw(10) << (phase.end - start) / 1e6 << " ms";
+    }
+    poco_information(startupLogger(), msg.str());
+    metrics().gauge("rscvdnn_startup_first_detection_seconds", "Time from process start to the first detection").set((now - start) / 1e9);
+}
+
+StartupScope::StartupScope(const char *name)
+    : _name{ name }
+    , _start{ traceNow() }
+{
+}
+
+StartupScope::~StartupScope()
+{
+    startupPhase(_name, _start, traceNow());
+}
@@ -0,0 +1,29 @@
+#pragma once
+#include <cstdint>
+
+// Phases of the cold start of the process, configuration, network load and warm-up, window and device start, timed
+// from startupBegin on the trace clock. Every phase is logged as it ends with its offset and duration, and kept as
+// rscvdnn_startup_phase_seconds, the offset of its end. The first detection of any camera ends the startup with a
+// summary of the phases and the time to first detection. Phases may run on any thread, and overlap.
+
+// the process started, the time the phases are measured from, only the first call counts
+void startupBegin();
+// a phase lasting from start to end on the trace clock finished, name must be a string literal, ignored after the
+// first detection
+void startupPhase(const char *name, int64_t start, int64_t end);
+// a frame went through the detector, the first one ends the startup
+void startupDetected();
+
+// times the phase lasting from its construction to the end of the scope
+class StartupScope
+{
+public:
+    StartupScope(const char *name);
+    ~StartupScope();
+    StartupScope(const StartupScope &) = delete;
+    StartupScope & operator=(const StartupScope &) = delete;
+
+private:
+    const char *_name;
+    const int64_t _start;
+};
@@ -0,0 +1,148 @@
+#include <string>
+#include <sstream>
+#include <Poco/Logger.h>
+#include <librealsense2/rs.hpp>
+#include "StreamController.h"
+#include "StageTrace.h"
+
+using std::string;
+using std::ostringstream;
+using Poco::Logger;
+
+const char * streamStateName(StreamState state)
+{
+    switch (state)
+    {
+    case StreamState::Idle: return "idle";
+    case StreamState::Starting: return "starting";
+    case StreamState::Streaming: return "streaming";
+    case StreamState::Detecting: return "detecting";
+    case StreamState::Stopping: return "stopping";
+    }
+    return "unknown";
+}
+
+StreamController::StreamController(CameraRig & rig)
+    : _logger{ Logger::get("StreamController") }
+    , _rig(rig)
+    , _state{ StreamState::Idle }
+{
+}
+
+StreamController::~StreamController()
+{
+    joinTransition();
+    if (isStreaming())
+    {
+        _state = StreamState::Stopping;
+        runStop();
+    }
+}
+
+bool StreamController::isStreaming() const
+{
+    StreamState current = state();
+    return current == StreamState::Streaming || current == StreamState::Detecting;
+}
+
+bool StreamController::start()
+{
+    if (state() != StreamState::Idle)
+        return false;
+
+    joinTransition();
+    _state = StreamState::Starting;
+    poco_information(_logger, "starting cameras");
+    _transition = std::thread(&StreamController::runStart, this);
+    return true;
+}
+
+bool StreamController::stop()
+{
+    if (!isStreaming())
+        return false;
+
+    joinTransition();
+    _state = StreamState::Stopping;
+    poco_information(_logger, "stopping cameras");
+    _transition = std::thread(&StreamController::runStop, this);
+    return true;
+}
+
+bool StreamController::setDetecting(bool on)
+{
+    StreamState current = state();
+    if (current == StreamState::Starting || current == StreamState::Stopping)
+        return false;
+
+    _rig.setDetecting(on);
+    if (current != StreamState::Idle)
+        _state = on ? StreamState::Detecting : StreamState::Streaming;
+    return true;
+}
+
+void StreamController::runStart()
+{
+    setTraceThreadName("stream start");
+    size_t cameras = 0;
+    string error;
+    try
+    {
+        // start streaming from every configured realsense device connected
+        cameras = _rig.start();
+        if (cameras == 0)
+            error = "No RealSense device is found, please connect the device and try again.";
+    }
+    catch (const rs2::error & e)
+    {
+        ostringstream errmsg;
+        errmsg << "RealSense error calling " << e.get_failed_function() << "(" << e.get_failed_args() << "):\n    " << e.what();
+        error = errmsg.str();
+    }
+    catch (const std::exception & e)
+    {
+        error = e.what();
+    }
+
+    StreamState result = StreamState::Idle;
+    if (error.empty())
+        result = _rig.isDetecting() ? StreamState::Detecting : StreamState::Streaming;
+    else
+        poco_error(_logger, error);
+    // the owner may use the rig from the moment it sees the new state
+    _state.store(result, std::memory_order_release);
+    poco_information(_logger, string("cameras ") + streamStateName(result));
+    _events.enqueueNotification(new StreamEvent(StreamState::Starting, result, cameras, error));
+}
+
+void StreamController::runStop()
+{
+    setTraceThreadName("stream stop");
+    string error;
+    try
+    {
+        _rig.stop();
+    }
+    catch (const rs2::error & e)
+    {
+        ostringstream errmsg;
+        errmsg << "RealSense error calling " << e.get_failed_function() << "(" << e.get_failed_args() << "):\n    " << e.what();
+        error = errmsg.str();
+    }
+    catch (const std::exception & e)
+    {
+        error = e.what();
+    }
+
+    if (!error.empty())
+        poco_error(_logger, error);
+    _state.store(StreamState::Idle, std::memory_order_release);
+    poco_information(_logger, "cameras stopped");
+    _events.enqueueNotification(new StreamEvent(StreamState::Stopping, StreamState::Idle, 0, error));
+}
+
+void StreamController::joinTransition()
+{
+    if (_transition.joinable())
+        _transition.join();
+}
@@ -0,0 +1,78 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <thread>
+#include <Poco/Logger.h>
+#include <Poco/Notification.h>
+#include <Poco/NotificationQueue.h>
+#include "CameraRig.h"
+
+enum class StreamState : uint8_t
+{
+    Idle,
+    // the cameras are opened and their pipelines started on the transition thread
+    Starting,
+    Streaming,
+    // streaming with the detector on
+    Detecting,
+    // the pipelines and the cameras are stopped on the transition thread
+    Stopping
+};
+
+const char * streamStateName(StreamState state);
+
+// a transition, Starting or Stopping, finished in state, Idle with error set if starting failed
+class StreamEvent : public Poco::Notification
+{
+public:
+    StreamEvent(StreamState transition, StreamState state, size_t cameras, const std::string & error)
+        : _transition{ transition }, _state{ state }, _cameras{ cameras }, _error{ error } {}
+    StreamState transition() const { return _transition; }
+    StreamState state() const { return _state; }
+    size_t cameras() const { return _cameras; }
+    const std::string & error() const { return _error; }
+
+private:
+    const StreamState _transition;
+    const StreamState _state;
+    const size_t _cameras;
+    const std::string _error;
+};
+
+// State of the camera streams of a rig. Starting and stopping the cameras can take seconds, they run on a thread of
+// their own while the state is Starting or Stopping, and post a StreamEvent to events() when done. The state can be
+// read from any thread without locking. Transitions are only requested by one owner thread, the GUI thread, which
+// may use the rig while the state is Streaming or Detecting, the transition thread only while it is not.
+class StreamController
+{
+public:
+    StreamController(CameraRig & rig);
+    // waits for a running transition and stops the cameras
+    ~StreamController();
+    StreamController(const StreamController &) = delete;
+    StreamController & operator=(const StreamController &) = delete;
+
+    StreamState state() const { return _state.load(std::memory_order_acquire); }
+    bool isStreaming() const;
+    // begin starting the cameras, false unless Idle
+    bool start();
+    // begin stopping the cameras, false unless Streaming or Detecting
+    bool stop();
+    // switch between Streaming and Detecting, while Idle whether the next start detects, false during a transition
+    bool setDetecting(bool on);
+    // finished transitions, the owner picks them up with dequeueNotification without waiting
+    Poco::NotificationQueue & events() { return _events; }
+
+private:
+    void runStart();
+    void runStop();
+    // the transition thread of the last transition is done or about to be
+    void joinTransition();
+
+    Poco::Logger & _logger;
+    CameraRig & _rig;
+    std::atomic<StreamState> _state;
+    std::thread _transition;
+    Poco::NotificationQueue _events;
+};
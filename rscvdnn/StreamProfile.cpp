@@ -0,0 +1,73 @@
+#include <string>
+#include <vector>
+#include <stdexcept>
+#include <Poco/String.h>
+#include <librealsense2/rs.hpp>
+#include "StreamProfile.h"
+
+using std::string;
+using std::vector;
+
+double StreamProfile::bytesPerSecond() const
+{
+    return (double)size.area() * bytesPerPixel(format) * fps;
+}
+
+string StreamProfile::toString() const
+{
+    return std::to_string(size.width) + "x" + std::to_string(size.height) + " " + streamFormatName(format)
+        + " " + std::to_string(fps) + " fps";
+}
+
+rs2_format parseStreamFormat(const string & name)
+{
+    string format = Poco::toLower(name);
+    if (format == "rgb8")
+        return RS2_FORMAT_RGB8;
+    if (format == "bgr8")
+        return RS2_FORMAT_BGR8;
+    if (format == "z16")
+        return RS2_FORMAT_Z16;
+    throw std::invalid_argument("stream format " + name + " is not rgb8, bgr8 or z16");
+}
+
+const char * streamFormatName(rs2_format format)
+{
+    switch (format)
+    {
+    case RS2_FORMAT_RGB8: return "rgb8";
+    case RS2_FORMAT_BGR8: return "bgr8";
+    case RS2_FORMAT_Z16: return "z16";
+    default: return rs2_format_to_string(format);
+    }
+}
+
+int bytesPerPixel(rs2_format format)
+{
+    switch (format)
+    {
+    case RS2_FORMAT_RGB8:
+    case RS2_FORMAT_BGR8:
+        return 3;
+    case RS2_FORMAT_Z16:
+        return 2;
+    default:
+        return 0;
+    }
+}
+
+vector<StreamProfile> offeredProfiles(const rs2::device & device, rs2_stream stream)
+{
+    vector<StreamProfile> profiles;
+    for (rs2::sensor & sensor : device.query_sensors())
+    {
+        for (rs2::stream_profile & profile : sensor.get_stream_profiles())
+        {
+            if (profile.stream_type() != stream || !profile.is<rs2::video_stream_profile>())
+                continue;
+            rs2::video_stream_profile video = profile.as<rs2::video_stream_profile>();
+            profiles.push_back(StreamProfile{ cv::Size(video.width(), video.height()), video.format(), video.fps() });
+        }
+    }
+    return profiles;
+}
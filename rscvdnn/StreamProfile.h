@@ -0,0 +1,27 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <librealsense2/rs.hpp>
+#include <opencv2/core.hpp>
+
+// Resolution, pixel format and frame rate of a camera stream.
+struct StreamProfile
+{
+    cv::Size size;
+    rs2_format format;
+    int fps;
+
+    // bytes a stream of this profile delivers per second
+    double bytesPerSecond() const;
+    // e.g. 640x360 bgr8 30 fps
+    std::string toString() const;
+};
+
+// rgb8, bgr8 or z16, case insensitive, throws for any other
+rs2_format parseStreamFormat(const std::string & name);
+const char * streamFormatName(rs2_format format);
+// 0 for a format the pipeline does not read
+int bytesPerPixel(rs2_format format);
+
+// the video profiles of stream the sensors of device offer
+std::vector<StreamProfile> offeredProfiles(const rs2::device & device, rs2_stream stream);
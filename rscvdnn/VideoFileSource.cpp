@@ -0,0 +1,61 @@
+#include <string>
+#include <stdexcept>
+#include <Poco/Util/AbstractConfiguration.h>
+#include <opencv2/opencv.hpp>
+#include "VideoFileSource.h"
+
+using std::string;
+using Poco::Util::AbstractConfiguration;
+
+VideoFileSource::VideoFileSource(const CameraSettings & settings, const AbstractConfiguration & config)
+    : FrameSource(settings.serial, config, config.getInt("decodeThreads", 2))
+    , _file{ settings.playback }
+    , _depthScale{ (float)config.getDouble("depthScale", 0.001) }
+    , _position{ 0 }
+{
+}
+
+VideoFileSource::~VideoFileSource()
+{
+    stop();
+}
+
+void VideoFileSource::open()
+{
+    if (!_capture.open(_file))
+        throw std::runtime_error("cannot open video " + _file);
+    _frameSize = cv::Size((int)_capture.get(cv::CAP_PROP_FRAME_WIDTH), (int)_capture.get(cv::CAP_PROP_FRAME_HEIGHT));
+    setFrameRate(_capture.get(cv::CAP_PROP_FPS));
+    _position = 0;
+}
+
+void VideoFileSource::close()
+{
+    _capture.release();
+}
+
+bool VideoFileSource::grab(PipelineFrame & frame)
+{
+    if (!_capture.read(frame.color))
+    {
+        if (!_repeat || _position == 0)
+        {
+            poco_information(_logger, "end of " + _file);
+            return false;
+        }
+        _capture.set(cv::CAP_PROP_POS_FRAMES, 0);
+        _position = 0;
+        if (!_capture.read(frame.color))
+            return false;
+    }
+    _position++;
+    frame.frameNumber = _position;
+    frame.sensorTimestamp = _capture.get(cv::CAP_PROP_POS_MSEC);
+    return true;
+}
+
+void VideoFileSource::decode(PipelineFrame & frame)
+{
+    // the pipeline takes color frames as the camera delivers them, in RGB
+    cv::cvtColor(frame.color, frame.color, cv::COLOR_BGR2RGB);
+}
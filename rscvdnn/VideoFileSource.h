@@ -0,0 +1,32 @@
+#pragma once
+#include <string>
+#include <Poco/Util/AbstractConfiguration.h>
+#include <opencv2/core.hpp>
+#include <opencv2/videoio.hpp>
+#include "CameraSettings.h"
+#include "FrameSource.h"
+
+// A video file in any format OpenCV reads, color only, played at the frame rate of the file unless the playback is
+// not real time. Frames are read in order on the reader thread and converted to RGB by the decode threads.
+class VideoFileSource : public FrameSource
+{
+public:
+    VideoFileSource(const CameraSettings & settings, const Poco::Util::AbstractConfiguration & config);
+    ~VideoFileSource();
+    cv::Size frameSize() const override { return _frameSize; }
+    float depthScale() const override { return _depthScale; }
+
+protected:
+    void open() override;
+    void close() override;
+    bool grab(PipelineFrame & frame) override;
+    void decode(PipelineFrame & frame) override;
+
+private:
+    const std::string _file;
+    const float _depthScale;
+    cv::VideoCapture _capture;
+    cv::Size _frameSize;
+    // frames read since the file was started over
+    uint64_t _position;
+};
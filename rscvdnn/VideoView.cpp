@@ -3,7 +3,9 @@
 #include <nanogui/glutil.h>
 #include <glad/glad.h>
 #include <Eigen/Core>
+#include <opencv2/core.hpp>
 #include "VideoView.h"
+#include "StageTrace.h"
 
 using std::string;
 using nanogui::GLCanvas;
@@ -14,6 +16,9 @@ using MatrixXu = Eigen::Matrix<uint32_t, Eigen::Dynamic, Eigen::Dynamic>;
 
 VideoView::VideoView(Widget * parent)
     : GLCanvas(parent)
+    , _hasPending{ false }
+    , _pendingBgr{ false }
+    , _bgr{ false }
     , _glslVertex{ R"(
         #version 330 core
         in vec2 position;
@@ -34,7 +39,6 @@ VideoView::VideoView(Widget * parent)
         {
             fragColor = texture(frame, texCoord);
         })" }
-    , _frameQueue(1)
 {
     _shader.init("VideoViewShader", _glslVertex, _glslFragment);
 
@@ -81,22 +85,43 @@ VideoView::~VideoView()
     _shader.free();
 }
 
-void VideoView::setFrame(rs2::frame frame)
+void VideoView::setFrame(const cv::Mat & frame, bool bgr)
 {
-    _frameQueue.enqueue(std::move(frame));
+    // rows are uploaded without padding, copyTo gives a continuous mat
+    std::lock_guard<std::mutex> lock(_mutex);
+    frame.copyTo(_pending);
+    _pendingBgr = bgr;
+    _hasPending = true;
 }
 
 void VideoView::drawGL()
 {
-    // dequeue a frame from queue
-    rs2::video_frame frame = _frameQueue.wait_for_frame().as<rs2::video_frame>();
-    int frameWidth = frame.get_width();
-    int frameHeight = frame.get_height();
+    // frames arrive at the pace of the pipeline, redraws in between show the last one again
+    bool isNewFrame = false;
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        if (_hasPending)
+        {
+            cv::swap(_frame, _pending);
+            _bgr = _pendingBgr;
+            _hasPending = false;
+            isNewFrame = true;
+        }
+    }
+    if (_frame.empty())
+        return;
+
+    int frameWidth = _frame.cols;
+    int frameHeight = _frame.rows;
 
     glActiveTexture(GL_TEXTURE0);
     glBindTexture(GL_TEXTURE_2D, _textureid);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, frameWidth, frameHeight, 0, GL_RGB, GL_UNSIGNED_BYTE, frame.get_data());
-    glGenerateMipmap(GL_TEXTURE_2D);
+    if (isNewFrame)
+    {
+        TraceScope scope("texture_upload");
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, frameWidth, frameHeight, 0, _bgr ? GL_BGR : GL_RGB, GL_UNSIGNED_BYTE, _frame.data);
+        glGenerateMipmap(GL_TEXTURE_2D);
+    }
 
     // calculate scale factor
     float viewer_ratio = (float)this->width() / (float)this->height();
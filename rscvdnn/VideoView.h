@@ -1,15 +1,18 @@
 #pragma once
+#include <mutex>
 #include <string>
 #include <nanogui/glcanvas.h>
 #include <nanogui/glutil.h>
-#include <librealsense2/rs.hpp>
+#include <opencv2/core.hpp>
 
 class VideoView : public nanogui::GLCanvas
 {
 public:
     VideoView(nanogui::Widget *parent);
     ~VideoView();
-    void setFrame(rs2::frame frame);
+    // RGB or BGR frame to show from the next redraw on, copied, as it may point into buffers of librealsense which
+    // are recycled once the frame is released, the texture upload swaps the channels so neither order is converted
+    void setFrame(const cv::Mat & frame, bool bgr);
     void drawGL() override;
 
 private:
@@ -17,5 +20,12 @@ private:
     const std::string _glslVertex;
     const std::string _glslFragment;
     uint32_t _textureid;
-    rs2::frame_queue _frameQueue;
+    std::mutex _mutex;
+    // frame set since the last redraw, and the frame currently in the texture, owned by the view and swapped on a
+    // new frame so their buffers are reused
+    cv::Mat _pending;
+    cv::Mat _frame;
+    bool _hasPending;
+    bool _pendingBgr;
+    bool _bgr;
 };
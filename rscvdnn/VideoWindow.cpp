@@ -18,9 +18,9 @@ VideoWindow::VideoWindow(Widget * parent, const string & title)
     requestFocus();
 }
 
-void VideoWindow::setVideoFrame(rs2::frame frame)
+void VideoWindow::setVideoFrame(const cv::Mat & frame, bool bgr)
 {
-    _videoview->setFrame(frame);
+    _videoview->setFrame(frame, bgr);
 }
 
 void VideoWindow::setSize(const Eigen::Vector2i & size)
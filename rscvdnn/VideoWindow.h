@@ -1,7 +1,7 @@
 #pragma once
 #include <string>
 #include <nanogui/window.h>
-#include <librealsense2/rs.hpp>
+#include <opencv2/core.hpp>
 #include <Eigen/Core>
 #include "VideoView.h"
 
@@ -9,7 +9,8 @@ class VideoWindow : public nanogui::Window
 {
 public:
     VideoWindow(nanogui::Widget *parent, const std::string &title = "Untitled");
-    void setVideoFrame(rs2::frame frame);
+    // frame is BGR if bgr is set, RGB otherwise
+    void setVideoFrame(const cv::Mat & frame, bool bgr = false);
     void setSize(const Eigen::Vector2i &size);
 
 private:
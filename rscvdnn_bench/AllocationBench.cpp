@@ -0,0 +1,342 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <memory>
+#include <new>
+#include <string>
+#include <thread>
+#include <vector>
+#include <ostream>
+#include <iomanip>
+#include <Poco/AutoPtr.h>
+#include <Poco/File.h>
+#include <Poco/Path.h>
+#include <Poco/Net/SocketAddress.h>
+#include <Poco/Net/StreamSocket.h>
+#include <Poco/Util/MapConfiguration.h>
+#include <opencv2/opencv.hpp>
+#include <opencv2/dnn.hpp>
+#include "AllocationBench.h"
+#include "AllocationCounter.h"
+#include "CameraSettings.h"
+#include "DetectionPublisher.h"
+#include "FramePipeline.h"
+#include "FrameSource.h"
+#include "FrameStages.h"
+#include "MatPool.h"
+#include "NetPool.h"
+#include "ObjectDetector.h"
+
+using std::string;
+using std::vector;
+using std::ostream;
+using std::setw;
+using Poco::AutoPtr;
+using Poco::Util::MapConfiguration;
+
+// every allocation of the bench goes through here, counted on the threads an AllocationCounter runs on
+void * operator new(size_t size)
+{
+    countAllocation();
+    void *p = std::malloc(size > 0 ? size : 1);
+    if (p == nullptr)
+        throw std::bad_alloc();
+    return p;
+}
+
+void * operator new[](size_t size)
+{
+    return operator new(size);
+}
+
+void operator delete(void * p) noexcept
+{
+    std::free(p);
+}
+
+void operator delete[](void * p) noexcept
+{
+    std::free(p);
+}
+
+static const cv::Size FrameSize(1280, 720);
+// frames through the pipeline before the allocations are counted, the pools, queues and vectors reach their size
+static const int WarmUpFrames = 60;
+// buffers of the source, more than the prefetch, the default queues and the stages hold
+static const int SourceBuffers = 32;
+// allocations per frame outside of the network that a frame path allocating nothing stays below, a single
+// allocation on every frame or every other one shows above it
+static const double MaxAllocationsPerFrame = 0.5;
+// labels drawn to count the allocations of one
+static const int LabelRuns = 100;
+
+// the frames of one color image and a depth ramp, copied into buffers of pools on the decode threads, as a camera
+// delivers every frame in buffers of its own, as fast as the pipeline takes them until stopped
+class SyntheticSource : public FrameSource
+{
+public:
+    SyntheticSource(const Poco::Util::AbstractConfiguration & config, const cv::Mat & image)
+        : FrameSource("synthetic", config, 2)
+        , _colorPool("sourceColor", "camera=\"allocations\"")
+        , _depthPool("sourceDepth", "camera=\"allocations\"")
+    {
+        // RGB as a camera delivers it, the pipeline turns it into BGR in place
+        cv::Mat resized;
+        cv::resize(image, resized, FrameSize);
+        cv::cvtColor(resized, _color, cv::COLOR_BGR2RGB);
+        _depth.create(FrameSize, CV_16UC1);
+        for (int y = 0; y < FrameSize.height; y++)
+        {
+            for (int x = 0; x < FrameSize.width; x++)
+                _depth.at<uint16_t>(y, x) = (uint16_t)(500 + 4 * x + y);
+        }
+        _colorPool.reset(FrameSize, CV_8UC3, SourceBuffers);
+        _depthPool.reset(FrameSize, CV_16UC1, SourceBuffers);
+    }
+    ~SyntheticSource() { stop(); }
+    cv::Size frameSize() const override { return FrameSize; }
+    float depthScale() const override { return 0.001f; }
+
+protected:
+    void open() override {}
+    void close() override {}
+    bool grab(PipelineFrame & frame) override
+    {
+        frame.frameNumber = frame.sequence + 1;
+        frame.sensorTimestamp = frame.sequence * 1000.0 / 30.0;
+        frame.color = _colorPool.acquire();
+        frame.depth = _depthPool.acquire();
+        return true;
+    }
+    void decode(PipelineFrame & frame) override
+    {
+        _color.copyTo(frame.color);
+        _depth.copyTo(frame.depth);
+    }
+
+private:
+    cv::Mat _color;
+    cv::Mat _depth;
+    MatPool _colorPool;
+    MatPool _depthPool;
+};
+
+// what the pipeline does with the frames of a case
+struct AllocationCase
+{
+    const char *name;
+    bool detect;
+    bool depthView;
+    // the publisher and the recorder copy every frame into messages of their own, they are reported, not judged
+    bool publisher;
+    bool recorder;
+};
+
+// the square the pipeline cuts out of the middle of a frame
+static cv::Rect middleSquare(const cv::Size & size)
+{
+    int side = std::min(size.width, size.height);
+    return cv::Rect((size.width - side) / 2, (size.height - side) / 2, side, side);
+}
+
+// allocations of one run of the network through pool, on every thread, with the input blob of the region of image
+// the pipeline detects on, cv::resize allocates its tables for every image it scales
+static double networkAllocations(NetPool & pool, const cv::Mat & image, int runs)
+{
+    cv::Mat roi = image(middleSquare(image.size()));
+    InputBlob input(0.007843, 127.5);
+    const cv::Size inputSize(ObjectDetector::InputSide, ObjectDetector::InputSide);
+    auto job = [&roi, &input, &inputSize](cv::dnn::Net & net)
+    {
+        net.setInput(input.set(&roi, 1, inputSize), "data");
+        net.forward("detection_out");
+    };
+    pool.execute(job);
+    AllocationCounter counter(true);
+    for (int i = 0; i < runs; i++)
+        pool.execute(job);
+    return (double)counter.count() / runs;
+}
+
+// allocations of one label annotateFrame draws, putText and getTextSize allocate for every text
+static double labelAllocations(const cv::Mat & image)
+{
+    cv::Mat frame = image.clone();
+    cv::Rect roi = middleSquare(frame.size());
+    Detections detections{ Detection{ 15, 0.9f, cv::Rect(roi.width / 4, roi.height / 4, roi.width / 2, roi.height / 2) } };
+    vector<float> distances{ 1.5f };
+    const string name = "person";
+    auto className = [&name](int) -> const string & { return name; };
+    OverlayBuffers buffers;
+    annotateFrame(frame, roi, vector<cv::Rect>(), detections, distances, className, buffers);
+    AllocationCounter counter;
+    for (int i = 0; i < LabelRuns; i++)
+        annotateFrame(frame, roi, vector<cv::Rect>(), detections, distances, className, buffers);
+    return (double)counter.count() / LabelRuns;
+}
+
+static uint64_t networkRuns(const NetPool & pool)
+{
+    uint64_t runs = 0;
+    for (int i = 0; i < pool.workers(); i++)
+        runs += pool.executed(i);
+    return runs;
+}
+
+// run a FramePipeline of the case on a synthetic source with the default threads of OpenCV, count the allocations of
+// every thread over settings.iterations frames once warm, and those left over per frame after the network runs and
+// the labels drawn
+static bool runCase(const AllocationCase & test, const BenchSettings & settings, NetPool & pool, const cv::Mat & image,
+    double networkPerRun, double labelPerDraw, ostream & out)
+{
+    const string prototxt = settings.modelDir + "/MobileNetSSD_deploy.prototxt";
+    const string caffemodel = settings.modelDir + "/MobileNetSSD_deploy.caffemodel";
+    const string recordings = Poco::Path(Poco::Path::temp(), "rscvdnn_allocations").toString();
+    AutoPtr<MapConfiguration> config(new MapConfiguration);
+    config->setBool("recorder.enabled", test.recorder);
+    config->setString("recorder.directory", recordings);
+    // every annotated frame is handed out, so the labels drawn are those on the frames taken
+    config->setString("pipeline.queue.display.policy", "block");
+    if (test.recorder)
+        Poco::File(recordings).createDirectories();
+    AutoPtr<MapConfiguration> publisherConfig(new MapConfiguration);
+    publisherConfig->setString("address", "127.0.0.1");
+    publisherConfig->setString("port", "0");
+    publisherConfig->setInt("maxDropped", 1000000);
+
+    // a subscriber reading every message, so the publisher encodes and queues them as it would for a client
+    std::unique_ptr<DetectionPublisher> publisher;
+    Poco::Net::StreamSocket subscriber;
+    std::thread reader;
+    if (test.publisher)
+    {
+        publisher.reset(new DetectionPublisher(*publisherConfig));
+        publisher->start();
+        subscriber.connect(Poco::Net::SocketAddress("127.0.0.1", publisher->port()));
+        reader = std::thread([&subscriber]()
+        {
+            char buffer[4096];
+            try
+            {
+                while (subscriber.receiveBytes(buffer, sizeof(buffer)) > 0)
+                    ;
+            }
+            catch (const std::exception &)
+            {
+            }
+        });
+        for (int wait = 0; publisher->clientCount() == 0 && wait < 500; wait++)
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+
+    CameraSettings camera(*config, "allocations", "");
+    SyntheticSource source(*config, image);
+    FramePipeline pipeline(*config, camera, 0, publisher.get());
+    pipeline.loadModel(prototxt, caffemodel, &pool);
+    pipeline.setDetecting(test.detect);
+    pipeline.setDepthView(test.depthView);
+    source.start();
+    pipeline.start(source);
+
+    // the frames leave the pipeline as the display takes them, the counter runs from the first frame after warm up
+    PipelineFrame frame;
+    std::unique_ptr<AllocationCounter> counter;
+    uint64_t runsBefore = 0;
+    uint64_t allocations = 0;
+    uint64_t labels = 0;
+    int frames = 0;
+    while (frames < WarmUpFrames + settings.iterations && pipeline.nextFrame(frame))
+    {
+        frames++;
+        if (counter)
+            labels += frame.detections.size();
+        if (frames == WarmUpFrames)
+        {
+            runsBefore = networkRuns(pool);
+            counter.reset(new AllocationCounter(true));
+        }
+    }
+    if (counter)
+        allocations = counter->count();
+    uint64_t runs = networkRuns(pool) - runsBefore;
+    counter.reset();
+    frame = PipelineFrame();
+    pipeline.stop();
+    source.stop();
+    if (publisher)
+    {
+        // stopping disconnects the subscriber, whose reader sees the end of the stream
+        publisher->stop();
+        reader.join();
+        subscriber.close();
+    }
+    if (test.recorder)
+        Poco::File(recordings).remove(true);
+
+    // a pipeline that stopped handing out frames has nothing to count
+    bool complete = frames == WarmUpFrames + settings.iterations;
+    double perFrame = (allocations - runs * networkPerRun - labels * labelPerDraw) / settings.iterations;
+    bool judged = !test.publisher && !test.recorder;
+    bool ok = complete && (!judged || perFrame < MaxAllocationsPerFrame);
+    out << std::left << setw(16) << test.name << std::right << setw(8) << std::max(0, frames - WarmUpFrames) << setw(14) << allocations
+        << setw(10) << runs << setw(10) << labels << std::setprecision(2) << setw(14) << std::max(0.0, perFrame)
+        << (!complete ? "  ENDED EARLY" : judged ? (ok ? "" : "  ALLOCATES") : "  reported") << "\n";
+    return ok;
+}
+
+// the network input of InputBlob against that of cv::dnn::blobFromImage, which has to be the same to the bit
+static bool compareInputBlobs(const vector<cv::Mat> & frames, ostream & out)
+{
+    const cv::Size inputSize(ObjectDetector::InputSide, ObjectDetector::InputSide);
+    InputBlob input(0.007843, 127.5);
+    double maxDifference = 0.0;
+    for (const cv::Mat & frame : frames)
+    {
+        // the square the pipeline cuts out of the middle of a frame, and the whole frame stretched to a square
+        for (const cv::Mat & image : { frame(middleSquare(frame.size())), frame })
+        {
+            cv::Mat reference = cv::dnn::blobFromImage(image, 0.007843, inputSize, cv::Scalar::all(127.5), false, false);
+            maxDifference = std::max(maxDifference, cv::norm(reference, input.set(&image, 1, inputSize), cv::NORM_INF));
+        }
+    }
+
+    bool passed = maxDifference == 0.0;
+    out << "input blob against blobFromImage on " << frames.size() << " frames: largest difference " << std::setprecision(4)
+        << maxDifference << (passed ? "" : "  FAILED") << "\n";
+    return passed;
+}
+
+bool runAllocationBench(const BenchSettings & settings, ostream & out)
+{
+    const AllocationCase cases[] = {
+        { "no detection", false, false, false, false },
+        { "detection", true, false, false, false },
+        { "depth view", true, true, false, false },
+        { "publisher", true, false, true, false },
+        { "recorder", true, false, false, true }
+    };
+    vector<cv::Mat> frames = loadFrames(settings);
+    out << std::fixed;
+    bool passed = compareInputBlobs(frames, out);
+
+    // the shared network instances of the application, one is enough for a single pipeline
+    NetPool pool(settings.modelDir + "/MobileNetSSD_deploy.prototxt", settings.modelDir + "/MobileNetSSD_deploy.caffemodel", 1);
+    const cv::Size inputSize(ObjectDetector::InputSide, ObjectDetector::InputSide);
+    pool.warmUp(inputSize);
+    cv::Mat image;
+    cv::resize(frames.front(), image, FrameSize);
+    double networkPerRun = networkAllocations(pool, image, std::max(10, settings.iterations));
+    double labelPerDraw = labelAllocations(image);
+    out << "a network run with its input blob allocates " << std::setprecision(1) << networkPerRun << " times on "
+        << cv::getNumThreads() << " OpenCV threads, a label " << labelPerDraw << " times, subtracted below\n";
+
+    out << std::left << setw(16) << "case" << std::right << setw(8) << "frames" << setw(14) << "allocations" << setw(10) << "runs"
+        << setw(10) << "labels" << setw(14) << "per frame" << "\n";
+    for (const AllocationCase & test : cases)
+        passed = runCase(test, settings, pool, frames.front(), networkPerRun, labelPerDraw, out) && passed;
+    out << (passed ? "the frame path allocates nothing outside of the network and the labels"
+        : "the frame path ALLOCATES outside of the network and the labels")
+        << std::endl;
+    return passed;
+}
@@ -0,0 +1,12 @@
+#pragma once
+#include <ostream>
+#include "LayerBench.h"
+
+// Run a FramePipeline with the default queues and OpenCV threads and a shared network on 1280x720 frames of the
+// corpus, the image or noise, delivered in pooled buffers as a camera does, and count the heap allocations of every
+// thread with an AllocationCounter once the first frames went through, with detection off, on, with the depth view,
+// the publisher and the recorder. The allocations of the network runs with their input blobs and of the labels drawn,
+// counted on their own, are subtracted. Also compare the input blob of InputBlob to that of cv::dnn::blobFromImage.
+// Returns false if the frame path allocates outside of the network and the labels without the publisher or the
+// recorder, which copy every frame, or the input blobs differ.
+bool runAllocationBench(const BenchSettings & settings, std::ostream & out);
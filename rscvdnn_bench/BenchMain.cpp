@@ -0,0 +1,256 @@
+#include <string>
+#include <iostream>
+#include <thread>
+#include <algorithm>
+#include <Poco/Util/Application.h>
+#include <Poco/Util/Option.h>
+#include <Poco/Util/OptionSet.h>
+#include <Poco/Util/HelpFormatter.h>
+#include "LayerBench.h"
+#include "ThroughputBench.h"
+#include "MetricsBench.h"
+#include "PublisherBench.h"
+#include "DepthCodecBench.h"
+#include "StageBench.h"
+#include "RegressionBench.h"
+#include "AllocationBench.h"
+#include "EventLogBench.h"
+#include "ProfileBench.h"
+#include "ShutdownBench.h"
+#include "CascadeBench.h"
+#include "CustomLayers.h"
+
+using std::string;
+using Poco::Util::Application;
+using Poco::Util::Option;
+using Poco::Util::OptionSet;
+using Poco::Util::OptionCallback;
+using Poco::Util::HelpFormatter;
+
+// Benchmarks of the detector building blocks, run without camera or GUI
+class BenchMain : public Application
+{
+private:
+    bool _helpRequested{ false };
+
+    void handleOptionHelp(const string & name, const string & value)
+    {
+        _helpRequested = true;
+        HelpFormatter helpFormatter(options());
+        helpFormatter.setCommand(commandName());
+        helpFormatter.setUsage("OPTIONS");
+        helpFormatter.setHeader("Benchmarks of the RealSense OpenCV DNN object detection building blocks\n"
+            "suites: depthwise, pointwise, postprocess, custom (all custom layers), fp16, throughput, metrics, publisher, depth, stages, regression, allocations, events, profiles, shutdown, cascade");
+        helpFormatter.format(std::cout);
+        stopOptionsProcessing();
+    }
+
+protected:
+    void defineOptions(OptionSet & options) override
+    {
+        Application::defineOptions(options);
+
+        options.addOption(
+            Option("help", "h", "display help information on command line arguments")
+            .required(false)
+            .repeatable(false)
+            .callback(OptionCallback<BenchMain>(this, &BenchMain::handleOptionHelp)));
+        options.addOption(
+            Option("suite", "s", "benchmark suite to run")
+            .required(false)
+            .repeatable(false)
+            .argument("name")
+            .binding("bench.suite"));
+        options.addOption(
+            Option("model-dir", "m", "folder of the MobileNet-SSD prototxt and caffemodel")
+            .required(false)
+            .repeatable(false)
+            .argument("dir")
+            .binding("bench.modelDir"));
+        options.addOption(
+            Option("image", "i", "color image used as network input, random noise if not given")
+            .required(false)
+            .repeatable(false)
+            .argument("file")
+            .binding("bench.image"));
+        options.addOption(
+            Option("iterations", "n", "number of timed runs")
+            .required(false)
+            .repeatable(false)
+            .argument("count")
+            .binding("bench.iterations"));
+        options.addOption(
+            Option("workers", "w", "largest number of parallel network instances of the throughput suite, recording threads of the metrics suite, logging threads of the events suite")
+            .required(false)
+            .repeatable(false)
+            .argument("count")
+            .binding("bench.workers"));
+        options.addOption(
+            Option("clients", "c", "number of clients subscribing to the publisher suite")
+            .required(false)
+            .repeatable(false)
+            .argument("count")
+            .binding("bench.clients"));
+        options.addOption(
+            Option("depth", "d", "comma separated 16 bit depth images, image directories or .rscvrec recordings of the depth suite")
+            .required(false)
+            .repeatable(false)
+            .argument("files")
+            .binding("bench.depth"));
+        options.addOption(
+            Option("format", "f", "results of the stages suite as text, csv or json")
+            .required(false)
+            .repeatable(false)
+            .argument("format")
+            .binding("bench.format"));
+        options.addOption(
+            Option("output", "o", "file the stages suite writes its results to instead of the console")
+            .required(false)
+            .repeatable(false)
+            .argument("file")
+            .binding("bench.output"));
+        options.addOption(
+            Option("baseline", "b", "csv results of an earlier stages run to compare against")
+            .required(false)
+            .repeatable(false)
+            .argument("file")
+            .binding("bench.baseline"));
+        options.addOption(
+            Option("threshold", "t", "percent a stage may be slower than the baseline before the stages suite fails, 10 by default")
+            .required(false)
+            .repeatable(false)
+            .argument("percent")
+            .binding("bench.threshold"));
+        options.addOption(
+            Option("corpus", "r", "directory of color and depth frames with their golden detections, replayed by the regression suite, whose color frames the cascade suite runs on")
+            .required(false)
+            .repeatable(false)
+            .argument("dir")
+            .binding("bench.corpus"));
+        options.addOption(
+            Option("update", "u", "write the golden detections of the regression corpus from this run instead of checking them")
+            .required(false)
+            .repeatable(false)
+            .binding("bench.update"));
+    }
+
+    int main(const ArgVec & args) override
+    {
+        if (_helpRequested)
+            return Application::EXIT_USAGE;
+
+        BenchSettings settings;
+        settings.modelDir = config().getString("bench.modelDir", ".");
+        settings.image = config().getString("bench.image", "");
+        settings.iterations = std::max(1, config().getInt("bench.iterations", 50));
+        settings.workers = std::max(1, config().getInt("bench.workers", (int)std::thread::hardware_concurrency()));
+        settings.clients = std::max(1, config().getInt("bench.clients", 64));
+        settings.depth = config().getString("bench.depth", "");
+        settings.format = config().getString("bench.format", "text");
+        settings.output = config().getString("bench.output", "");
+        settings.baseline = config().getString("bench.baseline", "");
+        settings.threshold = config().getDouble("bench.threshold", 10.0);
+        settings.corpus = config().getString("bench.corpus", "");
+        settings.update = config().has("bench.update");
+        string suite = config().getString("bench.suite", "depthwise");
+
+        try
+        {
+            bool passed = false;
+            if (suite == "depthwise")
+            {
+                CustomLayerSettings custom;
+                custom.depthwiseConv = true;
+                passed = runLayerBench(settings, custom, std::cout);
+            }
+            else if (suite == "pointwise")
+            {
+                CustomLayerSettings custom;
+                custom.pointwiseConv = true;
+                passed = runLayerBench(settings, custom, std::cout);
+            }
+            else if (suite == "postprocess")
+            {
+                CustomLayerSettings custom;
+                custom.cachedPriorBox = true;
+                custom.fastDetectionOutput = true;
+                passed = runLayerBench(settings, custom, std::cout);
+            }
+            else if (suite == "custom")
+            {
+                CustomLayerSettings custom;
+                custom.depthwiseConv = true;
+                custom.pointwiseConv = true;
+                custom.cachedPriorBox = true;
+                custom.fastDetectionOutput = true;
+                passed = runLayerBench(settings, custom, std::cout);
+            }
+            else if (suite == "fp16")
+            {
+                CustomLayerSettings custom;
+                custom.pointwiseConv = true;
+                passed = runPrecisionBench(settings, custom, std::cout);
+            }
+            else if (suite == "throughput")
+            {
+                CustomLayerSettings custom;
+                custom.depthwiseConv = true;
+                custom.pointwiseConv = true;
+                passed = runThroughputBench(settings, custom, std::cout);
+            }
+            else if (suite == "metrics")
+            {
+                passed = runMetricsBench(settings, std::cout);
+            }
+            else if (suite == "publisher")
+            {
+                passed = runPublisherBench(settings, std::cout);
+            }
+            else if (suite == "depth")
+            {
+                passed = runDepthCodecBench(settings, std::cout);
+            }
+            else if (suite == "stages")
+            {
+                passed = runStageBench(settings, std::cout);
+            }
+            else if (suite == "regression")
+            {
+                passed = runRegressionBench(settings, std::cout);
+            }
+            else if (suite == "allocations")
+            {
+                passed = runAllocationBench(settings, std::cout);
+            }
+            else if (suite == "events")
+            {
+                passed = runEventLogBench(settings, std::cout);
+            }
+            else if (suite == "profiles")
+            {
+                passed = runProfileBench(settings, std::cout);
+            }
+            else if (suite == "shutdown")
+            {
+                passed = runShutdownBench(settings, std::cout);
+            }
+            else if (suite == "cascade")
+            {
+                passed = runCascadeBench(settings, std::cout);
+            }
+            else
+            {
+                std::cerr << "unknown benchmark suite " << suite << std::endl;
+                return Application::EXIT_USAGE;
+            }
+            return passed ? Application::EXIT_OK : Application::EXIT_DATAERR;
+        }
+        catch (std::exception & e)
+        {
+            std::cerr << e.what() << std::endl;
+            return Application::EXIT_SOFTWARE;
+        }
+    }
+};
+
+POCO_APP_MAIN(BenchMain)
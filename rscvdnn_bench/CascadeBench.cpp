@@ -0,0 +1,63 @@
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <ostream>
+#include <iomanip>
+#include <Poco/AutoPtr.h>
+#include <Poco/Util/MapConfiguration.h>
+#include <opencv2/opencv.hpp>
+#include "CascadeBench.h"
+#include "ObjectDetector.h"
+
+using std::string;
+using std::vector;
+using std::ostream;
+using std::setw;
+
+// recall of the single stage objects below which the cascade loses too much
+static const double MinRecall = 0.9;
+
+bool runCascadeBench(const BenchSettings & settings, ostream & out)
+{
+    vector<cv::Mat> frames = loadFrames(settings);
+    string prototxt = settings.modelDir + "/MobileNetSSD_deploy.prototxt";
+    string caffemodel = settings.modelDir + "/MobileNetSSD_deploy.caffemodel";
+
+    bool passed = true;
+    out << std::left << setw(10) << "cascade" << std::right << setw(8) << "frames" << setw(10) << "rejected" << setw(12) << "cascade ms"
+        << setw(12) << "single ms" << setw(10) << "saved" << setw(10) << "recall" << "\n" << std::fixed;
+    for (bool zoom : { false, true })
+    {
+        // every frame is verified, the single stage path is the reference of both cost and recall
+        Poco::AutoPtr<Poco::Util::MapConfiguration> config(new Poco::Util::MapConfiguration);
+        config->setBool("cascade.enabled", true);
+        config->setBool("cascade.zoom", zoom);
+        config->setInt("cascade.verifyInterval", 1);
+        ObjectDetector detector(*config);
+        detector.loadModel(prototxt, caffemodel);
+        // the first forward of either network allocates its blobs
+        detector.detect(frames.front());
+
+        CascadeStats before = detector.cascadeStats();
+        size_t runs = std::max<size_t>(settings.iterations, frames.size());
+        for (size_t i = 0; i < runs; i++)
+            detector.detect(frames[i % frames.size()]);
+        const CascadeStats & after = detector.cascadeStats();
+
+        uint64_t count = after.frames - before.frames;
+        uint64_t rejected = after.rejected - before.rejected;
+        double cascadeMs = (after.cascadeMs - before.cascadeMs) / count;
+        double singleMs = (after.singleStageMs - before.singleStageMs) / (after.verifiedFrames - before.verifiedFrames);
+        uint64_t reference = after.referenceObjects - before.referenceObjects;
+        double recall = (reference > 0) ? (double)(after.recalledObjects - before.recalledObjects) / reference : 1.0;
+        bool ok = recall >= MinRecall;
+        passed = passed && ok;
+        out << std::left << setw(10) << (zoom ? "zoom" : "full") << std::right << setw(8) << count
+            << std::setprecision(0) << setw(9) << 100.0 * rejected / count << "%"
+            << std::setprecision(2) << setw(12) << cascadeMs << setw(12) << singleMs
+            << std::setprecision(0) << setw(9) << 100.0 * (1.0 - cascadeMs / singleMs) << "%"
+            << setw(9) << 100.0 * recall << "%" << (reference > 0 ? "" : " (no objects)") << (ok ? "" : "  FAILED") << "\n";
+    }
+    out << (passed ? "the cascade recalls the single stage objects" : "the cascade MISSES single stage objects") << std::endl;
+    return passed;
+}
@@ -0,0 +1,9 @@
+#pragma once
+#include <ostream>
+#include "LayerBench.h"
+
+// Run the detector with the coarse-to-fine cascade, with and without zoom, verifying every frame against the single
+// stage path, over the <name>_color.png frames of settings.corpus, settings.image or random noise, and report the
+// cascade statistics, frames rejected by the coarse pass, ms per frame of the cascade and of the single stage path,
+// and the recall of the single stage objects. Returns false if the recall is below 90%.
+bool runCascadeBench(const BenchSettings & settings, std::ostream & out);
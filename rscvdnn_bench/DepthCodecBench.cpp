@@ -0,0 +1,181 @@
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <ostream>
+#include <iomanip>
+#include <Poco/DirectoryIterator.h>
+#include <Poco/File.h>
+#include <Poco/Path.h>
+#include <Poco/String.h>
+#include <Poco/StringTokenizer.h>
+#include <opencv2/opencv.hpp>
+#include "DepthCodecBench.h"
+#include "DepthCodec.h"
+#include "ConvKernels.h"
+#include "Recording.h"
+
+using std::string;
+using std::vector;
+using std::ostream;
+using std::setw;
+using Poco::StringTokenizer;
+
+// frames taken from a directory or recording, spread over its length
+static const size_t FramesPerScene = 30;
+
+struct DepthScene
+{
+    string name;
+    vector<cv::Mat> frames;
+};
+
+// a floor, a wall and boxes at 0.5 to 4 m with 1 mm units, sensor noise growing with the distance and holes
+// along the depth edges and where the projector does not reach
+static DepthScene syntheticScene()
+{
+    DepthScene scene{ "synthetic 848x480", {} };
+    cv::RNG rng(42);
+    for (int f = 0; f < 8; f++)
+    {
+        cv::Mat depth(480, 848, CV_16UC1);
+        for (int y = 0; y < depth.rows; y++)
+        {
+            uint16_t *row = depth.ptr<uint16_t>(y);
+            for (int x = 0; x < depth.cols; x++)
+            {
+                double z = (y > 240) ? 4000.0 * 240 / (y - 200) / 6 + 500 : 4000.0;
+                int box = (x + 8 * f) / 160;
+                if (y > 150 && y < 380 && box % 2 == 1)
+                    z = 1200.0 + 300 * box;
+                z += rng.gaussian(z * z / 4e6);
+                row[x] = (x < 40 || rng.uniform(0, 50) == 0) ? 0 : cv::saturate_cast<uint16_t>(z);
+            }
+        }
+        scene.frames.push_back(depth);
+    }
+    return scene;
+}
+
+static DepthScene loadScene(const string & path)
+{
+    DepthScene scene{ Poco::Path(path).getFileName(), {} };
+    if (Poco::File(path).isDirectory())
+    {
+        vector<string> images;
+        for (Poco::DirectoryIterator it(path), end; it != end; ++it)
+        {
+            const string & name = it.name();
+            if (name.size() > 10 && Poco::icompare(name.substr(name.size() - 10), "_depth.png") == 0)
+                images.push_back(it.path().toString());
+        }
+        std::sort(images.begin(), images.end());
+        size_t step = std::max<size_t>(1, images.size() / FramesPerScene);
+        for (size_t i = 0; i < images.size() && scene.frames.size() < FramesPerScene; i += step)
+            scene.frames.push_back(cv::imread(images[i], cv::IMREAD_ANYDEPTH));
+    }
+    else if (Poco::icompare(Poco::Path(path).getExtension(), "rscvrec") == 0)
+    {
+        RecordingReader reader(path);
+        size_t step = std::max<size_t>(1, reader.frameCount() / FramesPerScene);
+        for (size_t i = 0; i < reader.frameCount() && scene.frames.size() < FramesPerScene; i += step)
+        {
+            cv::Mat depth = reader.frame(i).depth;
+            if (!depth.empty())
+                scene.frames.push_back(depth);
+        }
+    }
+    else
+        scene.frames.push_back(cv::imread(path, cv::IMREAD_ANYDEPTH));
+
+    for (const cv::Mat & frame : scene.frames)
+    {
+        if (frame.type() != CV_16UC1)
+            throw std::runtime_error(path + " has no 16 bit depth");
+    }
+    if (scene.frames.empty())
+        throw std::runtime_error(path + " has no depth frames");
+    return scene;
+}
+
+static double elapsedMs(int64 tickStart)
+{
+    return (cv::getTickCount() - tickStart) * 1000.0 / cv::getTickFrequency();
+}
+
+bool runDepthCodecBench(const BenchSettings & settings, ostream & out)
+{
+    vector<DepthScene> scenes;
+    StringTokenizer paths(settings.depth, ",", StringTokenizer::TOK_TRIM | StringTokenizer::TOK_IGNORE_EMPTY);
+    for (const string & path : paths)
+        scenes.push_back(loadScene(path));
+    if (scenes.empty())
+        scenes.push_back(syntheticScene());
+
+    bool avx2 = cpuHasAvx2();
+    out << std::fixed << std::setprecision(2);
+    out << setw(24) << "scene" << setw(8) << "frames" << setw(10) << "RVL x" << setw(14) << "enc MB/s"
+        << setw(14) << "enc AVX2 MB/s" << setw(14) << "dec MB/s" << setw(10) << "PNG x" << setw(14) << "PNG enc MB/s" << "\n";
+    bool passed = true;
+    for (const DepthScene & scene : scenes)
+    {
+        double rawMB = 0.0;
+        size_t rvlBytes = 0, pngBytes = 0;
+        double scalarMs = 0.0, avx2Ms = 0.0, decodeMs = 0.0, pngMs = 0.0;
+        vector<uint8_t> scalar, vectorized;
+        vector<uchar> png;
+        cv::Mat decoded;
+        for (const cv::Mat & frame : scene.frames)
+        {
+            cv::Mat depth = frame.isContinuous() ? frame : frame.clone();
+            size_t pixels = depth.total();
+            scalar.resize(rvlMaxEncodedSize(pixels));
+            vectorized.resize(rvlMaxEncodedSize(pixels));
+            size_t scalarSize = 0, avx2Size = 0;
+            for (int i = 0; i < settings.iterations; i++)
+            {
+                int64 tickStart = cv::getTickCount();
+                scalarSize = rvlEncode(depth.ptr<uint16_t>(), pixels, scalar.data(), false);
+                scalarMs += elapsedMs(tickStart);
+                if (avx2)
+                {
+                    tickStart = cv::getTickCount();
+                    avx2Size = rvlEncode(depth.ptr<uint16_t>(), pixels, vectorized.data(), true);
+                    avx2Ms += elapsedMs(tickStart);
+                }
+                tickStart = cv::getTickCount();
+                bool ok = decodeDepthRvl(scalar.data(), scalarSize, depth.size(), decoded);
+                decodeMs += elapsedMs(tickStart);
+                passed = passed && ok;
+            }
+            if (avx2 && (avx2Size != scalarSize || !std::equal(scalar.begin(), scalar.begin() + scalarSize, vectorized.begin())))
+            {
+                out << scene.name << ": AVX2 stream DIFFERS from the scalar one\n";
+                passed = false;
+            }
+            if (cv::countNonZero(decoded != depth) > 0)
+            {
+                out << scene.name << ": decoded frame DIFFERS from the original\n";
+                passed = false;
+            }
+            int64 tickStart = cv::getTickCount();
+            cv::imencode(".png", depth, png, { cv::IMWRITE_PNG_COMPRESSION, 1 });
+            pngMs += elapsedMs(tickStart);
+            rawMB += pixels * 2 / 1e6;
+            rvlBytes += scalarSize;
+            pngBytes += png.size();
+        }
+
+        double runs = settings.iterations;
+        double rawBytes = rawMB * 1e6;
+        out << setw(24) << scene.name << setw(8) << scene.frames.size() << setw(10) << rawBytes / rvlBytes
+            << setw(14) << rawMB * runs / (scalarMs / 1000.0) << setw(14);
+        if (avx2)
+            out << rawMB * runs / (avx2Ms / 1000.0);
+        else
+            out << "n/a";
+        out << setw(14) << rawMB * runs / (decodeMs / 1000.0) << setw(10) << rawBytes / pngBytes
+            << setw(14) << rawMB / (pngMs / 1000.0) << "\n";
+    }
+    out << (passed ? "every frame decoded to the original" : "depth codec FAILED") << std::endl;
+    return passed;
+}
@@ -0,0 +1,9 @@
+#pragma once
+#include <ostream>
+#include "LayerBench.h"
+
+// Compress the depth frames of every scene in settings.depth, 16 bit PNG images, directories of *_depth.png images
+// or .rscvrec recordings, or of a synthetic scene if none is given, settings.iterations times with RVL, scalar and
+// AVX2, and once with PNG for comparison. Reports the compression ratio and the encode and decode rates in MB/s of
+// raw depth. Returns false if a frame does not decode to the original or the AVX2 stream differs from the scalar one.
+bool runDepthCodecBench(const BenchSettings & settings, std::ostream & out);
@@ -0,0 +1,111 @@
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <thread>
+#include <chrono>
+#include <sstream>
+#include <ostream>
+#include <iomanip>
+#include <Poco/AutoPtr.h>
+#include <Poco/Logger.h>
+#include <Poco/Message.h>
+#include <Poco/NullChannel.h>
+#include <Poco/TemporaryFile.h>
+#include <Poco/Util/MapConfiguration.h>
+#include "EventLogBench.h"
+#include "EventLog.h"
+#include "Metrics.h"
+#include "StageTrace.h"
+
+using std::string;
+using std::vector;
+using std::ostream;
+using std::setw;
+using Poco::Logger;
+
+// events of one burst, well below what a thread ring holds
+static const int BurstEvents = 1000;
+
+// ns per event of threads logging settings.iterations bursts each through log
+template <typename Log>
+static double timeThreads(int threads, int bursts, Log log)
+{
+    vector<double> ns(threads, 0.0);
+    vector<std::thread> loggers;
+    for (int t = 0; t < threads; t++)
+    {
+        loggers.emplace_back([&ns, bursts, t, &log]()
+        {
+            for (int burst = 0; burst < bursts; burst++)
+            {
+                int64_t start = traceNow();
+                for (int i = 0; i < BurstEvents; i++)
+                    log(t, (uint64_t)burst * BurstEvents + i);
+                ns[t] += (double)(traceNow() - start);
+                // the writer drains between bursts, as it does between frames
+                std::this_thread::sleep_for(std::chrono::milliseconds(2));
+            }
+        });
+    }
+    for (std::thread & logger : loggers)
+        logger.join();
+    double total = 0.0;
+    for (double threadNs : ns)
+        total += threadNs;
+    return total / ((double)threads * bursts * BurstEvents);
+}
+
+bool runEventLogBench(const BenchSettings & settings, ostream & out)
+{
+    Poco::TemporaryFile path;
+    Poco::AutoPtr<Poco::Util::MapConfiguration> config(new Poco::Util::MapConfiguration);
+    config->setString("path", path.path());
+    config->setInt("flushMs", 1);
+    // only the binary log, formatting into the channels is what the Poco column measures
+    Logger & eventLogger = Logger::get("EventLog");
+    int level = eventLogger.getLevel();
+    eventLogger.setLevel(Poco::Message::PRIO_INFORMATION);
+    MetricCounter & dropped = metrics().counter("rscvdnn_event_log_dropped_total", "Events dropped by a full event ring");
+    uint64_t droppedBefore = dropped.value();
+
+    // the text of a stage event through a logger discarding it, what logging every frame costs without the event log
+    Logger & pocoLogger = Logger::get("bench.eventLog");
+    pocoLogger.setChannel(new Poco::NullChannel);
+    pocoLogger.setLevel(Poco::Message::PRIO_DEBUG);
+
+    EventLogWriter writer(*config);
+    writer.start();
+    uint64_t logged = 0;
+    out << std::fixed << std::setprecision(1);
+    out << setw(10) << "threads" << setw(18) << "event log ns" << setw(18) << "poco ns" << "\n";
+    for (int threads = 1; ; threads = std::min(threads * 2, settings.workers))
+    {
+        double eventNs = timeThreads(threads, settings.iterations, [](int t, uint64_t frame)
+        {
+            logEvent(EventId::StageDone, t, frame, StageInference, (int64_t)(frame % 50000000));
+        });
+        logged += (uint64_t)threads * settings.iterations * BurstEvents;
+        double pocoNs = timeThreads(threads, settings.iterations, [&pocoLogger](int t, uint64_t frame)
+        {
+            std::ostringstream text;
+            text << "camera " << t << " frame " << frame << ": inference took " << std::setprecision(3) << (frame % 50000000) / 1e6 << " ms";
+            pocoLogger.debug(text.str());
+        });
+        out << setw(10) << threads << setw(18) << eventNs << setw(18) << pocoNs << "\n";
+        if (threads == settings.workers)
+            break;
+    }
+    writer.stop();
+    eventLogger.setLevel(level);
+
+    // every event that made it into a ring has to come back out of the file
+    std::ostringstream decoded;
+    decodeEventLog(path.path(), decoded);
+    string text = decoded.str();
+    uint64_t lines = (uint64_t)std::count(text.begin(), text.end(), '\n');
+    uint64_t lost = dropped.value() - droppedBefore;
+    bool passed = lines == logged - lost;
+    out << logged << " events logged, " << lost << " dropped by full rings, " << lines << " decoded\n"
+        << (passed ? "the log decodes to every event kept" : "the log LOST events") << std::endl;
+    return passed;
+}
@@ -0,0 +1,8 @@
+#pragma once
+#include <ostream>
+#include "LayerBench.h"
+
+// Log per-frame events from 1 to settings.workers threads in bursts the writer drains in between, and report the
+// cost of one event next to formatting the same text through a Poco logger. The events go to a temporary binary
+// log, which has to decode to every event not dropped. Returns false if it does not.
+bool runEventLogBench(const BenchSettings & settings, std::ostream & out);
@@ -0,0 +1,345 @@
+#include <string>
+#include <vector>
+#include <ostream>
+#include <iomanip>
+#include <sstream>
+#include <cmath>
+#include <algorithm>
+#include <stdexcept>
+#include <Poco/DirectoryIterator.h>
+#include <Poco/File.h>
+#include <Poco/String.h>
+#include <opencv2/opencv.hpp>
+#include <opencv2/dnn.hpp>
+#include "LayerBench.h"
+#include "CachedPriorBoxLayer.h"
+#include "CustomLayers.h"
+#include "DepthwiseConvLayer.h"
+#include "FastDetectionOutputLayer.h"
+#include "ObjectDetector.h"
+#include "PointwiseConvLayer.h"
+
+using std::string;
+using std::vector;
+using std::ostream;
+using std::setw;
+
+cv::Mat loadInputBlob(const BenchSettings & settings)
+{
+    cv::Mat image;
+    if (settings.image.empty())
+    {
+        image.create(1080, 1920, CV_8UC3);
+        cv::randu(image, cv::Scalar::all(0), cv::Scalar::all(256));
+    }
+    else
+    {
+        image = cv::imread(settings.image, cv::IMREAD_COLOR);
+        if (image.empty())
+            throw std::runtime_error("cannot read image " + settings.image);
+    }
+    return cv::dnn::blobFromImage(image, 0.007843, cv::Size(300, 300), 127.5, false);
+}
+
+// the color frames of the corpus, the image, or a frame of random noise
+vector<cv::Mat> loadFrames(const BenchSettings & settings)
+{
+    vector<string> paths;
+    if (!settings.corpus.empty())
+    {
+        if (!Poco::File(settings.corpus).isDirectory())
+            throw std::runtime_error(settings.corpus + " is not a directory");
+        for (Poco::DirectoryIterator it(settings.corpus), end; it != end; ++it)
+        {
+            const string & name = it.name();
+            if (name.size() > 10 && Poco::icompare(name.substr(name.size() - 10), "_color.png") == 0)
+                paths.push_back(it.path().toString());
+        }
+        std::sort(paths.begin(), paths.end());
+    }
+    else if (!settings.image.empty())
+        paths.push_back(settings.image);
+
+    vector<cv::Mat> frames;
+    for (const string & path : paths)
+    {
+        frames.push_back(cv::imread(path, cv::IMREAD_COLOR));
+        if (frames.back().empty())
+            throw std::runtime_error("cannot read image " + path);
+    }
+    if (frames.empty())
+    {
+        cv::Mat noise(ObjectDetector::InputSide, ObjectDetector::InputSide, CV_8UC3);
+        cv::randu(noise, cv::Scalar::all(0), cv::Scalar::all(255));
+        frames.push_back(noise);
+    }
+    return frames;
+}
+
+cv::dnn::Net loadNet(const BenchSettings & settings, const CustomLayerSettings & custom)
+{
+    registerCustomLayers(custom);
+    cv::dnn::Net net = cv::dnn::readNetFromCaffe(settings.modelDir + "/MobileNetSSD_deploy.prototxt",
+        settings.modelDir + "/MobileNetSSD_deploy.caffemodel");
+    // layers are only instantiated on first use, which must happen while the custom ones are registered, otherwise
+    // the custom net runs the stock layers and every comparison is stock against stock
+    bool depthwise = false, pointwise = false, priorBox = false, detectionOutput = false;
+    for (const cv::String & name : net.getLayerNames())
+    {
+        cv::Ptr<cv::dnn::Layer> layer = net.getLayer(net.getLayerId(name));
+        depthwise = depthwise || !layer.dynamicCast<DepthwiseConvLayer>().empty();
+        pointwise = pointwise || !layer.dynamicCast<PointwiseConvLayer>().empty();
+        priorBox = priorBox || !layer.dynamicCast<CachedPriorBoxLayer>().empty();
+        detectionOutput = detectionOutput || !layer.dynamicCast<FastDetectionOutputLayer>().empty();
+    }
+    unregisterCustomLayers();
+    // every custom layer asked for has to be in the net, one missing would be timed and compared as stock
+    if ((custom.depthwiseConv && !depthwise) || (custom.pointwiseConv && !pointwise) || (custom.cachedPriorBox && !priorBox)
+        || (custom.fastDetectionOutput && !detectionOutput))
+        throw std::runtime_error("a custom layer asked for was not instantiated, the model would run the stock one");
+    return net;
+}
+
+// average milliseconds of each layer, in the order of Net::getLayerNames()
+static vector<double> profileLayers(cv::dnn::Net & net, const cv::Mat & blob, int iterations, double & totalMs)
+{
+    // the first forward allocates the blobs and is not representative
+    net.setInput(blob, "data");
+    net.forward("detection_out");
+
+    const double ticksPerMs = cv::getTickFrequency() / 1000.0;
+    vector<double> layerMs;
+    totalMs = 0.0;
+    for (int i = 0; i < iterations; i++)
+    {
+        net.setInput(blob, "data");
+        net.forward("detection_out");
+        vector<double> timings;
+        totalMs += net.getPerfProfile(timings) / ticksPerMs;
+        layerMs.resize(timings.size(), 0.0);
+        for (size_t k = 0; k < timings.size(); k++)
+            layerMs[k] += timings[k] / ticksPerMs;
+    }
+
+    for (double & ms : layerMs)
+        ms /= iterations;
+    totalMs /= iterations;
+    return layerMs;
+}
+
+static string shapeString(const cv::dnn::MatShape & shape)
+{
+    std::ostringstream ss;
+    for (size_t i = 0; i < shape.size(); i++)
+        ss << (i > 0 ? "x" : "") << shape[i];
+    return ss.str();
+}
+
+// rows of a detection output blob that hold an object, [image_id, label, confidence, box]
+static cv::Mat validDetections(const cv::Mat & detection)
+{
+    cv::Mat rows(detection.size[2], detection.size[3], CV_32F, (void*)detection.ptr<float>());
+    cv::Mat valid;
+    for (int i = 0; i < rows.rows; i++)
+    {
+        if (rows.at<float>(i, 0) >= 0.0f && rows.at<float>(i, 2) > 0.0f)
+            valid.push_back(rows.row(i));
+    }
+    return valid;
+}
+
+// largest difference of two layer outputs, the magnitude of stock if they cannot be compared at all
+static double outputDifference(const cv::String & name, const cv::Mat & stock, const cv::Mat & custom)
+{
+    cv::Mat a = stock.reshape(1, 1);
+    cv::Mat b = custom.reshape(1, 1);
+    if (name == "detection_out")
+    {
+        // detection outputs may differ in the number of empty rows
+        a = validDetections(stock);
+        b = validDetections(custom);
+        if (a.empty() && b.empty())
+            return 0.0;
+    }
+
+    if (a.size() != b.size())
+        return std::max(1.0, cv::norm(stock, cv::NORM_INF));
+    return cv::norm(a, b, cv::NORM_INF);
+}
+
+bool runLayerBench(const BenchSettings & settings, const CustomLayerSettings & custom, ostream & out)
+{
+    cv::Mat blob = loadInputBlob(settings);
+    cv::dnn::Net stockNet = loadNet(settings, CustomLayerSettings());
+    cv::dnn::Net customNet = loadNet(settings, custom);
+
+    // requesting a layer output keeps it from being fused, so the outputs are compared in a separate run
+    vector<cv::String> layerNames = customNet.getLayerNames();
+    vector<cv::String> customNames;
+    for (const cv::String & name : layerNames)
+    {
+        if (isCustomLayer(customNet.getLayer(customNet.getLayerId(name))))
+            customNames.push_back(name);
+    }
+    customNames.push_back("detection_out");
+
+    vector<cv::Mat> stockOutputs, customOutputs;
+    stockNet.setInput(blob, "data");
+    stockNet.forward(stockOutputs, customNames);
+    customNet.setInput(blob, "data");
+    customNet.forward(customOutputs, customNames);
+
+    double stockTotal = 0.0;
+    double customTotal = 0.0;
+    vector<double> stockMs = profileLayers(stockNet, blob, settings.iterations, stockTotal);
+    vector<double> customMs = profileLayers(customNet, blob, settings.iterations, customTotal);
+
+    // fused layers run inside their predecessor and show 0 ms
+    bool passed = true;
+    cv::dnn::MatShape inputShape = cv::dnn::shape(blob.size[0], blob.size[1], blob.size[2], blob.size[3]);
+    out << std::left << setw(36) << "layer" << setw(18) << "output" << std::right << setw(12) << "stock ms"
+        << setw(12) << "custom ms" << setw(10) << "speedup" << setw(14) << "max diff" << "\n";
+    out << std::fixed;
+    for (size_t i = 0; i < layerNames.size() && i < stockMs.size() && i < customMs.size(); i++)
+    {
+        vector<cv::dnn::MatShape> inShapes, outShapes;
+        customNet.getLayerShapes(inputShape, customNet.getLayerId(layerNames[i]), inShapes, outShapes);
+        out << std::left << setw(36) << layerNames[i] << setw(18) << (outShapes.empty() ? string() : shapeString(outShapes[0]))
+            << std::right << std::setprecision(3) << setw(12) << stockMs[i] << setw(12) << customMs[i];
+        if (customMs[i] > 0.0 && stockMs[i] > 0.0)
+            out << setw(9) << std::setprecision(2) << stockMs[i] / customMs[i] << "x";
+        else
+            out << setw(10) << "-";
+
+        auto found = std::find(customNames.begin(), customNames.end(), layerNames[i]);
+        if (found != customNames.end())
+        {
+            size_t k = found - customNames.begin();
+            // tolerance relative to the magnitude of the layer output, summation order differs from the stock GEMM
+            double scale = std::max(1.0, cv::norm(stockOutputs[k], cv::NORM_INF));
+            double diff = outputDifference(customNames[k], stockOutputs[k], customOutputs[k]);
+            out << std::scientific << std::setprecision(2) << setw(14) << diff << std::fixed;
+            if (diff > 1e-4 * scale)
+            {
+                out << "  MISMATCH";
+                passed = false;
+            }
+        }
+        out << "\n";
+    }
+
+    out << std::left << setw(54) << "forward" << std::right << std::setprecision(3) << setw(12) << stockTotal << setw(12) << customTotal
+        << setw(9) << std::setprecision(2) << stockTotal / customTotal << "x\n";
+    out << (passed ? "custom layer outputs match the stock layers" : "custom layer outputs DIFFER from the stock layers") << std::endl;
+    return passed;
+}
+
+static float detectionIoU(const float *a, const float *b)
+{
+    float w = std::min(a[5], b[5]) - std::max(a[3], b[3]);
+    float h = std::min(a[6], b[6]) - std::max(a[4], b[4]);
+    if (w <= 0.0f || h <= 0.0f)
+        return 0.0f;
+    float intersection = w * h;
+    return intersection / ((a[5] - a[3]) * (a[6] - a[4]) + (b[5] - b[3]) * (b[6] - b[4]) - intersection);
+}
+
+// bytes of the weights a layer holds, the packed ones of a custom layer, Net::getMemoryConsumption counts those of the
+// parameters the layer was created from
+static size_t layerWeightBytes(cv::dnn::Net & net, const cv::String & name)
+{
+    size_t bytes = 0;
+    for (const cv::Mat & weights : net.getLayer(net.getLayerId(name))->blobs)
+        bytes += weights.total() * weights.elemSize();
+    return bytes;
+}
+
+bool runPrecisionBench(const BenchSettings & settings, const CustomLayerSettings & custom, ostream & out)
+{
+    // detections below this confidence are not compared, boxes of the same object must overlap at least MinIoU
+    const float MinConfidence = 0.3f;
+    const float MinIoU = 0.9f;
+    const float MaxConfidenceDiff = 0.02f;
+
+    CustomLayerSettings half = custom;
+    half.fp16Weights = true;
+    cv::Mat blob = loadInputBlob(settings);
+    cv::dnn::Net floatNet = loadNet(settings, CustomLayerSettings());
+    cv::dnn::Net halfNet = loadNet(settings, half);
+
+    floatNet.setInput(blob, "data");
+    cv::Mat floatDetections = validDetections(floatNet.forward("detection_out"));
+    halfNet.setInput(blob, "data");
+    cv::Mat halfDetections = validDetections(halfNet.forward("detection_out"));
+
+    double floatTotal = 0.0;
+    double halfTotal = 0.0;
+    profileLayers(floatNet, blob, settings.iterations, floatTotal);
+    profileLayers(halfNet, blob, settings.iterations, halfTotal);
+
+    // memory of every layer, the weights it holds and the output blobs as the net reports them
+    cv::dnn::MatShape inputShape = cv::dnn::shape(blob.size[0], blob.size[1], blob.size[2], blob.size[3]);
+    out << std::left << setw(36) << "layer" << std::right << setw(14) << "fp32 weights" << setw(14) << "fp16 weights"
+        << setw(14) << "fp32 blobs" << setw(14) << "fp16 blobs" << "\n";
+    size_t totals[4] = { 0, 0, 0, 0 };
+    for (const cv::String & name : halfNet.getLayerNames())
+    {
+        size_t sizes[4];
+        size_t parameters = 0;
+        floatNet.getMemoryConsumption(floatNet.getLayerId(name), inputShape, parameters, sizes[2]);
+        halfNet.getMemoryConsumption(halfNet.getLayerId(name), inputShape, parameters, sizes[3]);
+        sizes[0] = layerWeightBytes(floatNet, name);
+        sizes[1] = layerWeightBytes(halfNet, name);
+        out << std::left << setw(36) << name << std::right;
+        for (int k = 0; k < 4; k++)
+        {
+            out << setw(12) << sizes[k] / 1024 << "kB";
+            totals[k] += sizes[k];
+        }
+        out << "\n";
+    }
+    out << std::left << setw(36) << "total" << std::right;
+    for (int k = 0; k < 4; k++)
+        out << setw(12) << totals[k] / 1024 << "kB";
+    out << "\n";
+
+    // every confident float detection must be found again with a nearly identical box and confidence
+    int compared = 0;
+    int matched = 0;
+    float worstIoU = 1.0f;
+    float worstConfidenceDiff = 0.0f;
+    for (int i = 0; i < floatDetections.rows; i++)
+    {
+        const float *reference = floatDetections.ptr<float>(i);
+        if (reference[2] < MinConfidence)
+            continue;
+        compared++;
+        int best = -1;
+        float bestIoU = 0.0f;
+        for (int k = 0; k < halfDetections.rows; k++)
+        {
+            const float *candidate = halfDetections.ptr<float>(k);
+            float iou = detectionIoU(reference, candidate);
+            if (candidate[1] == reference[1] && iou > bestIoU)
+            {
+                best = k;
+                bestIoU = iou;
+            }
+        }
+        worstIoU = std::min(worstIoU, bestIoU);
+        if (best >= 0)
+        {
+            float confidenceDiff = std::abs(halfDetections.at<float>(best, 2) - reference[2]);
+            worstConfidenceDiff = std::max(worstConfidenceDiff, confidenceDiff);
+            if (bestIoU >= MinIoU && confidenceDiff <= MaxConfidenceDiff)
+                matched++;
+        }
+    }
+
+    bool passed = (matched == compared);
+    out << std::fixed << std::setprecision(3) << "forward fp32 " << floatTotal << " ms, fp16 weights " << halfTotal << " ms\n"
+        << "detections above " << MinConfidence << ": " << compared << ", matched " << matched
+        << ", worst IoU " << worstIoU << ", worst confidence difference " << worstConfidenceDiff << "\n"
+        << (passed ? "fp16 detections match the fp32 detections" : "fp16 detections DIFFER from the fp32 detections") << std::endl;
+    return passed;
+}
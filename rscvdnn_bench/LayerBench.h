@@ -0,0 +1,48 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <ostream>
+#include <opencv2/core.hpp>
+#include <opencv2/dnn.hpp>
+#include "CustomLayers.h"
+
+struct BenchSettings
+{
+    // folder of MobileNetSSD_deploy.prototxt and MobileNetSSD_deploy.caffemodel
+    std::string modelDir;
+    // real frame to feed the network, random noise if empty
+    std::string image;
+    int iterations;
+    // largest number of pool workers the throughput suite scales up to
+    int workers;
+    // subscribers connected to the publisher suite
+    int clients;
+    // depth images, image directories or recordings of the depth codec suite, comma separated, synthetic if empty
+    std::string depth;
+    // results of the stages suite, text, csv or json, written to output, or the console if empty
+    std::string format;
+    std::string output;
+    // csv results of an earlier stages run, a stage slower than it by more than threshold percent fails
+    std::string baseline;
+    double threshold;
+    // directory of the regression corpus, and whether to write its golden detections instead of checking them
+    std::string corpus;
+    bool update;
+};
+
+// network input blob of the configured image, or of random noise
+cv::Mat loadInputBlob(const BenchSettings & settings);
+// the color frames of the corpus, the image, or a frame of random noise
+std::vector<cv::Mat> loadFrames(const BenchSettings & settings);
+// the model in settings.modelDir with the custom layers enabled in custom
+cv::dnn::Net loadNet(const BenchSettings & settings, const CustomLayerSettings & custom);
+
+// Run the model with the stock layers and with the custom layers enabled in custom on the same input,
+// report the average time of every layer side by side, and the largest difference of each custom layer output.
+// Returns false if any output differs beyond the float tolerance.
+bool runLayerBench(const BenchSettings & settings, const CustomLayerSettings & custom, std::ostream & out);
+
+// Run the model with the custom layers enabled in custom and their weights stored as half floats against the stock
+// float model, report the weights and blob memory of every layer for both, and compare the detections.
+// Returns false if a confident float detection has no close match among the half float detections.
+bool runPrecisionBench(const BenchSettings & settings, const CustomLayerSettings & custom, std::ostream & out);
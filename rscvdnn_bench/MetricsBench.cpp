@@ -0,0 +1,117 @@
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <thread>
+#include <atomic>
+#include <sstream>
+#include <ostream>
+#include <iomanip>
+#include <Poco/AutoPtr.h>
+#include <Poco/StreamCopier.h>
+#include <Poco/Net/HTTPClientSession.h>
+#include <Poco/Net/HTTPRequest.h>
+#include <Poco/Net/HTTPResponse.h>
+#include <Poco/Util/MapConfiguration.h>
+#include <opencv2/core.hpp>
+#include "MetricsBench.h"
+#include "Metrics.h"
+#include "MetricsServer.h"
+
+using std::string;
+using std::vector;
+using std::ostream;
+using std::setw;
+using Poco::Net::HTTPClientSession;
+using Poco::Net::HTTPRequest;
+using Poco::Net::HTTPResponse;
+
+// body of GET /metrics, empty if the response is not 200
+static string scrape(unsigned short port)
+{
+    HTTPClientSession session("127.0.0.1", port);
+    HTTPRequest request(HTTPRequest::HTTP_GET, "/metrics", HTTPRequest::HTTP_1_1);
+    session.sendRequest(request);
+    HTTPResponse response;
+    std::istream & body = session.receiveResponse(response);
+    string text;
+    Poco::StreamCopier::copyToString(body, text);
+    return (response.getStatus() == HTTPResponse::HTTP_OK) ? text : string();
+}
+
+// value of the sample line starting with series, -1 if missing
+static double sampleValue(const string & text, const string & series)
+{
+    std::istringstream lines(text);
+    string line;
+    while (std::getline(lines, line))
+    {
+        if (line.compare(0, series.size() + 1, series + " ") == 0)
+            return std::stod(line.substr(series.size() + 1));
+    }
+    return -1.0;
+}
+
+bool runMetricsBench(const BenchSettings & settings, ostream & out)
+{
+    MetricsRegistry registry;
+    MetricCounter & samples = registry.counter("bench_samples_total", "Samples recorded");
+    LatencyHistogram & latency = registry.histogram("bench_latency_seconds", "Recorded durations");
+
+    Poco::AutoPtr<Poco::Util::MapConfiguration> config(new Poco::Util::MapConfiguration);
+    config->setString("address", "127.0.0.1");
+    config->setString("port", "0");
+    MetricsServer server(*config, registry);
+    server.start();
+    out << "serving " << server.url() << " to " << settings.workers << " recording threads\n";
+
+    // recorders cycle through 0.1 ~ 100 ms so every scrape renders populated buckets
+    std::atomic<bool> recording{ true };
+    vector<std::thread> recorders;
+    int64 tickStart = cv::getTickCount();
+    for (int i = 0; i < settings.workers; i++)
+    {
+        recorders.emplace_back([&samples, &latency, &recording, i]()
+        {
+            for (uint64_t n = i; recording; n++)
+            {
+                latency.record(0.1 + (n % 1000) * 0.1);
+                samples.add();
+            }
+        });
+    }
+
+    bool passed = true;
+    vector<double> scrapeMs;
+    for (int i = 0; i < settings.iterations; i++)
+    {
+        int64 scrapeStart = cv::getTickCount();
+        if (scrape(server.port()).empty())
+            passed = false;
+        scrapeMs.push_back((cv::getTickCount() - scrapeStart) * 1000.0 / cv::getTickFrequency());
+    }
+    recording = false;
+    for (std::thread & recorder : recorders)
+        recorder.join();
+    double seconds = (cv::getTickCount() - tickStart) / cv::getTickFrequency();
+
+    // with the recorders stopped the scrape has to account for every sample
+    string text = scrape(server.port());
+    server.stop();
+    double scraped = sampleValue(text, "bench_samples_total");
+    double histogramCount = sampleValue(text, "bench_latency_seconds_count");
+    if (scraped != (double)samples.value() || histogramCount != (double)latency.count())
+    {
+        out << "final scrape shows " << scraped << " samples and " << histogramCount << " durations, "
+            << samples.value() << " recorded\n";
+        passed = false;
+    }
+
+    std::sort(scrapeMs.begin(), scrapeMs.end());
+    out << std::fixed << std::setprecision(2);
+    out << setw(12) << "scrapes" << setw(14) << "median ms" << setw(12) << "max ms" << setw(18) << "records/s" << "\n";
+    out << setw(12) << scrapeMs.size() << setw(14) << scrapeMs[scrapeMs.size() / 2] << setw(12) << scrapeMs.back()
+        << setw(18) << std::setprecision(0) << samples.value() / seconds << "\n";
+    out << "recorded p50 " << std::setprecision(2) << latency.percentile(0.5) << " ms, p99 " << latency.percentile(0.99) << " ms\n";
+    out << (passed ? "every scrape succeeded and the last one shows all samples" : "scrapes FAILED or lost samples") << std::endl;
+    return passed;
+}
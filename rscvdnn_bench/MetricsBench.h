@@ -0,0 +1,8 @@
+#pragma once
+#include <ostream>
+#include "LayerBench.h"
+
+// Serve a registry on a loopback port while settings.workers threads record into it, scrape it settings.iterations
+// times over HTTP and report the scrape latency and the recording rate. Returns false if a scrape fails or the
+// final scrape does not show every recorded sample.
+bool runMetricsBench(const BenchSettings & settings, std::ostream & out);
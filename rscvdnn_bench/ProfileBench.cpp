@@ -0,0 +1,144 @@
+#include <algorithm>
+#include <string>
+#include <vector>
+#include <ostream>
+#include <iomanip>
+#include <Poco/AutoPtr.h>
+#include <Poco/Util/MapConfiguration.h>
+#include <opencv2/opencv.hpp>
+#include "ProfileBench.h"
+#include "CameraSettings.h"
+#include "StreamProfile.h"
+#include "FrameStages.h"
+#include "ObjectDetector.h"
+
+using std::string;
+using std::vector;
+using std::ostream;
+using std::setw;
+
+// a configuration of the cameras section to choose the color profile for
+struct ProfileCase
+{
+    const char *name;
+    const char *alignTo;
+    const char *roi;
+    int displayWidth;
+    int displayHeight;
+};
+
+// the color profiles of the RGB sensor of a D415 or D435
+static vector<StreamProfile> d400ColorProfiles()
+{
+    const cv::Size sizes[] = { { 320, 180 }, { 320, 240 }, { 424, 240 }, { 640, 360 }, { 640, 480 },
+        { 848, 480 }, { 960, 540 }, { 1280, 720 }, { 1920, 1080 } };
+    vector<StreamProfile> profiles;
+    for (const cv::Size & size : sizes)
+    {
+        for (int fps : { 6, 15, 30, 60 })
+        {
+            if (size.width == 1920 && fps > 30)
+                continue;
+            for (rs2_format format : { RS2_FORMAT_RGB8, RS2_FORMAT_BGR8 })
+                profiles.push_back(StreamProfile{ size, format, fps });
+        }
+    }
+    return profiles;
+}
+
+// the region FramePipeline feeds the detector from a frame of size
+static cv::Rect detectorRoi(const cv::Size & size, const cv::Rect & roi)
+{
+    if (!roi.empty())
+        return roi & cv::Rect(cv::Point(0, 0), size);
+    int side = std::min(size.width, size.height);
+    return cv::Rect((size.width - side) / 2, (size.height - side) / 2, side, side);
+}
+
+// ms per frame of the work on the aligned frames of size that does not depend on the network
+static double frameWorkMs(const cv::Size & size, rs2_format format, const cv::Rect & roi, int iterations)
+{
+    cv::RNG rng(5);
+    cv::Mat color(size, CV_8UC3);
+    cv::Mat depth(size, CV_16UC1);
+    rng.fill(color, cv::RNG::UNIFORM, 0, 256);
+    rng.fill(depth, cv::RNG::UNIFORM, 0, 5000);
+    const vector<cv::Rect> outside = { cv::Rect(0, 0, size.width, roi.y), cv::Rect(0, roi.br().y, size.width, size.height - roi.br().y),
+        cv::Rect(0, roi.y, roi.x, roi.height), cv::Rect(roi.br().x, roi.y, size.width - roi.br().x, roi.height) };
+    Detections detections;
+    vector<float> distances;
+    for (int i = 0; i < 5; i++)
+    {
+        cv::Rect box(rng.uniform(0, roi.width / 2), rng.uniform(0, roi.height / 2), roi.width / 3, roi.height / 3);
+        detections.push_back(Detection{ rng.uniform(1, 21), 0.9f, box });
+        distances.push_back(rng.uniform(0.5f, 5.0f));
+    }
+
+    Poco::AutoPtr<Poco::Util::MapConfiguration> config(new Poco::Util::MapConfiguration);
+    ObjectDetector detector(*config);
+    auto className = [&detector](int classId) -> const string & { return detector.className(classId); };
+    OverlayBuffers overlay;
+    DepthColorizer colorizer;
+    colorizer.setRange(0.001f, 6.0);
+    cv::Mat matDepth, depthView;
+    auto run = [&]()
+    {
+        if (format != RS2_FORMAT_BGR8)
+            cv::cvtColor(color, color, cv::COLOR_RGB2BGR);
+        depth(roi).convertTo(matDepth, CV_64F, 0.001);
+        annotateFrame(color, roi, outside, detections, distances, className, overlay);
+        colorizer.colorize(depth, depthView);
+    };
+    run();
+    int64 tickStart = cv::getTickCount();
+    for (int i = 0; i < iterations; i++)
+        run();
+    return (cv::getTickCount() - tickStart) * 1000.0 / cv::getTickFrequency() / iterations;
+}
+
+bool runProfileBench(const BenchSettings & settings, ostream & out)
+{
+    const ProfileCase cases[] = {
+        { "default", "color", "", 1280, 720 },
+        { "headless", "color", "", 0, 0 },
+        { "small roi", "color", "810,390,300,300", 0, 0 },
+        { "depth aligned", "depth", "", 640, 360 }
+    };
+    const vector<StreamProfile> offered = d400ColorProfiles();
+
+    bool passed = true;
+    out << std::left << setw(16) << "case" << setw(24) << "configured" << setw(24) << "chosen" << std::right
+        << setw(10) << "MB/s" << setw(10) << "chosen" << setw(10) << "ms/frame" << setw(10) << "chosen" << setw(10) << "saved" << "\n" << std::fixed;
+    for (const ProfileCase & test : cases)
+    {
+        Poco::AutoPtr<Poco::Util::MapConfiguration> config(new Poco::Util::MapConfiguration);
+        config->setString("profile", "auto");
+        config->setString("alignTo", test.alignTo);
+        config->setString("roi", test.roi);
+        config->setInt("displayWidth", test.displayWidth);
+        config->setInt("displayHeight", test.displayHeight);
+        CameraSettings camera(*config, "bench", "");
+        const StreamProfile configured = camera.color;
+        const cv::Rect configuredRoi = camera.roi;
+        bool chosen = camera.chooseColorProfile(offered, ObjectDetector::InputSide);
+
+        // the frames fed to the detector and drawn into have the size of the stream aligned to
+        bool alignedToColor = camera.alignTo == RS2_STREAM_COLOR;
+        cv::Size configuredFrame = alignedToColor ? configured.size : camera.depth.size;
+        cv::Size chosenFrame = alignedToColor ? camera.color.size : camera.depth.size;
+        cv::Rect roi = detectorRoi(chosenFrame, camera.roi);
+        double configuredMs = frameWorkMs(configuredFrame, configured.format, detectorRoi(configuredFrame, configuredRoi), settings.iterations);
+        double chosenMs = frameWorkMs(chosenFrame, camera.color.format, roi, settings.iterations);
+
+        bool ok = chosen && camera.color.bytesPerSecond() <= configured.bytesPerSecond()
+            && camera.color.size.width >= test.displayWidth && camera.color.size.height >= test.displayHeight
+            && (!alignedToColor || (roi.width >= ObjectDetector::InputSide && roi.height >= ObjectDetector::InputSide));
+        passed = passed && ok;
+        out << std::left << setw(16) << test.name << setw(24) << configured.toString() << setw(24) << (chosen ? camera.color.toString() : "none")
+            << std::right << std::setprecision(1) << setw(10) << configured.bytesPerSecond() / 1e6 << setw(10) << camera.color.bytesPerSecond() / 1e6
+            << std::setprecision(2) << setw(10) << configuredMs << setw(10) << chosenMs
+            << std::setprecision(0) << setw(9) << 100.0 * (1.0 - chosenMs / configuredMs) << "%" << (ok ? "" : "  FAILED") << "\n";
+    }
+    out << (passed ? "every choice serves the detector and the display for less" : "a choice does NOT serve the detector or the display") << std::endl;
+    return passed;
+}
@@ -0,0 +1,9 @@
+#pragma once
+#include <ostream>
+#include "LayerBench.h"
+
+// Choose the color profile of a RealSense D400 camera automatically for a few configurations, default, headless, a
+// small roi and aligned to depth, and report the bandwidth of the chosen profile next to the configured one, with the
+// time of the per-frame work that scales with the color frame, RGB to BGR conversion, overlay, depth to meters and
+// depth colorizing, at both. Returns false if a choice does not serve the detector or the display, or costs more.
+bool runProfileBench(const BenchSettings & settings, std::ostream & out);
@@ -0,0 +1,136 @@
+#include <string>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <ostream>
+#include <iomanip>
+#include <Poco/AutoPtr.h>
+#include <Poco/ByteOrder.h>
+#include <Poco/Timespan.h>
+#include <Poco/Net/SocketAddress.h>
+#include <Poco/Net/StreamSocket.h>
+#include <Poco/Util/MapConfiguration.h>
+#include <opencv2/core.hpp>
+#include "PublisherBench.h"
+#include "DetectionPublisher.h"
+#include "Metrics.h"
+
+using std::string;
+using std::vector;
+using std::ostream;
+using std::setw;
+using Poco::Net::SocketAddress;
+using Poco::Net::StreamSocket;
+
+// objects per published frame, about the size of a busy scene
+static const int ObjectsPerMessage = 20;
+
+static bool receiveExactly(StreamSocket & socket, char *data, int size)
+{
+    while (size > 0)
+    {
+        int received = socket.receiveBytes(data, size);
+        if (received <= 0)
+            return false;
+        data += received;
+        size -= received;
+    }
+    return true;
+}
+
+// read messages until the last frame arrives, and count the frames missing in between
+static void readMessages(unsigned short port, uint64_t lastFrame, LatencyHistogram & latency, std::atomic<uint64_t> & missed)
+{
+    try
+    {
+        StreamSocket socket(SocketAddress("127.0.0.1", port));
+        socket.setReceiveTimeout(Poco::Timespan(5, 0));
+        vector<char> body;
+        DetectionMessage message;
+        uint64_t expected = 0;
+        while (expected <= lastFrame)
+        {
+            Poco::UInt32 length;
+            if (!receiveExactly(socket, (char *)&length, sizeof(length)))
+                break;
+            body.resize(Poco::ByteOrder::fromLittleEndian(length));
+            if (!receiveExactly(socket, body.data(), (int)body.size()) || !message.decode(body.data(), body.size()))
+                break;
+            latency.record((publisherClockUs() - message.sentUs) / 1000.0);
+            missed += message.frameNumber - expected;
+            expected = message.frameNumber + 1;
+        }
+        missed += lastFrame + 1 - expected;
+    }
+    catch (Poco::Exception &)
+    {
+        missed += 1;
+    }
+}
+
+bool runPublisherBench(const BenchSettings & settings, ostream & out)
+{
+    const int messages = settings.iterations * 20;
+    Poco::AutoPtr<Poco::Util::MapConfiguration> config(new Poco::Util::MapConfiguration);
+    config->setString("address", "127.0.0.1");
+    config->setString("port", "0");
+    config->setInt("maxClients", settings.clients + 1);
+    config->setInt("maxDropped", 30);
+    config->setInt("queue.capacity", 64);
+    config->setString("queue.policy", "dropOldest");
+    DetectionPublisher publisher(*config);
+    publisher.start();
+
+    LatencyHistogram publishCost;
+    LatencyHistogram delivery;
+    std::atomic<uint64_t> missed{ 0 };
+    vector<std::thread> readers;
+    for (int i = 0; i < settings.clients; i++)
+        readers.emplace_back(readMessages, publisher.port(), (uint64_t)messages - 1, std::ref(delivery), std::ref(missed));
+    // a client that connects with a tiny buffer and never reads
+    StreamSocket stalled;
+    stalled.setReceiveBufferSize(1024);
+    stalled.connect(SocketAddress("127.0.0.1", publisher.port()));
+
+    for (int wait = 0; publisher.clientCount() < (size_t)settings.clients + 1 && wait < 500; wait++)
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    out << publisher.clientCount() << " clients connected, publishing " << messages << " messages of "
+        << ObjectsPerMessage << " objects\n";
+
+    MetricCounter & dropped = metrics().counter("rscvdnn_publisher_messages_dropped_total", "");
+    MetricCounter & clientsDropped = metrics().counter("rscvdnn_publisher_clients_dropped_total", "");
+    uint64_t droppedBefore = dropped.value();
+    uint64_t clientsDroppedBefore = clientsDropped.value();
+    DetectionMessage message;
+    message.camera = 0;
+    message.sensorTimestamp = 0.0;
+    for (int i = 0; i < ObjectsPerMessage; i++)
+        message.objects.push_back(PublishedObject{ i % 21, 0.9f, cv::Rect(10 * i, 20, 64, 128), 1.5f });
+    for (int i = 0; i < messages; i++)
+    {
+        message.frameNumber = i;
+        message.sensorTimestamp = i * 1000.0 / 60;
+        int64 tickStart = cv::getTickCount();
+        publisher.publish(message);
+        publishCost.record((cv::getTickCount() - tickStart) * 1000.0 / cv::getTickFrequency());
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    for (std::thread & reader : readers)
+        reader.join();
+    stalled.close();
+    publisher.stop();
+
+    out << std::fixed << std::setprecision(3);
+    out << setw(24) << "" << setw(12) << "p50 ms" << setw(12) << "p99 ms" << setw(12) << "p99.9 ms" << "\n";
+    out << setw(24) << "publish call" << setw(12) << publishCost.percentile(0.5) << setw(12) << publishCost.percentile(0.99)
+        << setw(12) << publishCost.percentile(0.999) << "\n";
+    out << setw(24) << "publish to decode" << setw(12) << delivery.percentile(0.5) << setw(12) << delivery.percentile(0.99)
+        << setw(12) << delivery.percentile(0.999) << "\n";
+    out << dropped.value() - droppedBefore << " messages dropped from full client queues, stalled client "
+        << ((clientsDropped.value() > clientsDroppedBefore) ? "disconnected" : "still within its socket buffers") << "\n";
+    bool passed = (missed == 0);
+    out << (passed ? "every reading client received every message" : "reading clients MISSED " + std::to_string(missed.load()) + " messages")
+        << std::endl;
+    return passed;
+}
@@ -0,0 +1,8 @@
+#pragma once
+#include <ostream>
+#include "LayerBench.h"
+
+// Publish settings.iterations x 20 detection messages, one per millisecond, to settings.clients loopback clients
+// plus one client that never reads. Reports the cost of a publish call, the delivery latency from publish to
+// decode, and whether the stalled client was dropped. Returns false if a reading client missed a message.
+bool runPublisherBench(const BenchSettings & settings, std::ostream & out);
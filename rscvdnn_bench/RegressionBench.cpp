@@ -0,0 +1,296 @@
+#include <string>
+#include <vector>
+#include <map>
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <ostream>
+#include <iomanip>
+#include <sstream>
+#include <stdexcept>
+#include <Poco/AutoPtr.h>
+#include <Poco/File.h>
+#include <Poco/Path.h>
+#include <Poco/TemporaryFile.h>
+#include <Poco/JSON/Parser.h>
+#include <Poco/JSON/Object.h>
+#include <Poco/JSON/Array.h>
+#include <Poco/Util/IniFileConfiguration.h>
+#include <Poco/Util/LayeredConfiguration.h>
+#include <Poco/Util/MapConfiguration.h>
+#include <opencv2/core.hpp>
+#include "RegressionBench.h"
+#include "BatchRunner.h"
+#include "FramePipeline.h"
+
+using std::string;
+using std::vector;
+using std::ostream;
+using std::setw;
+using Poco::AutoPtr;
+using Poco::Util::AbstractConfiguration;
+
+// issues listed one by one before only their counts are reported
+static const int MaxListedIssues = 50;
+
+struct GoldenObject
+{
+    string className;
+    float confidence;
+    cv::Rect box;
+    float distance;
+};
+
+// the objects of every frame of a JSON Lines detections file written by the batch mode
+static std::map<uint64_t, vector<GoldenObject>> loadDetections(const string & path)
+{
+    std::ifstream file(path);
+    if (!file)
+        throw std::runtime_error("cannot read detections " + path);
+    std::map<uint64_t, vector<GoldenObject>> frames;
+    string line;
+    while (std::getline(file, line))
+    {
+        if (line.empty())
+            continue;
+        Poco::JSON::Parser parser;
+        Poco::JSON::Object::Ptr record = parser.parse(line).extract<Poco::JSON::Object::Ptr>();
+        vector<GoldenObject> & objects = frames[record->getValue<uint64_t>("frame")];
+        Poco::JSON::Array::Ptr list = record->getArray("objects");
+        for (size_t i = 0; i < list->size(); i++)
+        {
+            Poco::JSON::Object::Ptr object = list->getObject((unsigned int)i);
+            Poco::JSON::Array::Ptr box = object->getArray("box");
+            objects.push_back(GoldenObject{ object->getValue<string>("class"), (float)object->getValue<double>("confidence"),
+                cv::Rect(box->getElement<int>(0), box->getElement<int>(1), box->getElement<int>(2), box->getElement<int>(3)),
+                (float)object->getValue<double>("distance") });
+        }
+    }
+    return frames;
+}
+
+static double boxIoU(const cv::Rect & a, const cv::Rect & b)
+{
+    double intersection = (a & b).area();
+    double united = a.area() + b.area() - intersection;
+    return (united > 0.0) ? intersection / united : 0.0;
+}
+
+struct AccuracyStats
+{
+    uint64_t frames{ 0 };
+    uint64_t missingFrames{ 0 };
+    uint64_t golden{ 0 };
+    uint64_t matched{ 0 };
+    uint64_t missing{ 0 };
+    uint64_t extra{ 0 };
+    uint64_t drifted{ 0 };
+    double iouSum{ 0.0 };
+    double worstIoU{ 1.0 };
+    double worstConfidence{ 0.0 };
+    double worstDistance{ 0.0 };
+    int listed{ 0 };
+};
+
+class CorpusComparison
+{
+public:
+    CorpusComparison(const AbstractConfiguration & config, ostream & out)
+        : _minIoU{ config.getDouble("minIoU", 0.8) }
+        , _confidenceTolerance{ config.getDouble("confidenceTolerance", 0.05) }
+        , _distanceTolerance{ config.getDouble("distanceTolerance", 0.05) }
+        , _out(out)
+    {
+    }
+
+    // match the objects of one frame, the most confident golden ones pick first
+    void compare(uint64_t frame, vector<GoldenObject> golden, const vector<GoldenObject> & found)
+    {
+        _stats.frames++;
+        _stats.golden += golden.size();
+        std::sort(golden.begin(), golden.end(), [](const GoldenObject & a, const GoldenObject & b) { return a.confidence > b.confidence; });
+        vector<bool> taken(found.size(), false);
+        for (const GoldenObject & reference : golden)
+        {
+            int best = -1;
+            double bestIoU = 0.0;
+            for (size_t k = 0; k < found.size(); k++)
+            {
+                double iou = boxIoU(reference.box, found[k].box);
+                if (!taken[k] && found[k].className == reference.className && iou > bestIoU)
+                {
+                    best = (int)k;
+                    bestIoU = iou;
+                }
+            }
+            if (best < 0 || bestIoU < _minIoU)
+            {
+                _stats.missing++;
+                issue(frame, reference.className + " missing" + (best < 0 ? string() : ", best IoU " + number(bestIoU)));
+                continue;
+            }
+
+            taken[best] = true;
+            _stats.matched++;
+            _stats.iouSum += bestIoU;
+            _stats.worstIoU = std::min(_stats.worstIoU, bestIoU);
+            double confidenceDiff = std::abs(found[best].confidence - reference.confidence);
+            double distanceDiff = std::abs(found[best].distance - reference.distance);
+            _stats.worstConfidence = std::max(_stats.worstConfidence, confidenceDiff);
+            _stats.worstDistance = std::max(_stats.worstDistance, distanceDiff);
+            if (confidenceDiff > _confidenceTolerance || distanceDiff > _distanceTolerance)
+            {
+                _stats.drifted++;
+                issue(frame, reference.className + " drifted, confidence " + number(reference.confidence) + " -> " + number(found[best].confidence)
+                    + ", distance " + number(reference.distance) + " -> " + number(found[best].distance) + " m");
+            }
+        }
+        for (size_t k = 0; k < found.size(); k++)
+        {
+            if (!taken[k])
+            {
+                _stats.extra++;
+                issue(frame, found[k].className + " extra, confidence " + number(found[k].confidence));
+            }
+        }
+    }
+
+    void missingFrame(uint64_t frame, size_t objects)
+    {
+        _stats.missingFrames++;
+        _stats.golden += objects;
+        _stats.missing += objects;
+        issue(frame, "frame not processed");
+    }
+
+    bool passed() const { return _stats.missing == 0 && _stats.extra == 0 && _stats.drifted == 0 && _stats.missingFrames == 0; }
+
+    void report() const
+    {
+        _out << std::fixed << std::setprecision(3)
+            << "accuracy: " << _stats.frames << " frames compared, " << _stats.missingFrames << " not processed, "
+            << _stats.golden << " golden objects, " << _stats.matched << " matched, " << _stats.missing << " missing, "
+            << _stats.extra << " extra, " << _stats.drifted << " drifted\n"
+            << "  mean IoU " << (_stats.matched > 0 ? _stats.iouSum / _stats.matched : 0.0) << ", worst IoU "
+            << (_stats.matched > 0 ? _stats.worstIoU : 0.0) << " (min " << _minIoU << "), worst confidence difference "
+            << _stats.worstConfidence << " (max " << _confidenceTolerance << "), worst distance difference "
+            << _stats.worstDistance << " m (max " << _distanceTolerance << ")\n";
+    }
+
+private:
+    static string number(double value)
+    {
+        std::ostringstream ss;
+        ss << std::fixed << std::setprecision(3) << value;
+        return ss.str();
+    }
+
+    void issue(uint64_t frame, const string & text)
+    {
+        if (_stats.listed++ < MaxListedIssues)
+            _out << "frame " << frame << ": " << text << "\n";
+        else if (_stats.listed == MaxListedIssues + 1)
+            _out << "...\n";
+    }
+
+    const double _minIoU;
+    const double _confidenceTolerance;
+    const double _distanceTolerance;
+    ostream & _out;
+    AccuracyStats _stats;
+};
+
+// the stage durations of the run against their budgets, false if one is over
+static bool checkBudgets(const AbstractConfiguration & config, const string & serial, ostream & out)
+{
+    double percentile = config.getDouble("budgetPercentile", 0.9);
+    bool passed = true;
+    out << "latency: p" << (int)std::round(percentile * 100) << " per stage\n" << std::fixed << std::setprecision(3);
+    for (const char *stage : { "align", "preprocess", "inference", "postprocess" })
+    {
+        const LatencyHistogram & durations = FramePipeline::stageDuration(serial, stage);
+        double ms = durations.percentile(percentile);
+        out << "  " << std::left << setw(14) << stage << std::right << setw(10) << ms << " ms, median "
+            << durations.percentile(0.5) << " ms of " << durations.count() << " frames";
+        string budget = string("budget.") + stage;
+        if (config.has(budget))
+        {
+            double budgetMs = config.getDouble(budget);
+            out << ", budget " << budgetMs << " ms";
+            if (ms > budgetMs)
+            {
+                out << "  OVER BUDGET";
+                passed = false;
+            }
+        }
+        out << "\n";
+    }
+    return passed;
+}
+
+bool runRegressionBench(const BenchSettings & settings, ostream & out)
+{
+    if (settings.corpus.empty())
+        throw std::runtime_error("the regression suite needs a corpus directory");
+    string corpus = settings.corpus;
+    while (corpus.size() > 1 && (corpus.back() == '/' || corpus.back() == '\\'))
+        corpus.pop_back();
+    if (!Poco::File(corpus).isDirectory())
+        throw std::runtime_error(corpus + " is not a directory");
+    Poco::Path corpusPath(corpus);
+    corpusPath.makeDirectory();
+
+    // the batch mode settings on top of the corpus settings, the corpus plays as the only camera, named after its directory
+    AutoPtr<Poco::Util::MapConfiguration> overrides(new Poco::Util::MapConfiguration);
+    overrides->setString("cameras.playback", corpus);
+    overrides->setString("cameras.devices", "");
+    overrides->setBool("recorder.enabled", false);
+    overrides->setBool("publisher.enabled", false);
+    AutoPtr<Poco::Util::LayeredConfiguration> config(new Poco::Util::LayeredConfiguration);
+    config->add(overrides, 0, true);
+    string ini = Poco::Path(corpusPath, "corpus.ini").toString();
+    if (Poco::File(ini).exists())
+    {
+        AutoPtr<Poco::Util::IniFileConfiguration> corpusConfig(new Poco::Util::IniFileConfiguration(ini));
+        config->add(corpusConfig, 1, false);
+    }
+    AutoPtr<AbstractConfiguration> regression(config->createView("regression"));
+    string serial = Poco::Path(corpus).getBaseName();
+
+    string golden = Poco::Path(corpusPath, "golden.jsonl").toString();
+    if (!settings.update && !Poco::File(golden).exists())
+        throw std::runtime_error("no golden detections " + golden + ", write them with --update from a reference run");
+    Poco::TemporaryFile detections;
+    string output = settings.update ? golden : detections.path();
+    BatchRunner batch(*config);
+    if (!batch.run(settings.modelDir + "/MobileNetSSD_deploy.prototxt", settings.modelDir + "/MobileNetSSD_deploy.caffemodel", output, out))
+        return false;
+    bool passed = checkBudgets(*regression, serial, out);
+    if (settings.update)
+    {
+        out << "golden detections written to " << golden << std::endl;
+        return passed;
+    }
+
+    std::map<uint64_t, vector<GoldenObject>> expected = loadDetections(golden);
+    std::map<uint64_t, vector<GoldenObject>> found = loadDetections(output);
+    CorpusComparison comparison(*regression, out);
+    for (const auto & frame : expected)
+    {
+        auto run = found.find(frame.first);
+        if (run == found.end())
+            comparison.missingFrame(frame.first, frame.second.size());
+        else
+            comparison.compare(frame.first, frame.second, run->second);
+    }
+    // frames added to the corpus after the golden detections were written have every object extra
+    for (const auto & frame : found)
+    {
+        if (expected.find(frame.first) == expected.end())
+            comparison.compare(frame.first, {}, frame.second);
+    }
+    comparison.report();
+    passed = passed && comparison.passed();
+    out << (passed ? "detections match the golden ones within the latency budgets" : "regression FAILED") << std::endl;
+    return passed;
+}
@@ -0,0 +1,12 @@
+#pragma once
+#include <ostream>
+#include "LayerBench.h"
+
+// Replay the corpus in settings.corpus, a directory of <name>_color.png frames with their 16 bit <name>_depth.png,
+// through the batch mode pipeline and compare the detections with the golden ones in golden.jsonl of the corpus.
+// An object matches a golden one of the same class if their boxes overlap by regression.minIoU, and drifted if its
+// confidence or distance differ by more than regression.confidenceTolerance or regression.distanceTolerance meters.
+// The stage durations at regression.budgetPercentile are checked against the budgets regression.budget.<stage> in ms.
+// corpus.ini of the corpus, if there is one, configures the detector and the checks. With settings.update the golden
+// detections are written from this run instead. Returns false on a missing, extra or drifted object, or a stage over budget.
+bool runRegressionBench(const BenchSettings & settings, std::ostream & out);
@@ -0,0 +1,91 @@
+#include <string>
+#include <memory>
+#include <thread>
+#include <chrono>
+#include <future>
+#include <ostream>
+#include <iomanip>
+#include <Poco/AutoPtr.h>
+#include <Poco/Util/MapConfiguration.h>
+#include <opencv2/core.hpp>
+#include "ShutdownBench.h"
+#include "FrameSource.h"
+#include "FramePipeline.h"
+#include "CameraSettings.h"
+
+using std::string;
+using std::ostream;
+using Poco::AutoPtr;
+using Poco::Util::MapConfiguration;
+
+// longest a stop may take before it counts as hanging
+static const int StopTimeoutMs = 5000;
+
+// delivers frames frames, then nothing until it is stopped, like RealSenseSource waiting for its device to come back
+class SilentSource : public FrameSource
+{
+public:
+    SilentSource(const Poco::Util::AbstractConfiguration & config, int frames)
+        : FrameSource("silent", config, 1), _frames{ frames }, _size(640, 480)
+    {
+    }
+    ~SilentSource() { stop(); }
+    cv::Size frameSize() const override { return _size; }
+    float depthScale() const override { return 0.001f; }
+
+protected:
+    void open() override {}
+    void close() override {}
+    bool grab(PipelineFrame & frame) override
+    {
+        if ((int)frame.sequence < _frames)
+        {
+            frame.frameNumber = frame.sequence;
+            frame.color = cv::Mat::zeros(_size, CV_8UC3);
+            frame.depth = cv::Mat::zeros(_size, CV_16UC1);
+            return true;
+        }
+        while (!stopping())
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        return false;
+    }
+
+private:
+    const int _frames;
+    const cv::Size _size;
+};
+
+bool runShutdownBench(const BenchSettings & settings, ostream & out)
+{
+    AutoPtr<MapConfiguration> config(new MapConfiguration);
+    config->setInt("playbackRealTime", 0);
+    bool passed = true;
+    out << std::fixed << std::setprecision(1);
+    for (int frames : { 0, 5 })
+    {
+        CameraSettings camera(*config, "silent" + std::to_string(frames), "");
+        std::shared_ptr<SilentSource> source(new SilentSource(*config, frames));
+        std::shared_ptr<FramePipeline> pipeline(new FramePipeline(*config, camera, 0, nullptr));
+        source->start();
+        pipeline->start(*source);
+        // the capture stage takes the frames there are and then waits in read
+        std::this_thread::sleep_for(std::chrono::milliseconds(200));
+
+        auto start = std::chrono::steady_clock::now();
+        std::packaged_task<void()> stop([source, pipeline]()
+        {
+            pipeline->stop();
+            source->stop();
+        });
+        std::future<void> stopped = stop.get_future();
+        // a hanging stop is left behind, the bench exits without it
+        std::thread(std::move(stop)).detach();
+        bool done = stopped.wait_for(std::chrono::milliseconds(StopTimeoutMs)) == std::future_status::ready;
+        double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        out << "source silent after " << frames << " frames: " << (done ? "stopped in " + std::to_string((int)ms) + " ms"
+            : "stop HANGS after " + std::to_string(StopTimeoutMs) + " ms") << "\n";
+        passed = passed && done;
+    }
+    out << (passed ? "pipelines of silent sources stop" : "a pipeline of a silent source does NOT stop") << std::endl;
+    return passed;
+}
@@ -0,0 +1,8 @@
+#pragma once
+#include <ostream>
+#include "LayerBench.h"
+
+// Stop a frame pipeline the way the camera rig does, pipeline first and then its source, while the source delivers
+// no frames, from the start and after a few frames, as a live device does once it is unplugged and waits to be
+// plugged in again. Returns false if a stop does not return within a few seconds.
+bool runShutdownBench(const BenchSettings & settings, std::ostream & out);
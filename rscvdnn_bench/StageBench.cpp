@@ -0,0 +1,447 @@
+#include <string>
+#include <vector>
+#include <map>
+#include <algorithm>
+#include <fstream>
+#include <ostream>
+#include <iomanip>
+#include <stdexcept>
+#include <Poco/AutoPtr.h>
+#include <Poco/File.h>
+#include <Poco/NumberParser.h>
+#include <Poco/String.h>
+#include <Poco/StringTokenizer.h>
+#include <Poco/Util/MapConfiguration.h>
+#include <librealsense2/rs.hpp>
+#include <librealsense2/hpp/rs_internal.hpp>
+#include <opencv2/opencv.hpp>
+#include <opencv2/dnn.hpp>
+#include "StageBench.h"
+#include "FrameStages.h"
+#include "ObjectDetector.h"
+
+using std::string;
+using std::vector;
+using std::ostream;
+using std::setw;
+using Poco::StringTokenizer;
+
+// depth stream aligned to every color resolution, as the D415 streams it next to the color
+static const cv::Size DepthSize(640, 480);
+// rows of the detection_out blob of MobileNet-SSD, its keep_top_k
+static const int DetectionRows = 100;
+
+struct StageResult
+{
+    string stage;
+    string resolution;
+    int runs;
+    double medianMs;
+    double p90Ms;
+};
+
+static string sizeString(const cv::Size & size)
+{
+    return std::to_string(size.width) + "x" + std::to_string(size.height);
+}
+
+static double elapsedMs(int64 tickStart)
+{
+    return (cv::getTickCount() - tickStart) * 1000.0 / cv::getTickFrequency();
+}
+
+// run once to warm up, then time iterations runs of run
+template <typename Run>
+static StageResult timeStage(const string & stage, const cv::Size & size, int iterations, Run run)
+{
+    run();
+    vector<double> ms;
+    for (int i = 0; i < iterations; i++)
+    {
+        int64 tickStart = cv::getTickCount();
+        run();
+        ms.push_back(elapsedMs(tickStart));
+    }
+    std::sort(ms.begin(), ms.end());
+    return StageResult{ stage, sizeString(size), iterations, ms[ms.size() / 2], ms[std::min(ms.size() - 1, ms.size() * 9 / 10)] };
+}
+
+// Feeds a depth and a color stream to librealsense through a software device, with the intrinsics and extrinsics
+// of a D415, so the frames are aligned by the same code as camera frames.
+class SoftwareStreams
+{
+public:
+    SoftwareStreams(const cv::Mat & depth, const cv::Mat & color)
+        : _depthSensor(_device.add_sensor("Depth"))
+        , _colorSensor(_device.add_sensor("Color"))
+        , _depth(depth)
+        , _color(color)
+        , _frameNumber(0)
+    {
+        rs2_intrinsics depthIntrinsics{ depth.cols, depth.rows, depth.cols / 2.0f, depth.rows / 2.0f, 385.0f, 385.0f,
+            RS2_DISTORTION_BROWN_CONRADY, { 0, 0, 0, 0, 0 } };
+        float scale = color.cols / 640.0f;
+        rs2_intrinsics colorIntrinsics{ color.cols, color.rows, color.cols / 2.0f, color.rows / 2.0f, 615.0f * scale, 615.0f * scale,
+            RS2_DISTORTION_INVERSE_BROWN_CONRADY, { 0, 0, 0, 0, 0 } };
+        _depthProfile = _depthSensor.add_video_stream({ RS2_STREAM_DEPTH, 0, 0, depth.cols, depth.rows, 30, 2,
+            RS2_FORMAT_Z16, depthIntrinsics });
+        _colorProfile = _colorSensor.add_video_stream({ RS2_STREAM_COLOR, 0, 1, color.cols, color.rows, 30, 3,
+            RS2_FORMAT_RGB8, colorIntrinsics });
+        _depthSensor.add_read_only_option(RS2_OPTION_DEPTH_UNITS, 0.001f);
+        _depthProfile.register_extrinsics_to(_colorProfile, { { 1, 0, 0, 0, 1, 0, 0, 0, 1 }, { 0.015f, 0, 0 } });
+        _device.create_matcher(RS2_MATCHER_DLITE);
+        _depthSensor.open(_depthProfile);
+        _colorSensor.open(_colorProfile);
+        _depthSensor.start(_sync);
+        _colorSensor.start(_sync);
+    }
+
+    ~SoftwareStreams()
+    {
+        _depthSensor.stop();
+        _colorSensor.stop();
+        _depthSensor.close();
+        _colorSensor.close();
+    }
+
+    // the next depth and color pair as a frameset
+    rs2::frameset frames()
+    {
+        _frameNumber++;
+        rs2_time_t timestamp = _frameNumber * 1000.0 / 30;
+        _depthSensor.on_video_frame({ _depth.data, [](void *) {}, (int)_depth.step, 2, timestamp,
+            RS2_TIMESTAMP_DOMAIN_HARDWARE_CLOCK, _frameNumber, _depthProfile });
+        _colorSensor.on_video_frame({ _color.data, [](void *) {}, (int)_color.step, 3, timestamp,
+            RS2_TIMESTAMP_DOMAIN_HARDWARE_CLOCK, _frameNumber, _colorProfile });
+        // the matcher may hand out the first frame of a pair on its own
+        for (int i = 0; i < 4; i++)
+        {
+            rs2::frameset frames = _sync.wait_for_frames(1000);
+            if (frames.size() == 2)
+                return frames;
+        }
+        throw std::runtime_error("software device frames are not synchronized");
+    }
+
+private:
+    rs2::software_device _device;
+    rs2::software_sensor _depthSensor;
+    rs2::software_sensor _colorSensor;
+    rs2::stream_profile _depthProfile;
+    rs2::stream_profile _colorProfile;
+    rs2::syncer _sync;
+    const cv::Mat _depth;
+    const cv::Mat _color;
+    int _frameNumber;
+};
+
+// a room with a gradient wall, colored boxes and noise, RGB like the camera delivers it
+static cv::Mat syntheticColor(const cv::Size & size)
+{
+    cv::Mat color(size, CV_8UC3);
+    for (int y = 0; y < size.height; y++)
+        color.row(y).setTo(cv::Scalar(60 + 120 * y / size.height, 90, 160 - 100 * y / size.height));
+    cv::RNG rng(7);
+    for (int i = 0; i < 12; i++)
+    {
+        cv::Point tl(rng.uniform(0, size.width * 3 / 4), rng.uniform(0, size.height * 3 / 4));
+        cv::Size box(rng.uniform(size.width / 16, size.width / 4), rng.uniform(size.height / 16, size.height / 4));
+        cv::rectangle(color, cv::Rect(tl, box), cv::Scalar(rng.uniform(0, 256), rng.uniform(0, 256), rng.uniform(0, 256)), CV_FILLED);
+    }
+    cv::Mat noise(size, CV_8UC3);
+    cv::randn(noise, cv::Scalar::all(0), cv::Scalar::all(6));
+    return color + noise;
+}
+
+// a floor and a wall at 4 m with boxes in between, 1 mm units with holes
+static cv::Mat syntheticDepth(const cv::Size & size)
+{
+    cv::Mat depth(size, CV_16UC1);
+    cv::RNG rng(42);
+    for (int y = 0; y < depth.rows; y++)
+    {
+        uint16_t *row = depth.ptr<uint16_t>(y);
+        for (int x = 0; x < depth.cols; x++)
+        {
+            double z = (y > size.height / 2) ? 4000.0 * size.height / 2 / (y - size.height / 2 + 40) / 6 + 500 : 4000.0;
+            if (y > size.height / 3 && y < size.height * 4 / 5 && (x * 4 / size.width) % 2 == 1)
+                z = 1500.0 + 500 * (x * 4 / size.width);
+            row[x] = (x < size.width / 16 || rng.uniform(0, 50) == 0) ? 0 : cv::saturate_cast<uint16_t>(z);
+        }
+    }
+    return depth;
+}
+
+static cv::Mat loadDepth(const string & paths)
+{
+    StringTokenizer tokens(paths, ",", StringTokenizer::TOK_TRIM | StringTokenizer::TOK_IGNORE_EMPTY);
+    if (tokens.count() == 0)
+        return syntheticDepth(DepthSize);
+    cv::Mat depth = cv::imread(tokens[0], cv::IMREAD_ANYDEPTH);
+    if (depth.type() != CV_16UC1)
+        throw std::runtime_error(tokens[0] + " is no 16 bit depth image");
+    cv::resize(depth, depth, DepthSize, 0, 0, cv::INTER_NEAREST);
+    return depth;
+}
+
+// the rows of a detection_out blob with confidences spread over the whole range, the rows past the objects marked empty
+static cv::Mat syntheticDetections()
+{
+    cv::Mat detection(DetectionRows, 7, CV_32F);
+    cv::RNG rng(3);
+    for (int i = 0; i < DetectionRows; i++)
+    {
+        float *row = detection.ptr<float>(i);
+        float x = rng.uniform(0.0f, 0.8f), y = rng.uniform(0.0f, 0.8f);
+        float values[] = { i < DetectionRows / 2 ? 0.0f : -1.0f, (float)rng.uniform(1, 21), rng.uniform(0.0f, 1.0f),
+            x, y, x + rng.uniform(0.05f, 0.2f), y + rng.uniform(0.05f, 0.2f) };
+        std::copy(values, values + 7, row);
+    }
+    return detection;
+}
+
+// a handful of boxes of different sizes inside the ROI
+static Detections syntheticBoxes(const cv::Size & roi)
+{
+    Detections boxes;
+    for (int i = 0; i < 8; i++)
+    {
+        cv::Size box(roi.width / (3 + i % 4), roi.height / (3 + i % 3));
+        cv::Point tl((roi.width - box.width) * i / 8, (roi.height - box.height) * ((i * 3) % 8) / 8);
+        boxes.push_back({ 1 + i * 2, 0.9f, cv::Rect(tl, box) });
+    }
+    return boxes;
+}
+
+static vector<StageResult> runResolution(const BenchSettings & settings, const cv::Size & size, const cv::Mat & image,
+    const cv::Mat & depthRaw, cv::dnn::Net * net, const ObjectDetector & detector, ostream & out)
+{
+    vector<StageResult> results;
+    cv::Mat color;
+    if (image.empty())
+        color = syntheticColor(size);
+    else
+    {
+        cv::resize(image, color, size, 0, 0, cv::INTER_AREA);
+        cv::cvtColor(color, color, cv::COLOR_BGR2RGB);
+    }
+    // the depth as it comes out of the align stage, the stages after it do not depend on how well it lines up
+    cv::Mat depth;
+    cv::resize(depthRaw, depth, size, 0, 0, cv::INTER_NEAREST);
+
+    // the center square, as the pipeline crops it for the network
+    int side = std::min(size.width, size.height);
+    cv::Rect roi((size.width - side) / 2, (size.height - side) / 2, side, side);
+    vector<cv::Rect> outside;
+    for (const cv::Rect & rect : { cv::Rect(0, 0, roi.x, size.height), cv::Rect(roi.br().x, 0, size.width - roi.br().x, size.height) })
+    {
+        if (!rect.empty())
+            outside.push_back(rect);
+    }
+    const int n = settings.iterations;
+
+    cv::Mat bgr;
+    results.push_back(timeStage("rgb_to_bgr", size, n, [&]() { cv::cvtColor(color, bgr, cv::COLOR_RGB2BGR); }));
+
+    try
+    {
+        SoftwareStreams streams(depthRaw, color);
+        rs2::align align(RS2_STREAM_COLOR);
+        vector<double> ms;
+        for (int i = 0; i <= n; i++)
+        {
+            rs2::frameset frames = streams.frames();
+            int64 tickStart = cv::getTickCount();
+            rs2::frameset aligned = align.proccess(frames);
+            // the first run sets up the align tables and is not timed
+            if (i > 0)
+                ms.push_back(elapsedMs(tickStart));
+        }
+        std::sort(ms.begin(), ms.end());
+        results.push_back(StageResult{ "align", sizeString(size), n, ms[ms.size() / 2], ms[std::min(ms.size() - 1, ms.size() * 9 / 10)] });
+    }
+    catch (const rs2::error & e)
+    {
+        out << "align at " << sizeString(size) << " skipped, " << e.what() << "\n";
+    }
+
+    cv::Mat depthMeters;
+    results.push_back(timeStage("depth_to_float", size, n, [&]() { depth.convertTo(depthMeters, CV_64F, 0.001); }));
+
+    // the blob as the detector builds it, into buffers kept from one frame to the next
+    InputBlob input(0.007843, 127.5);
+    cv::Mat bgrRoi = bgr(roi);
+    cv::Mat blob;
+    results.push_back(timeStage("blob_from_image", size, n, [&]() { blob = input.set(&bgrRoi, 1, detector.inputSize()); }));
+
+    // the network input does not depend on the frame size, but is timed at every one to keep the table regular
+    if (net != nullptr)
+    {
+        results.push_back(timeStage("net_forward", size, n, [&]()
+        {
+            net->setInput(blob, "data");
+            net->forward("detection_out");
+        }));
+    }
+
+    cv::Mat detection = syntheticDetections();
+    Detections decoded;
+    results.push_back(timeStage("detection_decode", size, n, [&]()
+    {
+        decoded.clear();
+        detector.parseDetections(detection, { cv::Rect(0, 0, roi.width, roi.height) }, 0.2f, decoded);
+    }));
+
+    Detections boxes = syntheticBoxes(roi.size());
+    cv::Mat depthRoi = depthMeters(roi);
+    vector<float> distances;
+    results.push_back(timeStage("depth_stats", size, n, [&]() { measureDistances(depthRoi, boxes, distances); }));
+
+    // drawing over the same frame again costs the same, the frame is not restored between runs
+    OverlayBuffers overlay;
+    results.push_back(timeStage("overlay", size, n, [&]()
+    {
+        annotateFrame(bgr, roi, outside, boxes, distances, [&detector](int classId) -> const string & { return detector.className(classId); }, overlay);
+    }));
+
+    // the bench has no GL context, the upload is timed as the copy into the continuous buffer the GUI uploads
+    // from, the driver copy of glTexImage2D is of the same size
+    cv::Mat staging(size, CV_8UC3);
+    results.push_back(timeStage("texture_upload", size, n, [&]() { bgr.copyTo(staging); }));
+    return results;
+}
+
+// median milliseconds by stage and resolution of a csv written by an earlier run
+static std::map<string, double> loadBaseline(const string & path)
+{
+    std::ifstream file(path);
+    if (!file)
+        throw std::runtime_error("cannot read baseline " + path);
+    std::map<string, double> baseline;
+    string line;
+    std::getline(file, line);
+    while (std::getline(file, line))
+    {
+        StringTokenizer fields(line, ",", StringTokenizer::TOK_TRIM);
+        if (fields.count() < 5)
+            continue;
+        baseline[fields[0] + " " + fields[1]] = Poco::NumberParser::parseFloat(fields[3]);
+    }
+    return baseline;
+}
+
+// percent by which a stage is slower than in the baseline, false if the baseline has no time for it
+static bool baselineChange(const StageResult & result, const std::map<string, double> & baseline, double & baselineMs, double & change)
+{
+    auto found = baseline.find(result.stage + " " + result.resolution);
+    if (found == baseline.end() || found->second <= 0.0)
+        return false;
+    baselineMs = found->second;
+    change = (result.medianMs / baselineMs - 1.0) * 100.0;
+    return true;
+}
+
+static void writeTable(const vector<StageResult> & results, const std::map<string, double> & baseline, double threshold, ostream & out)
+{
+    out << std::left << setw(18) << "stage" << setw(12) << "resolution" << std::right << setw(12) << "median ms"
+        << setw(12) << "p90 ms" << setw(14) << "baseline ms" << setw(10) << "change" << "\n" << std::fixed;
+    for (const StageResult & result : results)
+    {
+        out << std::left << setw(18) << result.stage << setw(12) << result.resolution << std::right << std::setprecision(3)
+            << setw(12) << result.medianMs << setw(12) << result.p90Ms;
+        double baselineMs = 0.0, change = 0.0;
+        if (baselineChange(result, baseline, baselineMs, change))
+        {
+            out << setw(14) << baselineMs << setw(9) << std::setprecision(1) << change << "%";
+            if (change > threshold)
+                out << "  REGRESSION";
+        }
+        out << "\n";
+    }
+}
+
+static void writeCsv(const vector<StageResult> & results, ostream & out)
+{
+    out << "stage,resolution,runs,median_ms,p90_ms\n" << std::fixed << std::setprecision(4);
+    for (const StageResult & result : results)
+        out << result.stage << "," << result.resolution << "," << result.runs << "," << result.medianMs << "," << result.p90Ms << "\n";
+}
+
+static void writeJson(const vector<StageResult> & results, ostream & out)
+{
+    out << "{\"results\":[" << std::fixed << std::setprecision(4);
+    for (size_t i = 0; i < results.size(); i++)
+    {
+        const StageResult & result = results[i];
+        out << (i > 0 ? "," : "") << "\n  {\"stage\":\"" << result.stage << "\",\"resolution\":\"" << result.resolution
+            << "\",\"runs\":" << result.runs << ",\"median_ms\":" << result.medianMs << ",\"p90_ms\":" << result.p90Ms << "}";
+    }
+    out << "\n]}\n";
+}
+
+bool runStageBench(const BenchSettings & settings, ostream & out)
+{
+    cv::Mat image;
+    if (!settings.image.empty())
+    {
+        image = cv::imread(settings.image, cv::IMREAD_COLOR);
+        if (image.empty())
+            throw std::runtime_error("cannot read image " + settings.image);
+    }
+    cv::Mat depth = loadDepth(settings.depth);
+    std::map<string, double> baseline;
+    if (!settings.baseline.empty())
+        baseline = loadBaseline(settings.baseline);
+
+    Poco::AutoPtr<Poco::Util::MapConfiguration> config(new Poco::Util::MapConfiguration);
+    ObjectDetector detector(*config);
+    cv::dnn::Net net;
+    bool hasNet = Poco::File(settings.modelDir + "/MobileNetSSD_deploy.caffemodel").exists();
+    if (hasNet)
+        net = loadNet(settings, CustomLayerSettings());
+    else
+        out << "no model in " << settings.modelDir << ", net_forward skipped\n";
+
+    vector<StageResult> results;
+    for (const cv::Size & size : { cv::Size(640, 480), cv::Size(1280, 720), cv::Size(1920, 1080) })
+    {
+        vector<StageResult> stages = runResolution(settings, size, image, depth, hasNet ? &net : nullptr, detector, out);
+        results.insert(results.end(), stages.begin(), stages.end());
+    }
+
+    std::ofstream file;
+    if (!settings.output.empty())
+    {
+        file.open(settings.output);
+        if (!file)
+            throw std::runtime_error("cannot write " + settings.output);
+    }
+    ostream & resultsOut = settings.output.empty() ? out : file;
+    bool table = false;
+    if (Poco::icompare(settings.format, "csv") == 0)
+        writeCsv(results, resultsOut);
+    else if (Poco::icompare(settings.format, "json") == 0)
+        writeJson(results, resultsOut);
+    else
+    {
+        writeTable(results, baseline, settings.threshold, resultsOut);
+        table = true;
+    }
+    // results written to a file are summed up on the console
+    if (!table && !settings.output.empty())
+        writeTable(results, baseline, settings.threshold, out);
+
+    int regressions = 0;
+    for (const StageResult & result : results)
+    {
+        double baselineMs = 0.0, change = 0.0;
+        if (baselineChange(result, baseline, baselineMs, change) && change > settings.threshold)
+            regressions++;
+    }
+    if (!baseline.empty() && (table || !settings.output.empty()))
+    {
+        out << (regressions == 0 ? "no stage" : std::to_string(regressions) + " stages") << " slower than the baseline by more than "
+            << std::setprecision(1) << settings.threshold << "%" << std::endl;
+    }
+    return regressions == 0;
+}
@@ -0,0 +1,11 @@
+#pragma once
+#include <ostream>
+#include "LayerBench.h"
+
+// Time every per-frame stage of the pipeline on its own, RGB to BGR conversion, depth to color alignment, depth to
+// meters, network input blob, network forward, detection decode, per-box depth statistics, overlay drawing and the
+// copy of the display frame for texture upload, settings.iterations times at 640x480, 1280x720 and 1920x1080.
+// Frames are synthetic, or settings.image and the first depth frame of settings.depth scaled to every resolution.
+// Reports the median and 90th percentile milliseconds of every stage in settings.format. Returns false if a stage is
+// slower than in settings.baseline by more than settings.threshold percent.
+bool runStageBench(const BenchSettings & settings, std::ostream & out);
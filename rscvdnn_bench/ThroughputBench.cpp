@@ -0,0 +1,86 @@
+#include <string>
+#include <vector>
+#include <future>
+#include <ostream>
+#include <iomanip>
+#include <opencv2/opencv.hpp>
+#include <opencv2/dnn.hpp>
+#include "ThroughputBench.h"
+#include "NetPool.h"
+
+using std::string;
+using std::vector;
+using std::ostream;
+using std::setw;
+
+// frames per second of pool, over frames jobs queued all at once
+static double measureThroughput(NetPool & pool, const cv::Mat & blob, int frames)
+{
+    vector<std::future<void>> results;
+    int64 tickStart = cv::getTickCount();
+    for (int i = 0; i < frames; i++)
+    {
+        results.push_back(pool.submit([&blob](cv::dnn::Net & net)
+        {
+            net.setInput(blob, "data");
+            net.forward("detection_out");
+        }));
+    }
+    // get rethrows the exception of a failed job
+    for (std::future<void> & result : results)
+        result.get();
+    return frames * cv::getTickFrequency() / (cv::getTickCount() - tickStart);
+}
+
+bool runThroughputBench(const BenchSettings & settings, const CustomLayerSettings & custom, ostream & out)
+{
+    const string prototxt = settings.modelDir + "/MobileNetSSD_deploy.prototxt";
+    const string caffemodel = settings.modelDir + "/MobileNetSSD_deploy.caffemodel";
+    cv::Mat blob = loadInputBlob(settings);
+    const int threads = cv::getNumThreads();
+    cv::setNumThreads(1);
+
+    out << setw(8) << "workers" << setw(12) << "frames/s" << setw(10) << "speedup" << setw(12) << "efficiency" << setw(10) << "stolen" << "\n";
+    out << std::fixed;
+    double baseline = 0.0;
+    bool passed = true;
+    try
+    {
+        vector<int> counts;
+        for (int workers = 1; workers < settings.workers; workers *= 2)
+            counts.push_back(workers);
+        counts.push_back(settings.workers);
+
+        for (int workers : counts)
+        {
+            registerCustomLayers(custom);
+            NetPool pool(prototxt, caffemodel, workers);
+            unregisterCustomLayers();
+
+            // the first forward of every instance allocates its blobs
+            measureThroughput(pool, blob, 2 * workers);
+            uint64_t stolenBefore = 0;
+            for (int k = 0; k < workers; k++)
+                stolenBefore += pool.stolen(k);
+
+            double fps = measureThroughput(pool, blob, settings.iterations * workers);
+            uint64_t stolen = 0;
+            for (int k = 0; k < workers; k++)
+                stolen += pool.stolen(k);
+            if (workers == 1)
+                baseline = fps;
+            out << setw(8) << workers << setw(12) << std::setprecision(1) << fps << setw(9) << std::setprecision(2) << fps / baseline << "x"
+                << setw(11) << std::setprecision(0) << 100.0 * fps / baseline / workers << "%" << setw(10) << stolen - stolenBefore << "\n";
+        }
+    }
+    catch (std::exception & e)
+    {
+        unregisterCustomLayers();
+        out << "inference failed: " << e.what() << "\n";
+        passed = false;
+    }
+
+    cv::setNumThreads(threads);
+    out << std::flush;
+    return passed;
+}
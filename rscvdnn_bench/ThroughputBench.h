@@ -0,0 +1,9 @@
+#pragma once
+#include <ostream>
+#include "LayerBench.h"
+#include "CustomLayers.h"
+
+// Run frames through a NetPool of 1, 2, 4, ... up to settings.workers instances and report the frames per second,
+// the speedup over one worker, and how many jobs were stolen. Each forward runs single threaded so the scaling
+// comes from the pool alone. Returns false if any job failed.
+bool runThroughputBench(const BenchSettings & settings, const CustomLayerSettings & custom, std::ostream & out);